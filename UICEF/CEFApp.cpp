@@ -0,0 +1,323 @@
+#include "CEFApp.h"
+#include <string>
+#include <utility>
+#include <vector>
+#include "include/wrapper/cef_helpers.h"
+
+const char CEFApp::kPostMessage[] = "cocos.postMessage";
+const char CEFApp::kPostBinaryMessage[] = "cocos.postBinary";
+const char CEFApp::kBinaryMessage[] = "cocos.binary";
+const char CEFApp::kStateStreamOpenMessage[] = "cocos.stateStream.open";
+const char CEFApp::kStateStreamCloseMessage[] = "cocos.stateStream.close";
+const char CEFApp::kStateStreamDoorbellMessage[] = "cocos.stateStream.doorbell";
+
+// Defines window.cocos. The payload is converted in JS, where JSON is at hand.
+//
+// This CEF version can't hand an ArrayBuffer to V8, so binary payloads cross
+// it as strings holding one byte per character.
+static const char s_kCocosExtensionCode[] =
+	"var cocos;\n"
+	"if (!cocos)\n"
+	"  cocos = {};\n"
+	"(function() {\n"
+	"  var toArrayBuffer = function(text) {\n"
+	"    var bytes = new Uint8Array(text.length);\n"
+	"    for (var i = 0; i < text.length; ++i)\n"
+	"      bytes[i] = text.charCodeAt(i);\n"
+	"    return bytes.buffer;\n"
+	"  };\n"
+	"  cocos.postMessage = function(name, payload) {\n"
+	"    native function PostMessage();\n"
+	"    if (payload === undefined)\n"
+	"      payload = '';\n"
+	"    else if (typeof payload !== 'string')\n"
+	"      payload = JSON.stringify(payload);\n"
+	"    PostMessage(String(name), payload);\n"
+	"  };\n"
+	"  cocos.postBinary = function(name, buffer) {\n"
+	"    native function PostBinary();\n"
+	"    var bytes = buffer instanceof ArrayBuffer ? new Uint8Array(buffer) :\n"
+	"      new Uint8Array(buffer.buffer, buffer.byteOffset, buffer.byteLength);\n"
+	"    // Chunked to stay under the argument count limit of apply.\n"
+	"    var chunks = [];\n"
+	"    for (var i = 0; i < bytes.length; i += 32768)\n"
+	"      chunks.push(String.fromCharCode.apply(null, bytes.subarray(i, i + 32768)));\n"
+	"    PostBinary(String(name), chunks.join(''));\n"
+	"  };\n"
+	"  cocos.onBinaryMessage = null;\n"
+	"  cocos.dispatchBinary_ = function(name, text) {\n"
+	"    if (typeof cocos.onBinaryMessage === 'function')\n"
+	"      cocos.onBinaryMessage(name, toArrayBuffer(text));\n"
+	"  };\n"
+	"  cocos.readState = function() {\n"
+	"    native function ReadState();\n"
+	"    var state = ReadState();\n"
+	"    if (!state)\n"
+	"      return null;\n"
+	"    return { buffer: toArrayBuffer(state.records), recordSize: state.recordSize,\n"
+	"      count: state.records.length / state.recordSize, lost: state.lost };\n"
+	"  };\n"
+	"  cocos.onState = null;\n"
+	"  cocos.dispatchState_ = function() {\n"
+	"    if (typeof cocos.onState !== 'function')\n"
+	"      return;\n"
+	"    var state = cocos.readState();\n"
+	"    if (state && state.count > 0)\n"
+	"      cocos.onState(state);\n"
+	"  };\n"
+	"})();\n";
+
+// Binary payloads in V8 hold one byte per character, see above.
+typedef std::basic_string<CefString::char_type> CharBuffer;
+
+static CefRefPtr<CefBinaryValue> StringToBinary(const CefString& text)
+{
+	// CEF has no empty binary value.
+	size_t size = text.length();
+	if (size == 0)
+		return NULL;
+
+	// Narrowed straight from the characters of |text|.
+	const CefString::char_type* chars = text.c_str();
+	std::string bytes(size, '\0');
+	for (size_t i = 0; i < size; ++i)
+		bytes[i] = static_cast<char>(chars[i]);
+	return CefBinaryValue::Create(bytes.data(), size);
+}
+
+// The returned string refers to |chars|, which must outlive it.
+static CefString BytesToString(const unsigned char* bytes, size_t size, CharBuffer& chars)
+{
+	chars.assign(bytes, bytes + size);
+	return CefString(chars.data(), chars.size(), false);
+}
+
+// The returned string refers to |chars|, which must outlive it.
+static CefString BinaryToString(const CefRefPtr<CefBinaryValue>& binary, CharBuffer& chars)
+{
+	size_t size = binary ? binary->GetSize() : 0;
+	chars.resize(size);
+	if (size > 0)
+	{
+		// Read the bytes into the front of the buffer, then widen them in
+		// place from the back, where no byte is overwritten before it is read.
+		unsigned char* bytes = reinterpret_cast<unsigned char*>(&chars[0]);
+		binary->GetData(bytes, size, 0);
+		for (size_t i = size; i-- > 0;)
+			chars[i] = bytes[i];
+	}
+	return CefString(chars.data(), chars.size(), false);
+}
+
+// Native functions of the window.cocos binding.
+class CocosV8Handler : public CefV8Handler
+{
+public:
+	explicit CocosV8Handler(CEFApp* app) : app_(app) {}
+
+	virtual bool Execute(const CefString& name,
+		CefRefPtr<CefV8Value> object,
+		const CefV8ValueList& arguments,
+		CefRefPtr<CefV8Value>& retval,
+		CefString& exception) OVERRIDE
+	{
+		if (name == "ReadState")
+		{
+			CefRefPtr<CefBrowser> browser = CefV8Context::GetCurrentContext()->GetBrowser();
+			retval = browser ? app_->ReadStateStream(browser) : CefV8Value::CreateNull();
+			return true;
+		}
+
+		bool is_binary = (name == "PostBinary");
+		if (!is_binary && name != "PostMessage")
+			return false;
+
+		if (arguments.size() != 2 || !arguments[0]->IsString() || !arguments[1]->IsString())
+		{
+			exception = is_binary ? "cocos.postBinary: invalid arguments" : "cocos.postMessage: invalid arguments";
+			return true;
+		}
+
+		CefRefPtr<CefBrowser> browser = CefV8Context::GetCurrentContext()->GetBrowser();
+		if (!browser)
+			return true;
+
+		CefRefPtr<CefProcessMessage> message = CefProcessMessage::Create(is_binary ? CEFApp::kPostBinaryMessage : CEFApp::kPostMessage);
+		CefRefPtr<CefListValue> args = message->GetArgumentList();
+		args->SetString(0, arguments[0]->GetStringValue());
+		if (!is_binary)
+		{
+			args->SetString(1, arguments[1]->GetStringValue());
+		}
+		else
+		{
+			// Left out when empty.
+			CefRefPtr<CefBinaryValue> payload = StringToBinary(arguments[1]->GetStringValue());
+			if (payload)
+				args->SetBinary(1, payload);
+		}
+		browser->SendProcessMessage(PID_BROWSER, message);
+		return true;
+	}
+
+private:
+	// Lives as long as the process.
+	CEFApp* app_;
+
+	IMPLEMENT_REFCOUNTING(CocosV8Handler);
+	DISALLOW_COPY_AND_ASSIGN(CocosV8Handler);
+};
+
+CEFApp::CEFApp()
+{
+}
+
+CefMessageRouterConfig CEFApp::GetMessageRouterConfig()
+{
+	// The defaults, window.cefQuery and window.cefQueryCancel.
+	return CefMessageRouterConfig();
+}
+
+void CEFApp::OnWebKitInitialized()
+{
+	CEF_REQUIRE_RENDERER_THREAD();
+
+	message_router_ = CefMessageRouterRendererSide::Create(GetMessageRouterConfig());
+
+	CefRegisterExtension("v8/cocos", s_kCocosExtensionCode, new CocosV8Handler(this));
+}
+
+void CEFApp::OnBrowserDestroyed(CefRefPtr<CefBrowser> browser)
+{
+	CEF_REQUIRE_RENDERER_THREAD();
+
+	state_streams_.erase(browser->GetIdentifier());
+}
+
+void CEFApp::OnContextCreated(CefRefPtr<CefBrowser> browser,
+	CefRefPtr<CefFrame> frame,
+	CefRefPtr<CefV8Context> context)
+{
+	CEF_REQUIRE_RENDERER_THREAD();
+
+	if (message_router_)
+		message_router_->OnContextCreated(browser, frame, context);
+}
+
+void CEFApp::OnContextReleased(CefRefPtr<CefBrowser> browser,
+	CefRefPtr<CefFrame> frame,
+	CefRefPtr<CefV8Context> context)
+{
+	CEF_REQUIRE_RENDERER_THREAD();
+
+	if (message_router_)
+		message_router_->OnContextReleased(browser, frame, context);
+}
+
+bool CEFApp::OnProcessMessageReceived(CefRefPtr<CefBrowser> browser,
+	CefProcessId source_process,
+	CefRefPtr<CefProcessMessage> message)
+{
+	CEF_REQUIRE_RENDERER_THREAD();
+
+	const std::string name = message->GetName();
+	if (name == kBinaryMessage)
+	{
+		DispatchBinary(browser, message->GetArgumentList());
+		return true;
+	}
+
+	if (name == kStateStreamOpenMessage)
+	{
+		CefRefPtr<CefListValue> args = message->GetArgumentList();
+		OpenStateStream(browser, args->GetString(0), static_cast<size_t>(args->GetDouble(1)));
+		return true;
+	}
+
+	if (name == kStateStreamCloseMessage)
+	{
+		state_streams_.erase(browser->GetIdentifier());
+		return true;
+	}
+
+	if (name == kStateStreamDoorbellMessage)
+	{
+		DispatchState(browser);
+		return true;
+	}
+
+	return message_router_ && message_router_->OnProcessMessageReceived(browser, source_process, message);
+}
+
+void CEFApp::DispatchBinary(CefRefPtr<CefBrowser> browser, CefRefPtr<CefListValue> args)
+{
+	// Only the main frame gets binary messages.
+	CefRefPtr<CefV8Context> context = browser->GetMainFrame()->GetV8Context();
+	if (!context || !context->Enter())
+		return;
+
+	CefRefPtr<CefV8Value> cocos = context->GetGlobal()->GetValue("cocos");
+	CefRefPtr<CefV8Value> dispatch = (cocos && cocos->IsObject()) ? cocos->GetValue("dispatchBinary_") : NULL;
+	if (dispatch && dispatch->IsFunction())
+	{
+		CefV8ValueList arguments;
+		arguments.push_back(CefV8Value::CreateString(args->GetString(0)));
+		CharBuffer chars;
+		arguments.push_back(CefV8Value::CreateString(BinaryToString(args->GetBinary(1), chars)));
+		dispatch->ExecuteFunction(cocos, arguments);
+	}
+
+	context->Exit();
+}
+
+void CEFApp::OpenStateStream(CefRefPtr<CefBrowser> browser, const std::string& name, size_t size)
+{
+	std::unique_ptr<StateStream> stream(new StateStream());
+	if (!stream->memory.Open(name, size) || !stream->ring.Attach(stream->memory.GetMemory(), size))
+	{
+		state_streams_.erase(browser->GetIdentifier());
+		return;
+	}
+
+	stream->records.resize(stream->ring.GetRecordSize() * stream->ring.GetCapacity());
+	state_streams_[browser->GetIdentifier()] = std::move(stream);
+}
+
+CefRefPtr<CefV8Value> CEFApp::ReadStateStream(CefRefPtr<CefBrowser> browser)
+{
+	auto iter = state_streams_.find(browser->GetIdentifier());
+	if (iter == state_streams_.end())
+		return CefV8Value::CreateNull();
+
+	StateStream* stream = iter->second.get();
+	uint64_t lost = 0;
+	size_t count = stream->ring.Read(&stream->records[0], stream->ring.GetCapacity(), &lost);
+
+	CharBuffer chars;
+	CefRefPtr<CefV8Value> state = CefV8Value::CreateObject(NULL);
+	state->SetValue("records", CefV8Value::CreateString(BytesToString(&stream->records[0], count * stream->ring.GetRecordSize(), chars)),
+		V8_PROPERTY_ATTRIBUTE_NONE);
+	state->SetValue("recordSize", CefV8Value::CreateUInt(static_cast<uint32>(stream->ring.GetRecordSize())),
+		V8_PROPERTY_ATTRIBUTE_NONE);
+	state->SetValue("lost", CefV8Value::CreateDouble(static_cast<double>(lost)), V8_PROPERTY_ATTRIBUTE_NONE);
+	return state;
+}
+
+void CEFApp::DispatchState(CefRefPtr<CefBrowser> browser)
+{
+	// Nothing new since the page last read.
+	auto iter = state_streams_.find(browser->GetIdentifier());
+	if (iter == state_streams_.end() || iter->second->ring.GetPendingCount() == 0)
+		return;
+
+	CefRefPtr<CefV8Context> context = browser->GetMainFrame()->GetV8Context();
+	if (!context || !context->Enter())
+		return;
+
+	CefRefPtr<CefV8Value> cocos = context->GetGlobal()->GetValue("cocos");
+	CefRefPtr<CefV8Value> dispatch = (cocos && cocos->IsObject()) ? cocos->GetValue("dispatchState_") : NULL;
+	if (dispatch && dispatch->IsFunction())
+		dispatch->ExecuteFunction(cocos, CefV8ValueList());
+
+	context->Exit();
+}
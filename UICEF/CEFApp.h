@@ -0,0 +1,92 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "include/cef_app.h"
+#include "include/wrapper/cef_message_router.h"
+#include "CEFSharedMemory.h"
+#include "CEFSharedRing.h"
+
+// Application level callbacks shared by the browser and the sub-processes. In
+// the render process it installs the renderer side of the message router, so
+// pages can answer the browser process through window.cefQuery, and the
+// window.cocos binding.
+class CEFApp : public CefApp,
+			   public CefRenderProcessHandler
+{
+public:
+	CEFApp();
+
+	// Both sides of the router must use the same configuration.
+	static CefMessageRouterConfig GetMessageRouterConfig();
+
+	// Name of the process message sent by window.cocos.postMessage(name,
+	// payload). Its arguments are the name and the payload, a string as given
+	// or the JSON of any other value.
+	static const char kPostMessage[];
+
+	// Name of the process message sent by window.cocos.postBinary(name,
+	// buffer), and of the one the browser sends for cocos.onBinaryMessage.
+	// Their arguments are the name and a CefBinaryValue.
+	static const char kPostBinaryMessage[];
+	static const char kBinaryMessage[];
+
+	// Process messages of the state stream of a web view. Open carries the
+	// name and the size of the shared memory holding a CEFSharedRing, the
+	// doorbell tells that records were written and carries nothing.
+	static const char kStateStreamOpenMessage[];
+	static const char kStateStreamCloseMessage[];
+	static const char kStateStreamDoorbellMessage[];
+
+	// CefApp methods:
+	virtual CefRefPtr<CefRenderProcessHandler> GetRenderProcessHandler() OVERRIDE {
+		return this;
+	}
+
+	// CefRenderProcessHandler methods:
+	virtual void OnWebKitInitialized() OVERRIDE;
+	virtual void OnBrowserDestroyed(CefRefPtr<CefBrowser> browser) OVERRIDE;
+	virtual void OnContextCreated(CefRefPtr<CefBrowser> browser,
+		CefRefPtr<CefFrame> frame,
+		CefRefPtr<CefV8Context> context) OVERRIDE;
+	virtual void OnContextReleased(CefRefPtr<CefBrowser> browser,
+		CefRefPtr<CefFrame> frame,
+		CefRefPtr<CefV8Context> context) OVERRIDE;
+	virtual bool OnProcessMessageReceived(CefRefPtr<CefBrowser> browser,
+		CefProcessId source_process,
+		CefRefPtr<CefProcessMessage> message) OVERRIDE;
+
+	// Returns the records of the state stream of |browser| written since the
+	// last read, for cocos.readState(). Null if it has no stream.
+	CefRefPtr<CefV8Value> ReadStateStream(CefRefPtr<CefBrowser> browser);
+
+private:
+	// The render process end of a state stream.
+	struct StateStream
+	{
+		CEFSharedMemory memory;
+		CEFSharedRing ring;
+		// Room for a full ring of records.
+		std::vector<unsigned char> records;
+	};
+
+	void OpenStateStream(CefRefPtr<CefBrowser> browser, const std::string& name, size_t size);
+
+	// Pass new records to cocos.onState of the main frame.
+	void DispatchState(CefRefPtr<CefBrowser> browser);
+
+	// Pass a kBinaryMessage to cocos.onBinaryMessage of the main frame.
+	void DispatchBinary(CefRefPtr<CefBrowser> browser, CefRefPtr<CefListValue> args);
+
+	// RENDER PROCESS MEMBERS
+	// Only touched on the render process main thread.
+	CefRefPtr<CefMessageRouterRendererSide> message_router_;
+	// Indexed by browser identifier.
+	std::map<int, std::unique_ptr<StateStream> > state_streams_;
+
+	// Include the default reference counting implementation.
+	IMPLEMENT_REFCOUNTING(CEFApp);
+	DISALLOW_COPY_AND_ASSIGN(CEFApp);
+};
@@ -1,20 +1,67 @@
 #include "CEFBrowseWindow.h"
+#include <algorithm>
+#include "CEFManager.h"
 
 static const wchar_t s_kWndClassName[] = L"CEFBrowseWindowWndClass";
 static int s_WindowID_ = 100;
 
-CEFBrowseWindow::CEFBrowseWindow(Delegate* delegate)
+// Pause the media that is playing and mark it, so only that media is restarted.
+static const char s_kPauseMediaScript[] =
+	"(function(){var m=document.querySelectorAll('audio,video');"
+	"for(var i=0;i<m.length;++i){if(!m[i].paused){m[i].__cefSuspended=true;m[i].pause();}}})();";
+
+static const char s_kResumeMediaScript[] =
+	"(function(){var m=document.querySelectorAll('audio,video');"
+	"for(var i=0;i<m.length;++i){if(m[i].__cefSuspended){delete m[i].__cefSuspended;m[i].play();}}})();";
+
+CEFBrowseWindow::CEFBrowseWindow(Delegate* delegate, bool windowless)
 	: delegate_(delegate),
 	is_closing_(false),
+	is_windowless_(windowless),
+	frame_rate_(0),
+	is_hidden_(false),
+	is_suspended_(false),
+	is_visible_(false),
+	history_index_(-1),
+	history_base_(0),
 	is_sizeDirty_(false),
 	hWnd_(NULL),
 	iWindowdId_(++s_WindowID_)
 {
-	client_handler_ = new CEFClientHandler(this);
+	CEFManager::getInstance()->onBrowseWindowCreated();
+	route_ = std::make_shared<CEFClientHandler::Route>(this, delegate);
+	CefRefPtr<CEFClientHandler> shared_handler = CEFManager::getInstance()->getSharedClientHandler();
+	if (shared_handler)
+		client_ = shared_handler->GetClientFor(route_);
+	else
+		client_ = new CEFClientHandler(route_);
+
+	if (is_windowless_)
+	{
+		frame_buffer_ = std::make_shared<CEFOsrFrameBuffer>(CEFManager::getInstance()->getFrameWorkerPool());
+		route_->SetFrameBuffer(frame_buffer_);
+	}
+
+	UpdateVisibility();
 }
 
 CEFBrowseWindow::~CEFBrowseWindow()
 {
+	// Events still in flight for this window must not reach it.
+	if (client_)
+	{
+		route_->DetachDelegate();
+		client_ = NULL;
+	}
+
+	// Web views may outlive the manager.
+	if (CEFManager::hasInstance())
+	{
+		if (is_visible_)
+			CEFManager::getInstance()->onBrowserVisibilityChange(false);
+		CEFManager::getInstance()->getShutdownCoordinator()->OnCloseFinished(this);
+		CEFManager::getInstance()->onBrowseWindowDestroyed();
+	}
 	delegate_ = NULL;
 }
 
@@ -82,13 +129,50 @@ bool registerWindowClass()
 	return true;
 }
 
+void CEFBrowseWindow::SetDelegate(Delegate* delegate, bool keepCurrentEntry)
+{
+	if (client_)
+	{
+		route_->DropPendingEvents();
+		route_->SetPageDelegate(delegate);
+	}
+
+	// CEF can't clear the history, so older entries are out of reach instead.
+	history_base_ = keepCurrentEntry ? std::max(history_index_, 0) : history_index_ + 1;
+	delegate_ = delegate;
+}
+
 void CEFBrowseWindow::CreateBrowser(const std::string& url, 
 	CefWindowHandle parent_handle,
 	const CefRect& rect,
 	const CefBrowserSettings& settings, 
 	CefRefPtr<CefRequestContext> request_context)
 {
+	// The handler marks the milestones that follow on the CEF UI thread.
+	auto profile = CEFManager::getInstance()->getStartupProfiler()->AddBrowser(is_windowless_);
+	route_->SetStartupProfile(profile);
+
+	if (is_windowless_)
+	{
+		CefWindowInfo window_info;
+		browserSize_ = rect;
+		frame_buffer_->SetViewSize(rect.width, rect.height);
+		window_info.SetAsWindowless(parent_handle, true);
+		frame_rate_ = settings.windowless_frame_rate;
+
+		if (profile)
+			profile->Mark(CEFStartupProfiler::kCreateBrowserBegin);
+		CefBrowserHost::CreateBrowser(window_info, client_, url, settings, request_context);
+		if (profile)
+			profile->Mark(CEFStartupProfiler::kCreateBrowserEnd);
+		return;
+	}
+
+	if (profile)
+		profile->Mark(CEFStartupProfiler::kRegisterWindowClassBegin);
 	registerWindowClass();
+	if (profile)
+		profile->Mark(CEFStartupProfiler::kRegisterWindowClassEnd);
 
 	hWnd_ = ::CreateWindowEx(
 		WS_EX_CLIENTEDGE,
@@ -113,19 +197,52 @@ void CEFBrowseWindow::CreateBrowser(const std::string& url,
 		RECT wnd_rect = { rect.x, rect.y, rect.width, rect.height };
 		window_info.SetAsChild(hWnd_, wnd_rect);
 
-		CefBrowserHost::CreateBrowser(window_info, client_handler_, url, settings, request_context);
+		if (profile)
+			profile->Mark(CEFStartupProfiler::kCreateBrowserBegin);
+		CefBrowserHost::CreateBrowser(window_info, client_, url, settings, request_context);
+		if (profile)
+			profile->Mark(CEFStartupProfiler::kCreateBrowserEnd);
 	}
 }
 
 void CEFBrowseWindow::Show()
 {
+	bool was_hidden = is_hidden_;
+	is_hidden_ = false;
+	UpdateVisibility();
+
+	// Stay asleep until Resume().
+	if (is_suspended_)
+		return;
+
+	if (is_windowless_)
+	{
+		if (browser_)
+			browser_->GetHost()->WasHidden(false);
+		return;
+	}
+
 	HWND hwnd = GetWindowHandle();
 	if (hwnd && !::IsWindowVisible(hwnd))
 		ShowWindow(hwnd, SW_SHOW);
+
+	// Hide() shrank the window, restore its bounds.
+	if (was_hidden)
+		OnResize();
 }
 
 void CEFBrowseWindow::Hide()
 {
+	is_hidden_ = true;
+	UpdateVisibility();
+
+	if (is_windowless_)
+	{
+		if (browser_)
+			browser_->GetHost()->WasHidden(true);
+		return;
+	}
+
 	HWND hwnd = GetWindowHandle();
 	if (hwnd) {
 		// When the frame window is minimized set the browser window size to 0x0 to
@@ -137,7 +254,21 @@ void CEFBrowseWindow::Hide()
 
 bool CEFBrowseWindow::Close(bool force_close)
 {
+	if (is_windowless_)
+	{
+		// There is no window to destroy, OnBrowserClosed follows the close.
+		if (browser_ && !IsClosing())
+		{
+			CEFManager::getInstance()->getShutdownCoordinator()->OnCloseStarted(this, browser_->GetIdentifier());
+			browser_->GetHost()->CloseBrowser(force_close);
+			return true;
+		}
+
+		return false;
+	}
+
 	if (hWnd_ && !IsClosing()) {
+		CEFManager::getInstance()->getShutdownCoordinator()->OnCloseStarted(this, browser_ ? browser_->GetIdentifier() : 0);
 		DestroyWindow(hWnd_);
 		//browser_->GetHost()->CloseBrowser(force_close);
 
@@ -147,6 +278,12 @@ bool CEFBrowseWindow::Close(bool force_close)
 	return false;
 }
 
+void CEFBrowseWindow::ForceClose()
+{
+	if (browser_)
+		browser_->GetHost()->CloseBrowser(true);
+}
+
 void CEFBrowseWindow::SetBounds(int x, int y, size_t width, size_t height)
 {
 	is_sizeDirty_ = true;
@@ -161,6 +298,121 @@ void CEFBrowseWindow::SetFocus(bool focus)
 		browser_->GetHost()->SetFocus(focus);
 }
 
+void CEFBrowseWindow::Suspend()
+{
+	if (is_suspended_)
+		return;
+
+	is_suspended_ = true;
+	UpdateVisibility();
+
+	// Applied in OnBrowserCreated if the browser does not exist yet.
+	if (!browser_)
+		return;
+
+	ExecuteJavaScriptInAllFrames(s_kPauseMediaScript);
+	SetBrowserHidden(true);
+}
+
+void CEFBrowseWindow::Resume()
+{
+	if (!is_suspended_)
+		return;
+
+	is_suspended_ = false;
+	UpdateVisibility();
+
+	if (!browser_)
+		return;
+
+	if (is_hidden_)
+	{
+		// Only the media comes back, the view stays hidden until Show().
+		ExecuteJavaScriptInAllFrames(s_kResumeMediaScript);
+		return;
+	}
+
+	OnResize();
+	SetBrowserHidden(false);
+	ExecuteJavaScriptInAllFrames(s_kResumeMediaScript);
+
+	if (is_windowless_)
+		browser_->GetHost()->Invalidate(PET_VIEW);
+}
+
+void CEFBrowseWindow::SetBrowserHidden(bool hidden)
+{
+	if (is_windowless_)
+	{
+		if (hidden)
+		{
+			browser_->GetHost()->WasHidden(true);
+		}
+		else if (frame_rate_ != 0)
+		{
+			// A rate of 0 means the frame rate policy keeps the view hidden.
+			browser_->GetHost()->WasHidden(false);
+			browser_->GetHost()->SetWindowlessFrameRate(frame_rate_);
+		}
+		return;
+	}
+
+	// Hiding the browser's own window makes Chromium treat the page as hidden,
+	// unlike the 0x0 resize of Hide().
+	HWND hBrowseWnd = browser_->GetHost()->GetWindowHandle();
+	if (hBrowseWnd)
+		ShowWindow(hBrowseWnd, hidden ? SW_HIDE : SW_SHOWNA);
+}
+
+void CEFBrowseWindow::UpdateVisibility()
+{
+	bool visible = !is_hidden_ && !is_suspended_ && !is_closing_;
+	if (visible != is_visible_)
+	{
+		is_visible_ = visible;
+		CEFManager::getInstance()->onBrowserVisibilityChange(visible);
+	}
+}
+
+void CEFBrowseWindow::ExecuteJavaScriptInAllFrames(const std::string& code)
+{
+	std::vector<int64> identifiers;
+	browser_->GetFrameIdentifiers(identifiers);
+
+	for (size_t i = 0; i < identifiers.size(); ++i)
+	{
+		CefRefPtr<CefFrame> frame = browser_->GetFrame(identifiers[i]);
+		if (frame)
+			frame->ExecuteJavaScript(code, frame->GetURL(), 0);
+	}
+}
+
+void CEFBrowseWindow::SetFrameRate(int fps)
+{
+	if (!is_windowless_ || !browser_ || fps == frame_rate_)
+		return;
+
+	// Remembered and applied by Resume().
+	if (is_suspended_)
+	{
+		frame_rate_ = fps;
+		return;
+	}
+
+	if (fps == 0)
+	{
+		browser_->GetHost()->WasHidden(true);
+	}
+	else
+	{
+		if (frame_rate_ == 0)
+			browser_->GetHost()->WasHidden(false);
+		browser_->GetHost()->SetWindowlessFrameRate(fps);
+	}
+
+	frame_rate_ = fps;
+}
+
 void CEFBrowseWindow::SetZoomLevel(double fZoom)
 {
 	if (browser_)
@@ -210,6 +462,11 @@ void CEFBrowseWindow::OnBrowserCreated(const CefRefPtr<CefBrowser>& browser)
 	{
 		OnResize();
 	}
+
+	if (is_suspended_)
+	{
+		SetBrowserHidden(true);
+	}
 }
 
 void CEFBrowseWindow::OnBrowserClosing(const CefRefPtr<CefBrowser>& browser)
@@ -220,65 +477,40 @@ void CEFBrowseWindow::OnBrowserClosing(const CefRefPtr<CefBrowser>& browser)
 void CEFBrowseWindow::OnBrowserClosed(const CefRefPtr<CefBrowser>& browser)
 {
 	is_closing_ = true;
+	UpdateVisibility();
 
 	if (browser_.get()) {
 		browser_ = NULL;
 	}
 
-	client_handler_->DetachDelegate();
-	client_handler_ = NULL;
+	route_->DetachDelegate();
+	client_ = NULL;
+
+	CEFManager::getInstance()->getShutdownCoordinator()->OnCloseFinished(this);
 
 	// |this| may be deleted.
 	delegate_->OnBrowserWindowDestroyed();
 }
 
-void CEFBrowseWindow::OnSetAddress(const std::string& url)
-{
-	delegate_->OnSetAddress(url);
-}
-
-void CEFBrowseWindow::OnSetTitle(const std::string& title) 
-{
-	delegate_->OnSetTitle(title);
-}
-
-void CEFBrowseWindow::OnSetFullscreen(bool fullscreen) 
-{
-	delegate_->OnSetFullscreen(fullscreen);
-}
-
-void CEFBrowseWindow::OnSetLoadingState(bool isLoading, bool canGoBack, bool canGoForward) 
-{
-	delegate_->OnSetLoadingState(isLoading, canGoBack, canGoForward);
-}
-
-void CEFBrowseWindow::OnLoadingStart(const std::string& url)
-{
-	delegate_->OnLoadingStart(url);
-}
-
-void CEFBrowseWindow::OnLoadingFinish(const std::string& url)
-{
-	delegate_->OnLoadingFinish(url);
-}
-
-void CEFBrowseWindow::OnLoadingError(const std::string& url)
-{
-	delegate_->OnLoadingError(url);
-}
-
-bool CEFBrowseWindow::OnProcessRequest(const std::string& url)
-{
-	return delegate_->OnProcessRequest(url);
-}
-
-void CEFBrowseWindow::OnSetDraggableRegions(const std::vector<CefDraggableRegion>& regions) 
+void CEFBrowseWindow::OnSetLoadingState(bool isLoading, bool canGoBack, bool canGoForward, int historyIndex) 
 {
-	delegate_->OnSetDraggableRegions(regions);
+	history_index_ = historyIndex;
+	delegate_->OnSetLoadingState(isLoading, canGoBack && historyIndex > history_base_, canGoForward);
 }
 
 void CEFBrowseWindow::OnResize()
 {
+	if (is_windowless_)
+	{
+		frame_buffer_->SetViewSize(browserSize_.width, browserSize_.height);
+		if (browser_)
+		{
+			is_sizeDirty_ = false;
+			browser_->GetHost()->WasResized();
+		}
+		return;
+	}
+
 	HWND hwnd = GetWindowHandle();
 	if (hwnd) {
 		// Set the browser window bounds.
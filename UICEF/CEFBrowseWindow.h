@@ -3,13 +3,16 @@
 #include "include/base/cef_scoped_ptr.h"
 #include "include/cef_browser.h"
 #include "CEFClientHandler.h"
+#include "CEFShutdownCoordinator.h"
 
-class CEFBrowseWindow : public CEFClientHandler::Delegate
+class CEFBrowseWindow : public CEFClientHandler::Delegate,
+						public CEFShutdownCoordinator::Window
 {
 public:
 	// This interface is implemented by the owner of the BrowserWindow. The
-	// methods of this class will be called on the main thread.
-	class Delegate {
+	// methods of this class will be called on the main thread. The page
+	// events go to it straight from the client handler.
+	class Delegate : public CEFClientHandler::PageDelegate {
 	public:
 		// Called when the browser has been created.
 		virtual void OnBrowserCreated(const CefRefPtr<CefBrowser>& browser) = 0;
@@ -17,33 +20,9 @@ public:
 		// Called when the BrowserWindow has been destroyed.
 		virtual void OnBrowserWindowDestroyed() = 0;
 
-		// Set the window URL address.
-		virtual void OnSetAddress(const std::string& url) = 0;
-
-		// Set the window title.
-		virtual void OnSetTitle(const std::string& title) = 0;
-
-		// Set fullscreen mode.
-		virtual void OnSetFullscreen(bool fullscreen) = 0;
-
 		// Set the loading state.
 		virtual void OnSetLoadingState(bool isLoading, bool canGoBack, bool canGoForward) = 0;
 
-		// Called the loading start.
-		virtual void OnLoadingStart(const std::string& url) = 0;
-
-		// Called the loading finish.
-		virtual void OnLoadingFinish(const std::string& url) = 0;
-
-		// Called the loading error.
-		virtual void OnLoadingError(const std::string& url) = 0;
-
-		// On process request event.
-		virtual bool OnProcessRequest(const std::string& url) = 0;
-
-		// Set the draggable regions.
-		virtual void OnSetDraggableRegions(const std::vector<CefDraggableRegion>& regions) = 0;
-		
 		// On window destroyed event.
 		virtual void OnWindowDestroyed() = 0;
 
@@ -51,9 +30,16 @@ public:
 		virtual ~Delegate() {}
 	};
 
-	explicit CEFBrowseWindow(Delegate* delegate);
+	// A |windowless| browser paints into GetFrameBuffer() instead of a child
+	// window of the cocos window.
+	explicit CEFBrowseWindow(Delegate* delegate, bool windowless = false);
 	virtual ~CEFBrowseWindow();
 
+	// Hand the browser to another owner. Events still queued for the previous
+	// owner are dropped and the history so far is hidden from the new one,
+	// except for the current entry if |keepCurrentEntry|.
+	void SetDelegate(Delegate* delegate, bool keepCurrentEntry = false);
+
 	// Create a new browser and native window.
 	void CreateBrowser(const std::string& url, 
 		CefWindowHandle parent_handle,
@@ -70,12 +56,35 @@ public:
 	// Close the browser
 	bool Close(bool force_close);
 
+	// Close the browser without running unload handlers, even if a normal
+	// close is already under way. Called by the shutdown coordinator.
+	void ForceClose() OVERRIDE;
+
 	// Set the window bounds in parent coordinates.
 	void SetBounds(int x, int y, size_t width, size_t height);
 
+	// Returns the bounds last set, also while hidden.
+	const CefRect& GetBounds() const { return browserSize_; }
+
+	// Returns true between Hide() and Show().
+	bool IsHidden() const { return is_hidden_; }
+
 	// Set focus to the window.
 	void SetFocus(bool focus);
 
+	// Put the browser to sleep: the renderer is told it is hidden, which
+	// throttles its timers and stops painting, and playing media is paused.
+	void Suspend();
+
+	// Undo Suspend(), restoring the bounds and restarting the paused media.
+	void Resume();
+
+	// Returns true between Suspend() and Resume().
+	bool IsSuspended() const { return is_suspended_; }
+
+	// Set the rate of a windowless browser, 0 stops painting.
+	void SetFrameRate(int fps);
+
 	// Set zoom level
 	void SetZoomLevel(double fZoom);
 
@@ -91,6 +100,12 @@ public:
 	// Returns true if the browser is closing.
 	bool IsClosing() const;
 
+	// Returns true if the browser renders off-screen.
+	bool IsWindowless() const { return is_windowless_; }
+
+	// Returns the off-screen frames, NULL for windowed browsers.
+	const std::shared_ptr<CEFOsrFrameBuffer>& GetFrameBuffer() const { return frame_buffer_; }
+
 	// Window enter event.
 	void OnEnter();
 
@@ -113,25 +128,40 @@ protected:
 	void OnBrowserCreated(const CefRefPtr<CefBrowser>& browser) OVERRIDE;
 	void OnBrowserClosing(const CefRefPtr<CefBrowser>& browser) OVERRIDE;
 	void OnBrowserClosed(const CefRefPtr<CefBrowser>& browser) OVERRIDE;
-	void OnSetAddress(const std::string& url) OVERRIDE;
-	void OnSetTitle(const std::string& title) OVERRIDE;
-	void OnSetFullscreen(bool fullscreen) OVERRIDE;
-	void OnSetLoadingState(bool isLoading, bool canGoBack, bool canGoForward) OVERRIDE;
-	void OnLoadingStart(const std::string& url) OVERRIDE;
-	void OnLoadingFinish(const std::string& url) OVERRIDE;
-	void OnLoadingError(const std::string& url) OVERRIDE;
-	bool OnProcessRequest(const std::string& url) OVERRIDE;
-	void OnSetDraggableRegions(const std::vector<CefDraggableRegion>& regions) OVERRIDE;
+	void OnSetLoadingState(bool isLoading, bool canGoBack, bool canGoForward, int historyIndex) OVERRIDE;
 
 private:
+	// Tell the renderer whether it is visible.
+	void SetBrowserHidden(bool hidden);
+
+	// Tell the manager when the window starts or stops being on screen, the
+	// message pump keeps its shortest interval while any is.
+	void UpdateVisibility();
+
+	// Run |code| in every frame of the browser.
+	void ExecuteJavaScriptInAllFrames(const std::string& code);
+
 	Delegate* delegate_;
 	CefRefPtr<CefBrowser> browser_;
-	CefRefPtr<CEFClientHandler> client_handler_;
+	// The client the browser is created with, NULL once the browser is gone.
+	CefRefPtr<CefClient> client_;
+	std::shared_ptr<CEFClientHandler::Route> route_;
 	bool is_closing_;
+	bool is_windowless_;
+	int  frame_rate_;
+	bool is_hidden_;
+	bool is_suspended_;
+	// Last visibility reported by UpdateVisibility().
+	bool is_visible_;
+	// Index of the current navigation entry, and of the first one made for
+	// the current owner.
+	int  history_index_;
+	int  history_base_;
 	int  iWindowdId_;
 	bool is_sizeDirty_;
 	CefRect browserSize_;
 	HWND hWnd_;
+	std::shared_ptr<CEFOsrFrameBuffer> frame_buffer_;
 	DISALLOW_COPY_AND_ASSIGN(CEFBrowseWindow);
 };
 
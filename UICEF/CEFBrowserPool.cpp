@@ -0,0 +1,528 @@
+#include "CEFBrowserPool.h"
+#include <algorithm>
+#include "CEFManager.h"
+#include "CEFWebViewWrapper.h"
+
+static const char s_kBlankUrl[] = "about:blank";
+
+// Rough size of a renderer showing a typical page, see SetPreloadBrowserCost.
+static const size_t kDefaultPreloadBrowserCost = 32 * 1024 * 1024;
+
+// CEFOsrFrameBuffer keeps three RGBA copies of the view.
+static const size_t kFrameBufferBytesPerPixel = 3 * 4;
+
+static const CEFBrowserPool::Stats kEmptyStats = { 0, 0, 0, 0, 0, 0.0, 0.0, 0, 0.0, 0.0, 0, 0, 0 };
+
+// Delegate of a browser while it belongs to the pool, its events are dropped.
+class CEFBrowserPool::Entry : public CEFBrowseWindow::Delegate
+{
+public:
+	Entry(CEFBrowserPool* pool, CEFBrowseWindow* window)
+		: pool_(pool)
+		, window_(window)
+		, is_created_(false)
+		, is_ready_(false)
+		, is_failed_(false)
+		, is_discarded_(false)
+		, is_closing_(false)
+		, last_used_(0)
+	{
+	}
+
+	CEFBrowserPool* pool_;
+	CEFBrowseWindow* window_;
+	bool is_created_;
+	// The load started by the pool has finished.
+	bool is_ready_;
+	bool is_failed_;
+	// To be closed as soon as the browser exists.
+	bool is_discarded_;
+	bool is_closing_;
+	// Empty for idle browsers.
+	std::string preload_url_;
+	uint64_t last_used_;
+
+protected:
+	virtual void OnBrowserCreated(const CefRefPtr<CefBrowser>& browser) override
+	{
+		is_created_ = true;
+
+		// The pool may have shrunk or closed while the browser was created.
+		pool_->Shrink();
+	}
+
+	virtual void OnBrowserWindowDestroyed() override
+	{
+		// |this| is deleted.
+		pool_->Remove(this);
+	}
+
+	virtual void OnSetLoadingState(bool isLoading, bool canGoBack, bool canGoForward) override
+	{
+		// Only hand out idle browsers done with about:blank, so that the next
+		// owner gets no events of that load.
+		if (!isLoading)
+		{
+			is_ready_ = true;
+		}
+	}
+
+	virtual void OnLoadingError(const std::string& url) override
+	{
+		is_failed_ = true;
+	}
+
+	virtual void OnSetAddress(const std::string& url) override {}
+	virtual void OnSetTitle(const std::string& title) override {}
+	virtual void OnSetFullscreen(bool fullscreen) override {}
+	virtual void OnLoadingStart(const std::string& url) override {}
+	virtual void OnLoadingFinish(const std::string& url) override {}
+	virtual bool OnProcessRequest(const std::string& url) override { return true; }
+	virtual void OnSetDraggableRegions(const std::vector<CefDraggableRegion>& regions) override {}
+	virtual void OnWindowDestroyed() override {}
+};
+
+CEFBrowserPool::CEFBrowserPool()
+	: capacity_(0)
+	, is_closing_(false)
+	, preload_max_count_(0)
+	, preload_memory_budget_(0)
+	, preload_browser_cost_(kDefaultPreloadBrowserCost)
+	, use_tick_(0)
+	, window_count_(0)
+	, stats_(kEmptyStats)
+{
+}
+
+CEFBrowserPool::~CEFBrowserPool()
+{
+	for (size_t i = 0; i < entries_.size(); ++i)
+	{
+		delete entries_[i]->window_;
+		delete entries_[i];
+	}
+	entries_.clear();
+	window_count_ = 0;
+}
+
+void CEFBrowserPool::SetCapacity(int count)
+{
+	capacity_ = std::max(count, 0);
+
+	Shrink();
+	Fill();
+}
+
+void CEFBrowserPool::Fill()
+{
+	// Filled again by CEFManager once a lazy init is done.
+	if (is_closing_ || !CEFManager::getInstance()->isInitialized() ||
+		!cocos2d::Director::getInstance()->getOpenGLView())
+	{
+		return;
+	}
+
+	bool windowless = CEFManager::getInstance()->isWindowlessRendering();
+	while (GetOpenCount() < capacity_)
+	{
+		CreateEntry(windowless, std::string());
+	}
+}
+
+CEFBrowseWindow* CEFBrowserPool::Acquire(bool windowless, CEFBrowseWindow::Delegate* delegate)
+{
+	for (auto iter = entries_.begin(); iter != entries_.end(); ++iter)
+	{
+		Entry* entry = *iter;
+		if (!entry->preload_url_.empty() || entry->is_discarded_ || !entry->is_ready_ ||
+			entry->is_closing_ || entry->window_->IsWindowless() != windowless)
+		{
+			continue;
+		}
+
+		CEFBrowseWindow* window = entry->window_;
+		window->SetDelegate(delegate);
+
+		if (windowless)
+		{
+			// Drop what was painted for the pool, the new owner waits for its own.
+			CEFOsrFrameBuffer::Frame frame;
+			window->GetFrameBuffer()->AcquireFrame(frame);
+		}
+
+		entries_.erase(iter);
+		delete entry;
+		--window_count_;
+
+		// Start on the replacement right away.
+		Fill();
+		return window;
+	}
+
+	return NULL;
+}
+
+bool CEFBrowserPool::Release(CEFBrowseWindow* window)
+{
+	if (is_closing_ || !window->GetBrowser() || window->IsClosing() || GetOpenCount() >= capacity_)
+	{
+		++stats_.discards;
+		return false;
+	}
+
+	AdoptEntry(window);
+	++stats_.releases;
+
+	Reset(window);
+	return true;
+}
+
+void CEFBrowserPool::Discard(CEFBrowseWindow* window)
+{
+	Entry* entry = AdoptEntry(window);
+	entry->is_discarded_ = true;
+
+	Shrink();
+}
+
+bool CEFBrowserPool::Preload(const std::string& url)
+{
+	auto glView = cocos2d::Director::getInstance()->getOpenGLView();
+	if (is_closing_ || preload_max_count_ <= 0 || !glView || !CEFManager::getInstance()->isInitialized())
+	{
+		return false;
+	}
+
+	Entry* entry = FindPreload(url);
+	if (entry)
+	{
+		entry->last_used_ = ++use_tick_;
+		return true;
+	}
+
+	bool windowless = CEFManager::getInstance()->isWindowlessRendering();
+	size_t cost = preload_browser_cost_;
+	if (windowless)
+	{
+		auto frameSize = glView->getFrameSize();
+		cost += static_cast<size_t>(frameSize.width) * static_cast<size_t>(frameSize.height) * kFrameBufferBytesPerPixel;
+	}
+
+	if (cost > preload_memory_budget_)
+	{
+		return false;
+	}
+
+	entry = CreateEntry(windowless, url);
+	entry->last_used_ = ++use_tick_;
+
+	EvictPreloads();
+	return true;
+}
+
+void CEFBrowserPool::CancelPreload(const std::string& url)
+{
+	Entry* entry = FindPreload(url);
+	if (entry)
+	{
+		entry->preload_url_.clear();
+		entry->is_discarded_ = true;
+		Shrink();
+	}
+}
+
+void CEFBrowserPool::SetPreloadLimits(int max_count, size_t memory_budget)
+{
+	preload_max_count_ = std::max(max_count, 0);
+	preload_memory_budget_ = memory_budget;
+
+	EvictPreloads();
+}
+
+size_t CEFBrowserPool::GetPreloadMemory() const
+{
+	size_t memory = 0;
+	for (size_t i = 0; i < entries_.size(); ++i)
+	{
+		const Entry* entry = entries_[i];
+		if (!entry->preload_url_.empty() && !entry->is_discarded_ && !entry->is_closing_)
+		{
+			memory += GetEntryCost(entry);
+		}
+	}
+
+	return memory;
+}
+
+bool CEFBrowserPool::IsPreloaded(const std::string& url, bool windowless) const
+{
+	Entry* entry = FindPreload(url);
+	return entry && entry->is_created_ && !entry->is_failed_ && entry->window_->IsWindowless() == windowless;
+}
+
+CEFBrowseWindow* CEFBrowserPool::TakePreloaded(const std::string& url, bool windowless,
+	CEFBrowseWindow::Delegate* delegate, bool& is_loaded)
+{
+	if (!IsPreloaded(url, windowless))
+	{
+		if (preload_max_count_ > 0)
+		{
+			++stats_.preload_misses;
+		}
+		return NULL;
+	}
+
+	Entry* entry = FindPreload(url);
+	CEFBrowseWindow* window = entry->window_;
+	is_loaded = entry->is_ready_;
+
+	// The preloaded page is the first entry of the new owner's history.
+	window->SetDelegate(delegate, true);
+
+	entries_.erase(std::find(entries_.begin(), entries_.end(), entry));
+	delete entry;
+	--window_count_;
+
+	++stats_.preload_hits;
+	return window;
+}
+
+bool CEFBrowserPool::CloseAll()
+{
+	is_closing_ = true;
+	Shrink();
+
+	return !entries_.empty();
+}
+
+int CEFBrowserPool::GetIdleCount() const
+{
+	int count = 0;
+	for (size_t i = 0; i < entries_.size(); ++i)
+	{
+		const Entry* entry = entries_[i];
+		if (entry->preload_url_.empty() && !entry->is_discarded_ && entry->is_ready_ && !entry->is_closing_)
+		{
+			++count;
+		}
+	}
+
+	return count;
+}
+
+void CEFBrowserPool::OnCreate(bool pooled)
+{
+	if (pooled)
+	{
+		++stats_.pooled_creates;
+	}
+	else
+	{
+		++stats_.cold_creates;
+	}
+}
+
+void CEFBrowserPool::OnFirstPaint(bool pooled, double ms)
+{
+	if (pooled)
+	{
+		++stats_.pooled_first_paints;
+		stats_.pooled_first_paint_ms += ms;
+		stats_.last_pooled_first_paint_ms = ms;
+	}
+	else
+	{
+		++stats_.cold_first_paints;
+		stats_.cold_first_paint_ms += ms;
+		stats_.last_cold_first_paint_ms = ms;
+	}
+}
+
+void CEFBrowserPool::ResetStats()
+{
+	stats_ = kEmptyStats;
+}
+
+CEFBrowserPool::Entry* CEFBrowserPool::CreateEntry(bool windowless, const std::string& url)
+{
+	Entry* entry = new Entry(this, NULL);
+	entry->window_ = new CEFBrowseWindow(entry, windowless);
+	entry->preload_url_ = url;
+	entries_.push_back(entry);
+	++window_count_;
+
+	// Both are applied as soon as the browser exists.
+	entry->window_->Hide();
+	entry->window_->Suspend();
+
+	auto glView = cocos2d::Director::getInstance()->getOpenGLView();
+	CefRect rect;
+	if (windowless && !url.empty())
+	{
+		// Lay the page out at the size it will most likely be shown at. Hidden
+		// windowed browsers are shrunk to nothing anyway.
+		auto frameSize = glView->getFrameSize();
+		rect.Set(0, 0, static_cast<int>(frameSize.width), static_cast<int>(frameSize.height));
+	}
+
+	CefBrowserSettings browser_settings;
+	browser_settings.windowless_frame_rate = CEFFrameRateGovernor::Policy().max_fps;
+	entry->window_->CreateBrowser(url.empty() ? s_kBlankUrl : url, glView->getWin32Window(), rect, browser_settings, NULL);
+	CEFManager::getInstance()->scheduleMessageLoopWork();
+
+	return entry;
+}
+
+CEFBrowserPool::Entry* CEFBrowserPool::AdoptEntry(CEFBrowseWindow* window)
+{
+	Entry* entry = new Entry(this, window);
+	entry->is_created_ = window->GetBrowser() != NULL;
+	window->SetDelegate(entry);
+	entries_.push_back(entry);
+	++window_count_;
+
+	return entry;
+}
+
+void CEFBrowserPool::Reset(CEFBrowseWindow* window)
+{
+	window->Hide();
+	window->Suspend();
+
+	// Loading replaces a load in progress, so loading ends only once, with
+	// about:blank.
+	CefRefPtr<CefBrowser> browser = window->GetBrowser();
+	browser->GetMainFrame()->LoadURL(s_kBlankUrl);
+	browser->GetHost()->SetZoomLevel(0.0);
+	CEFManager::getInstance()->scheduleMessageLoopWork();
+}
+
+CEFBrowserPool::Entry* CEFBrowserPool::FindPreload(const std::string& url) const
+{
+	for (size_t i = 0; i < entries_.size(); ++i)
+	{
+		Entry* entry = entries_[i];
+		if (!entry->preload_url_.empty() && entry->preload_url_ == url && !entry->is_discarded_ && !entry->is_closing_)
+		{
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+size_t CEFBrowserPool::GetEntryCost(const Entry* entry) const
+{
+	size_t cost = preload_browser_cost_;
+	if (entry->window_->IsWindowless())
+	{
+		int width = 0, height = 0;
+		entry->window_->GetFrameBuffer()->GetViewSize(width, height);
+		cost += static_cast<size_t>(width) * static_cast<size_t>(height) * kFrameBufferBytesPerPixel;
+	}
+
+	return cost;
+}
+
+void CEFBrowserPool::Shrink()
+{
+	int limit = is_closing_ ? 0 : capacity_;
+	int open = GetOpenCount();
+
+	// Browsers still being created are closed from OnBrowserCreated.
+	std::vector<Entry*> closing;
+	for (auto iter = entries_.rbegin(); iter != entries_.rend(); ++iter)
+	{
+		Entry* entry = *iter;
+		if (entry->is_closing_ || !entry->is_created_)
+		{
+			continue;
+		}
+
+		bool close = is_closing_ || entry->is_discarded_;
+		if (!close && entry->preload_url_.empty() && open > limit)
+		{
+			close = true;
+			--open;
+		}
+
+		if (close)
+		{
+			entry->is_closing_ = true;
+			closing.push_back(entry);
+		}
+	}
+
+	// Closing may remove the entry right away.
+	for (size_t i = 0; i < closing.size(); ++i)
+	{
+		closing[i]->window_->Close(true);
+	}
+}
+
+void CEFBrowserPool::EvictPreloads()
+{
+	for (;;)
+	{
+		int count = 0;
+		size_t memory = 0;
+		Entry* oldest = NULL;
+		for (size_t i = 0; i < entries_.size(); ++i)
+		{
+			Entry* entry = entries_[i];
+			if (entry->preload_url_.empty() || entry->is_discarded_ || entry->is_closing_)
+			{
+				continue;
+			}
+
+			++count;
+			memory += GetEntryCost(entry);
+			if (!oldest || entry->last_used_ < oldest->last_used_)
+			{
+				oldest = entry;
+			}
+		}
+
+		if (!oldest || (count <= preload_max_count_ && memory <= preload_memory_budget_))
+		{
+			break;
+		}
+
+		oldest->preload_url_.clear();
+		oldest->is_discarded_ = true;
+		++stats_.preload_evictions;
+	}
+
+	Shrink();
+}
+
+int CEFBrowserPool::GetOpenCount() const
+{
+	int count = 0;
+	for (size_t i = 0; i < entries_.size(); ++i)
+	{
+		const Entry* entry = entries_[i];
+		if (entry->preload_url_.empty() && !entry->is_discarded_ && !entry->is_closing_)
+		{
+			++count;
+		}
+	}
+
+	return count;
+}
+
+void CEFBrowserPool::Remove(Entry* entry)
+{
+	auto iter = std::find(entries_.begin(), entries_.end(), entry);
+	if (iter != entries_.end())
+	{
+		entries_.erase(iter);
+		--window_count_;
+	}
+
+	// Called from the window, which expects to be deleted by its delegate.
+	delete entry->window_;
+	delete entry;
+
+	CEFWebViewWrapper::quitIfAllClosed();
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "CEFBrowseWindow.h"
+
+// Keeps a few browsers created in advance on about:blank so that a new web view
+// does not wait for a renderer to start. Idle browsers are hidden and
+// suspended. A web view takes one with Acquire() and gives it back with
+// Release(), which resets it instead of destroying it.
+//
+// The pool can also load pages speculatively with Preload(). A web view that
+// later loads the same URL swaps its browser for the preloaded one with
+// TakePreloaded(). Preloaded browsers are evicted least recently used first
+// once there are too many, or once their estimated memory passes the budget.
+//
+// The pool is filled once the cocos GL view exists and CEF is initialized, so
+// set the capacity after creating it. All methods except IsEmpty() must be called on the cocos thread.
+class CEFBrowserPool
+{
+public:
+	struct Stats
+	{
+		// Web views that got a pooled browser, and those that created their own.
+		uint64_t pooled_creates;
+		uint64_t cold_creates;
+		// Browsers given back to the pool, and those closed because it was full.
+		uint64_t releases;
+		uint64_t discards;
+		// Time from the first load request of a web view to its first paint, in
+		// milliseconds. Windowed browsers report their first finished load.
+		uint64_t pooled_first_paints;
+		double pooled_first_paint_ms;
+		double last_pooled_first_paint_ms;
+		uint64_t cold_first_paints;
+		double cold_first_paint_ms;
+		double last_cold_first_paint_ms;
+		// Loads served by a preloaded browser, loads that found none while
+		// preloading was enabled, and preloaded browsers closed to make room.
+		uint64_t preload_hits;
+		uint64_t preload_misses;
+		uint64_t preload_evictions;
+	};
+
+	CEFBrowserPool();
+	~CEFBrowserPool();
+
+	// Number of idle browsers to keep, 0 disables the pool and closes them.
+	void SetCapacity(int count);
+	int GetCapacity() const { return capacity_; }
+
+	// Create browsers until the pool holds its capacity.
+	void Fill();
+
+	// Returns an idle browser rendering in the given mode with |delegate| set,
+	// or NULL. The caller owns the window, which is still hidden and suspended.
+	CEFBrowseWindow* Acquire(bool windowless, CEFBrowseWindow::Delegate* delegate);
+
+	// Take back a browser from a web view that no longer needs it. Returns false
+	// if the pool is full or closing, the caller must then close the window.
+	bool Release(CEFBrowseWindow* window);
+
+	// Take a browser the caller no longer needs and close it, once created if
+	// it isn't yet. CreateBrowser must have been called on |window|, a window
+	// that never creates a browser would be kept forever.
+	void Discard(CEFBrowseWindow* window);
+
+	// Start loading |url| in a hidden browser, or mark it as recently used if
+	// it is already preloaded. Returns false if preloading is disabled or one
+	// browser alone would pass the memory budget.
+	bool Preload(const std::string& url);
+
+	// Close the browser preloading |url|.
+	void CancelPreload(const std::string& url);
+
+	// At most |max_count| preloaded browsers using at most |memory_budget|
+	// bytes. Defaults to 0, which disables preloading.
+	void SetPreloadLimits(int max_count, size_t memory_budget);
+
+	// Estimated memory of a browser besides its off-screen frames. CEF does not
+	// report what a renderer uses, so measure it for the pages you preload.
+	void SetPreloadBrowserCost(size_t bytes) { preload_browser_cost_ = bytes; }
+
+	// Estimated memory of the preloaded browsers.
+	size_t GetPreloadMemory() const;
+
+	// Returns true if a created browser rendering in the given mode preloads
+	// |url|.
+	bool IsPreloaded(const std::string& url, bool windowless) const;
+
+	// Hand the browser preloading |url| over to |delegate|, NULL if there is
+	// none. |is_loaded| tells whether its load already finished, the new owner
+	// won't get the load events that came before. Counts a hit or a miss.
+	CEFBrowseWindow* TakePreloaded(const std::string& url, bool windowless,
+		CEFBrowseWindow::Delegate* delegate, bool& is_loaded);
+
+	// Close every browser of the pool. Returns true if one is still closing.
+	bool CloseAll();
+
+	// Returns true if the pool holds no browser, created or not. May be called
+	// from any thread.
+	bool IsEmpty() const { return window_count_ == 0; }
+
+	// Number of created browsers ready to be acquired.
+	int GetIdleCount() const;
+
+	// Called by the web views to measure pooled against cold creation.
+	void OnCreate(bool pooled);
+	void OnFirstPaint(bool pooled, double ms);
+
+	const Stats& GetStats() const { return stats_; }
+	void ResetStats();
+
+private:
+	class Entry;
+
+	Entry* CreateEntry(bool windowless, const std::string& url);
+	Entry* AdoptEntry(CEFBrowseWindow* window);
+	void Reset(CEFBrowseWindow* window);
+	void Remove(Entry* entry);
+	Entry* FindPreload(const std::string& url) const;
+	size_t GetEntryCost(const Entry* entry) const;
+
+	// Close idle browsers over the capacity, discarded ones, and all of them
+	// when closing.
+	void Shrink();
+
+	// Close the least recently used preloads until they fit the limits.
+	void EvictPreloads();
+
+	// Number of idle browsers that are not closing.
+	int GetOpenCount() const;
+
+	int capacity_;
+	bool is_closing_;
+	int preload_max_count_;
+	size_t preload_memory_budget_;
+	size_t preload_browser_cost_;
+	uint64_t use_tick_;
+	std::vector<Entry*> entries_;
+	std::atomic<int> window_count_;
+	Stats stats_;
+
+	DISALLOW_COPY_AND_ASSIGN(CEFBrowserPool);
+};
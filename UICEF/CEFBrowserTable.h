@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Values kept by CefBrowser identifier in a flat vector. CEF hands the
+// identifiers out from 1 upwards and never reuses them, so a lookup is one
+// bounds check and one index.
+//
+// This class does not depend on CEF so the dispatch cost can be measured on
+// its own. Not thread safe.
+template <typename T>
+class CEFBrowserTable
+{
+public:
+	CEFBrowserTable() : empty_(), size_(0) {}
+
+	// Returns the value of |id|, a default constructed one if it has none.
+	const T& Find(int id) const
+	{
+		size_t index = static_cast<size_t>(id);
+		return id > 0 && index < values_.size() ? values_[index] : empty_;
+	}
+
+	// Set the value of |id|, which must be positive. |value| must not be
+	// empty, Remove() forgets a value.
+	const T& Insert(int id, const T& value)
+	{
+		size_t index = static_cast<size_t>(id);
+		if (index >= values_.size())
+		{
+			values_.resize(index < values_.size() * 2 ? values_.size() * 2 : index + 1);
+		}
+
+		if (values_[index] == empty_)
+		{
+			++size_;
+		}
+		values_[index] = value;
+		return values_[index];
+	}
+
+	void Remove(int id)
+	{
+		size_t index = static_cast<size_t>(id);
+		if (id > 0 && index < values_.size() && !(values_[index] == empty_))
+		{
+			values_[index] = empty_;
+			--size_;
+		}
+	}
+
+	size_t Size() const { return size_; }
+
+private:
+	std::vector<T> values_;
+	const T empty_;
+	size_t size_;
+
+	CEFBrowserTable(const CEFBrowserTable&);
+	CEFBrowserTable& operator=(const CEFBrowserTable&);
+};
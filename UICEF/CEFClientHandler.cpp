@@ -1,47 +1,277 @@
 #include "CEFClientHandler.h"
+#include <algorithm>
 #include <sstream>
 #include <string>
 #include "include/base/cef_bind.h"
 #include "include/cef_app.h"
 #include "include/wrapper/cef_closure_task.h"
 #include "include/wrapper/cef_helpers.h"
+#include "CEFApp.h"
+#include "CEFJSRequests.h"
+#include "CEFManager.h"
+#include "CEFNavigationDecision.h"
+
+// How long the CEF UI thread waits for the cocos thread to vet a navigation
+// in multi-threaded message loop mode before cancelling it. A late approval
+// issues it again.
+static const int kProcessRequestTimeoutMs = 100;
+
+// Finds the index of the current navigation entry.
+class CurrentEntryVisitor : public CefNavigationEntryVisitor
+{
+public:
+	CurrentEntryVisitor() : index_(-1) {}
+
+	bool Visit(CefRefPtr<CefNavigationEntry> entry, bool current, int index, int total) OVERRIDE
+	{
+		if (current)
+		{
+			index_ = index;
+			return false;
+		}
+		return true;
+	}
+
+	int index_;
+
+private:
+	IMPLEMENT_REFCOUNTING(CurrentEntryVisitor);
+};
+
+static const std::shared_ptr<CEFClientHandler::Route> s_kNoRoute;
+
+// The client of a browser served by a shared handler. It hands every event to
+// the handler and carries the route, so the handler never has to guess which
+// browser is whose.
+class CEFClientHandler::RouteClient : public CefClient
+{
+public:
+	RouteClient(const CefRefPtr<CEFClientHandler>& handler, const std::shared_ptr<Route>& route)
+		: handler_(handler)
+		, route_(route)
+	{
+		std::lock_guard<std::mutex> lock(handler_->route_clients_lock_);
+		handler_->route_clients_.insert(this);
+	}
 
-CEFClientHandler::CEFClientHandler(Delegate* delegate)
-	: is_closing_(false) 
-	, delegate_(delegate)
+	virtual ~RouteClient()
+	{
+		std::lock_guard<std::mutex> lock(handler_->route_clients_lock_);
+		handler_->route_clients_.erase(this);
+	}
+
+	virtual CefRefPtr<CefDisplayHandler> GetDisplayHandler() OVERRIDE {
+		return handler_.get();
+	}
+	virtual CefRefPtr<CefLifeSpanHandler> GetLifeSpanHandler() OVERRIDE {
+		return handler_.get();
+	}
+	virtual CefRefPtr<CefLoadHandler> GetLoadHandler() OVERRIDE {
+		return handler_.get();
+	}
+	virtual CefRefPtr<CefContextMenuHandler> GetContextMenuHandler() OVERRIDE {
+		return handler_.get();
+	}
+	virtual CefRefPtr<CefRequestHandler> GetRequestHandler() OVERRIDE {
+		return handler_.get();
+	}
+	virtual CefRefPtr<CefRenderHandler> GetRenderHandler() OVERRIDE {
+		// Only windowless browsers paint through the handler.
+		if (route_->frame_buffer_)
+			return handler_.get();
+		return NULL;
+	}
+
+	virtual bool OnProcessMessageReceived(CefRefPtr<CefBrowser> browser,
+		CefProcessId source_process,
+		CefRefPtr<CefProcessMessage> message) OVERRIDE {
+		return handler_->OnProcessMessageReceived(browser, source_process, message);
+	}
+
+	const std::shared_ptr<Route>& GetRoute() const { return route_; }
+
+private:
+	CefRefPtr<CEFClientHandler> handler_;
+	const std::shared_ptr<Route> route_;
+
+	IMPLEMENT_REFCOUNTING(RouteClient);
+	DISALLOW_COPY_AND_ASSIGN(RouteClient);
+};
+
+CEFClientHandler::Route::Route(Delegate* delegate, PageDelegate* page_delegate)
+	: delegate_(delegate)
+	, page_delegate_(page_delegate)
+	, generation_(0)
+	, startup_profile_(NULL)
+{
+}
+
+void CEFClientHandler::Route::DetachDelegate() {
+	DCHECK(delegate_);
+	delegate_ = NULL;
+	page_delegate_ = NULL;
+}
+
+CEFClientHandler::CEFClientHandler(const std::shared_ptr<Route>& route)
+	: route_(route)
 	, browser_count_(0)
 {
 
 }
 
+CEFClientHandler::CEFClientHandler()
+	: browser_count_(0)
+{
+
+}
+
 CEFClientHandler::~CEFClientHandler()
 {
-	delegate_ = NULL;
 }
 
-void CEFClientHandler::DetachDelegate() {
-	DCHECK(delegate_);
-	delegate_ = NULL;
+CefRefPtr<CefClient> CEFClientHandler::GetClientFor(const std::shared_ptr<Route>& route)
+{
+	if (route_)
+		return this;
+
+	return new RouteClient(this, route);
+}
+
+std::string CEFClientHandler::BuildJSResultScript(int requestId, const std::string& token, const std::string& script)
+{
+	CefMessageRouterConfig config = CEFApp::GetMessageRouterConfig();
+
+	std::stringstream ss;
+	ss << "(function() {\n"
+		"var report = function(status, text) {\n"
+		"  window." << config.js_query_function.ToString() << "({ request: '" << CEFJSRequests::kQueryPrefix << requestId << ":" << token << ":' + status + ':' + text,\n"
+		"    onSuccess: function() {}, onFailure: function() {} });\n"
+		"};\n"
+		"try {\n"
+		"  Promise.resolve((function() {\n" << script << "\n  })()).then(function(value) {\n"
+		"    try {\n"
+		"      var json = JSON.stringify(value);\n"
+		"      report('ok', json === undefined ? 'null' : json);\n"
+		"    } catch (e) { report('error', String(e)); }\n"
+		"  }, function(e) { report('error', String(e)); });\n"
+		"} catch (e) { report('error', String(e)); }\n"
+		"})();\n";
+	return ss.str();
+}
+
+const std::shared_ptr<CEFClientHandler::Route>& CEFClientHandler::GetRoute(const CefRefPtr<CefBrowser>& browser)
+{
+	if (route_)
+		return route_;
+
+	const std::shared_ptr<Route>& route = routes_.Find(browser->GetIdentifier());
+	if (route)
+		return route;
+
+	// The first event of a new browser, some come before OnAfterCreated. A
+	// browser created with another client, e.g. the handler itself, has none.
+	CefRefPtr<CefClient> client = browser->GetHost()->GetClient();
+	if (!client || !IsRouteClient(client.get()))
+		return s_kNoRoute;
+
+	return routes_.Insert(browser->GetIdentifier(), static_cast<RouteClient*>(client.get())->GetRoute());
+}
+
+const std::shared_ptr<CEFClientHandler::Route>& CEFClientHandler::FindRoute(const CefRefPtr<CefBrowser>& browser) const
+{
+	if (route_)
+		return route_;
+
+	return routes_.Find(browser->GetIdentifier());
+}
+
+bool CEFClientHandler::IsRouteClient(const CefClient* client) const
+{
+	std::lock_guard<std::mutex> lock(route_clients_lock_);
+	return route_clients_.find(client) != route_clients_.end();
+}
+
+void CEFClientHandler::NotifyDelegate(const CefRefPtr<CefBrowser>& browser, const std::function<void(Delegate*)>& notify)
+{
+	NotifyRoute(browser, [notify](Route* route) {
+		if (route->delegate_)
+			notify(route->delegate_);
+	});
+}
+
+void CEFClientHandler::NotifyPageDelegate(const CefRefPtr<CefBrowser>& browser, const std::function<void(PageDelegate*)>& notify)
+{
+	NotifyRoute(browser, [notify](Route* route) {
+		if (route->page_delegate_)
+			notify(route->page_delegate_);
+	});
+}
+
+void CEFClientHandler::NotifyRoute(const CefRefPtr<CefBrowser>& browser, const std::function<void(Route*)>& notify)
+{
+	const std::shared_ptr<Route>& route = GetRoute(browser);
+	if (!route)
+		return;
+
+	if (!CEFManager::getInstance()->isMulThreadedMessageLoop())
+	{
+		notify(route.get());
+		return;
+	}
+
+	// The delegates live on the cocos thread. Keep the route alive until the
+	// task runs and check the delegates there, they may have detached meanwhile.
+	std::shared_ptr<Route> target(route);
+	unsigned int generation = route->generation_;
+	CEFManager::getInstance()->postToCocosThread([target, notify, generation]() {
+		if (target->generation_ == generation)
+			notify(target.get());
+	});
 }
 
 void CEFClientHandler::OnAfterCreated(CefRefPtr<CefBrowser> browser)
 {
 	CEF_REQUIRE_UI_THREAD();
 
-	browser_count_++;
+	const std::shared_ptr<Route>& route = GetRoute(browser);
+	if (route && route->startup_profile_)
+	{
+		route->startup_profile_->SetIdentifier(browser->GetIdentifier());
+		route->startup_profile_->Mark(CEFStartupProfiler::kAfterCreated);
+	}
+
+	if (!message_router_)
+	{
+		message_router_ = CefMessageRouterBrowserSide::Create(CEFApp::GetMessageRouterConfig());
+		message_router_->AddHandler(this, false);
+	}
 
-	if (delegate_)
-		delegate_->OnBrowserCreated(browser);
+	browser_count_++;
+	CEFManager::getInstance()->onBrowserLifeSpan(true);
+
+	// More browser work usually follows this event.
+	CEFManager::getInstance()->scheduleMessageLoopWork();
+
+	NotifyRoute(browser, [browser](Route* route) {
+		// The window was deleted while CEF created its browser, nobody else
+		// will close it.
+		if (route->delegate_)
+			route->delegate_->OnBrowserCreated(browser);
+		else
+			browser->GetHost()->CloseBrowser(true);
+	});
 }
 
 bool CEFClientHandler::DoClose(CefRefPtr<CefBrowser> browser) 
 {
 	CEF_REQUIRE_UI_THREAD();
 
-	is_closing_ = true;
+	// Closing takes a few more pump iterations to complete.
+	CEFManager::getInstance()->scheduleMessageLoopWork();
 
-	if (delegate_)
-		delegate_->OnBrowserClosing(browser);
+	NotifyDelegate(browser, [browser](Delegate* delegate) {
+		delegate->OnBrowserClosing(browser);
+	});
 
 	// Allow the close. For windowed browsers this will result in the OS close
 	// event being sent.
@@ -52,12 +282,27 @@ void CEFClientHandler::OnBeforeClose(CefRefPtr<CefBrowser> browser)
 {
 	CEF_REQUIRE_UI_THREAD();
 
-	is_closing_ = true;
+	// Pending queries of the browser are canceled.
+	if (message_router_)
+		message_router_->OnBeforeClose(browser);
+
+	if (--browser_count_ == 0 && message_router_)
+	{
+		message_router_->RemoveHandler(this);
+		message_router_ = NULL;
+	}
+
+	NotifyDelegate(browser, [browser](Delegate* delegate) {
+		delegate->OnBrowserClosed(browser);
+	});
 
-	--browser_count_;
-	
-	if (delegate_)
-		delegate_->OnBrowserClosed(browser);
+	// After queuing the notification, so a drain that sees no browser left
+	// also finds it.
+	CEFManager::getInstance()->onBrowserLifeSpan(false);
+
+	// The queued notification keeps the route alive.
+	if (!route_)
+		routes_.Remove(browser->GetIdentifier());
 }
 
 void CEFClientHandler::OnLoadingStateChange(CefRefPtr<CefBrowser> browser,
@@ -67,28 +312,42 @@ void CEFClientHandler::OnLoadingStateChange(CefRefPtr<CefBrowser> browser,
 {
 	CEF_REQUIRE_UI_THREAD();
 
-	if (delegate_)
-		delegate_->OnSetLoadingState(isLoading, canGoBack, canGoForward);
+	CefRefPtr<CurrentEntryVisitor> visitor = new CurrentEntryVisitor();
+	browser->GetHost()->GetNavigationEntries(visitor, true);
+	int historyIndex = visitor->index_;
+
+	NotifyDelegate(browser, [isLoading, canGoBack, canGoForward, historyIndex](Delegate* delegate) {
+		delegate->OnSetLoadingState(isLoading, canGoBack, canGoForward, historyIndex);
+	});
 }
 
 void CEFClientHandler::OnLoadStart(CefRefPtr<CefBrowser> browser, CefRefPtr<CefFrame> frame)
 {
 	CEF_REQUIRE_UI_THREAD();
 
-	if (delegate_)
-	{
-		delegate_->OnLoadingStart(frame->GetURL());
-	}
+	if (!frame->IsMain())
+		return;
+
+	std::string url = frame->GetURL();
+	NotifyPageDelegate(browser, [url](PageDelegate* delegate) {
+		delegate->OnLoadingStart(url);
+	});
 }
 
 void CEFClientHandler::OnLoadEnd(CefRefPtr<CefBrowser> browser, CefRefPtr<CefFrame> frame, int httpStatusCode)
 {
 	CEF_REQUIRE_UI_THREAD();
 
-	if (delegate_)
-	{
-		delegate_->OnLoadingFinish(frame->GetURL());
-	}
+	const std::shared_ptr<Route>& route = GetRoute(browser);
+	if (route && route->startup_profile_ && frame->IsMain())
+		route->startup_profile_->Mark(CEFStartupProfiler::kFirstLoadEnd);
+
+	CEFManager::getInstance()->scheduleMessageLoopWork();
+
+	std::string url = frame->GetURL();
+	NotifyPageDelegate(browser, [url](PageDelegate* delegate) {
+		delegate->OnLoadingFinish(url);
+	});
 }
 
 void CEFClientHandler::OnLoadError(CefRefPtr<CefBrowser> browser,
@@ -111,10 +370,10 @@ void CEFClientHandler::OnLoadError(CefRefPtr<CefBrowser> browser,
 		").</h2></body></html>";
 	frame->LoadString(ss.str(), failedUrl);
 
-	if (delegate_)
-	{
-		delegate_->OnLoadingError(failedUrl);
-	}
+	std::string url = failedUrl;
+	NotifyPageDelegate(browser, [url](PageDelegate* delegate) {
+		delegate->OnLoadingError(url);
+	});
 }
 
 void CEFClientHandler::OnBeforeContextMenu(CefRefPtr<CefBrowser> browser, 
@@ -128,14 +387,220 @@ void CEFClientHandler::OnBeforeContextMenu(CefRefPtr<CefBrowser> browser,
 
 bool CEFClientHandler::OnBeforeBrowse(CefRefPtr<CefBrowser> browser, CefRefPtr<CefFrame> frame, CefRefPtr<CefRequest> request, bool is_redirect)
 {
-	if (delegate_)
+	if (ShouldCancelNavigation(browser, frame, request))
 	{
-		return !delegate_->OnProcessRequest(request->GetURL());
+		return true;
 	}
 
+	// Queries of the page being left are canceled.
+	if (message_router_)
+		message_router_->OnBeforeBrowse(browser, frame);
 	return false;
 }
 
+bool CEFClientHandler::ShouldCancelNavigation(const CefRefPtr<CefBrowser>& browser,
+	const CefRefPtr<CefFrame>& frame,
+	const CefRefPtr<CefRequest>& request)
+{
+	const std::shared_ptr<Route>& route = GetRoute(browser);
+	if (!route)
+	{
+		return false;
+	}
+
+	std::string url = request->GetURL();
+	if (!CEFManager::getInstance()->isMulThreadedMessageLoop())
+	{
+		if (route->page_delegate_)
+		{
+			return !route->page_delegate_->OnProcessRequest(url);
+		}
+
+		return false;
+	}
+
+	// Issued again by ResumeNavigation(), the cocos thread allowed it already.
+	auto approved = std::find(route->approved_urls_.begin(), route->approved_urls_.end(), url);
+	if (approved != route->approved_urls_.end())
+	{
+		route->approved_urls_.erase(approved);
+		return false;
+	}
+
+	// The answer is needed before returning, so block this thread until the
+	// cocos thread drains its tasks. Nothing on the cocos thread waits for the
+	// CEF UI thread, and the timeout covers a stalled game thread.
+	std::shared_ptr<CEFNavigationDecision> decision = std::make_shared<CEFNavigationDecision>();
+	std::shared_ptr<Route> target(route);
+	CEFManager::getInstance()->postToCocosThread([target, url, decision]() {
+		decision->Decide(target->page_delegate_ ? target->page_delegate_->OnProcessRequest(url) : true);
+	});
+
+	bool allowed = false;
+	if (decision->Wait(kProcessRequestTimeoutMs, allowed))
+	{
+		return !allowed;
+	}
+
+	// Fail closed, the navigation must not skip shouldStartLoading nor the
+	// custom scheme. The request is read only here and gone once this returns,
+	// so keep a copy to issue again if the answer turns out to be yes.
+	CefRefPtr<CefRequest> copy = CefRequest::Create();
+	CefRequest::HeaderMap headers;
+	request->GetHeaderMap(headers);
+	copy->Set(url, request->GetMethod(), request->GetPostData(), headers);
+
+	CefRefPtr<CEFClientHandler> self(this);
+	CefRefPtr<CefBrowser> owner(browser);
+	CefRefPtr<CefFrame> source(frame);
+	if (!decision->GiveUp([self, owner, source, copy](bool late_allowed) {
+			if (late_allowed)
+				CefPostTask(TID_UI, base::Bind(&CEFClientHandler::ResumeNavigation, self, owner, source, copy));
+		}, allowed))
+	{
+		return !allowed;
+	}
+
+	return true;
+}
+
+void CEFClientHandler::ResumeNavigation(CefRefPtr<CefBrowser> browser, CefRefPtr<CefFrame> frame, CefRefPtr<CefRequest> request)
+{
+	CEF_REQUIRE_UI_THREAD();
+
+	// The frame may be gone, or the browser closed meanwhile.
+	const std::shared_ptr<Route>& route = FindRoute(browser);
+	if (!route || !route->page_delegate_ || !frame->IsValid())
+		return;
+
+	route->approved_urls_.push_back(request->GetURL());
+	frame->LoadRequest(request);
+}
+
+void CEFClientHandler::OnRenderProcessTerminated(CefRefPtr<CefBrowser> browser, TerminationStatus status)
+{
+	CEF_REQUIRE_UI_THREAD();
+
+	if (message_router_)
+		message_router_->OnRenderProcessTerminated(browser);
+}
+
+bool CEFClientHandler::OnProcessMessageReceived(CefRefPtr<CefBrowser> browser,
+	CefProcessId source_process,
+	CefRefPtr<CefProcessMessage> message)
+{
+	CEF_REQUIRE_UI_THREAD();
+
+	if (message->GetName() == CEFApp::kPostMessage)
+	{
+		CefRefPtr<CefListValue> args = message->GetArgumentList();
+		std::string name = args->GetString(0);
+		std::string payload = args->GetString(1);
+		NotifyPageDelegate(browser, [name, payload](PageDelegate* delegate) {
+			delegate->OnPostMessage(name, payload);
+		});
+		return true;
+	}
+
+	if (message->GetName() == CEFApp::kPostBinaryMessage)
+	{
+		// The message is gone after this call. Its bytes are copied once, into
+		// the buffer the game gets and may keep.
+		CefRefPtr<CefListValue> args = message->GetArgumentList();
+		std::string name = args->GetString(0);
+		CefRefPtr<CefBinaryValue> binary = args->GetBinary(1);
+		std::shared_ptr<cocos2d::Data> data = std::make_shared<cocos2d::Data>();
+		size_t size = binary ? binary->GetSize() : 0;
+		if (size > 0)
+		{
+			unsigned char* bytes = static_cast<unsigned char*>(malloc(size));
+			binary->GetData(bytes, size, 0);
+			data->fastSet(bytes, static_cast<ssize_t>(size));
+		}
+		NotifyPageDelegate(browser, [name, data](PageDelegate* delegate) {
+			delegate->OnPostBinary(name, *data);
+		});
+		return true;
+	}
+
+	return message_router_ && message_router_->OnProcessMessageReceived(browser, source_process, message);
+}
+
+bool CEFClientHandler::OnQuery(CefRefPtr<CefBrowser> browser,
+	CefRefPtr<CefFrame> frame,
+	int64 query_id,
+	const CefString& request,
+	bool persistent,
+	CefRefPtr<Callback> callback)
+{
+	CEF_REQUIRE_UI_THREAD();
+
+	bool is_valid = false;
+	int requestId = 0;
+	std::string token;
+	bool success = false;
+	std::string result;
+	if (!CEFJSRequests::ParseQuery(request, is_valid, requestId, token, success, result))
+	{
+		return false;
+	}
+
+	// The scripts only run in the main frame.
+	if (!frame->IsMain() || !is_valid)
+	{
+		callback->Failure(0, "malformed result");
+		return true;
+	}
+
+	callback->Success(CefString());
+
+	NotifyPageDelegate(browser, [requestId, token, success, result](PageDelegate* delegate) {
+		delegate->OnJSResult(requestId, token, success, result);
+	});
+	return true;
+}
+
+bool CEFClientHandler::GetViewRect(CefRefPtr<CefBrowser> browser, CefRect& rect)
+{
+	int width = 0, height = 0;
+	const std::shared_ptr<Route>& route = GetRoute(browser);
+	if (route && route->frame_buffer_)
+	{
+		route->frame_buffer_->GetViewSize(width, height);
+	}
+
+	// The view must never be empty.
+	rect.Set(0, 0, std::max(width, 1), std::max(height, 1));
+	return true;
+}
+
+void CEFClientHandler::OnPaint(CefRefPtr<CefBrowser> browser,
+	PaintElementType type,
+	const RectList& dirtyRects,
+	const void* buffer,
+	int width, int height)
+{
+	CEF_REQUIRE_UI_THREAD();
+
+	// Popup widgets (<select> lists) are not composited.
+	if (type != PET_VIEW)
+		return;
+
+	const std::shared_ptr<Route>& route = GetRoute(browser);
+	if (!route || !route->frame_buffer_)
+		return;
+
+	std::vector<CEFOsrFrameBuffer::Rect> dirty;
+	dirty.reserve(dirtyRects.size());
+	for (RectList::const_iterator it = dirtyRects.begin(); it != dirtyRects.end(); ++it)
+	{
+		CEFOsrFrameBuffer::Rect rect = { it->x, it->y, it->width, it->height };
+		dirty.push_back(rect);
+	}
+
+	route->frame_buffer_->OnPaint(buffer, width, height, dirty.data(), dirty.size());
+}
+
 bool CEFClientHandler::OnBeforePopup(CefRefPtr<CefBrowser> browser, 
 	CefRefPtr<CefFrame> frame, 
 	const CefString& target_url, 
@@ -158,17 +623,31 @@ bool CEFClientHandler::OnBeforePopup(CefRefPtr<CefBrowser> browser,
 	case WOD_NEW_WINDOW:
 		browser->GetMainFrame()->LoadURL(target_url);
 		return true; //cancel create
+	case WOD_CURRENT_TAB:
+	case WOD_SINGLETON_TAB:
+		if (IsShared())
+		{
+			browser->GetMainFrame()->LoadURL(target_url);
+			return true;
+		}
+		break;
+	default:
+		break;
 	}
 
-	return false;
+	// A popup of the shared handler would be a browser nobody owns, with no
+	// RouteClient for its events to find a route through.
+	return IsShared();
 }
 
 void CEFClientHandler::OnTitleChange(CefRefPtr<CefBrowser> browser, const CefString& title)
 {
 	CEF_REQUIRE_UI_THREAD();
 
-	if (delegate_)
-		delegate_->OnSetTitle(title);
+	std::string text = title;
+	NotifyPageDelegate(browser, [text](PageDelegate* delegate) {
+		delegate->OnSetTitle(text);
+	});
 }
 
 void CEFClientHandler::OnFullscreenModeChange(CefRefPtr<CefBrowser> browser,
@@ -176,8 +655,9 @@ void CEFClientHandler::OnFullscreenModeChange(CefRefPtr<CefBrowser> browser,
 {
 	CEF_REQUIRE_UI_THREAD();
 
-	if (delegate_)
-		delegate_->OnSetFullscreen(fullscreen);
+	NotifyPageDelegate(browser, [fullscreen](PageDelegate* delegate) {
+		delegate->OnSetFullscreen(fullscreen);
+	});
 }
 
 void CEFClientHandler::OnAddressChange(CefRefPtr<CefBrowser> browser,
@@ -188,7 +668,9 @@ void CEFClientHandler::OnAddressChange(CefRefPtr<CefBrowser> browser,
 
 	// Only update the address for the main (top-level) frame.
 	if (frame->IsMain()) {
-		if (delegate_)
-			delegate_->OnSetAddress(url);
+		std::string address = url;
+		NotifyPageDelegate(browser, [address](PageDelegate* delegate) {
+			delegate->OnSetAddress(address);
+		});
 	}
 }
\ No newline at end of file
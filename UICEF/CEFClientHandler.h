@@ -1,29 +1,38 @@
 #pragma once
 
-#include "include/base/cef_lock.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
 #include "include/cef_client.h"
+#include "include/wrapper/cef_message_router.h"
+#include "CEFBrowserTable.h"
+#include "CEFOsrFrameBuffer.h"
+#include "CEFStartupProfiler.h"
+
+namespace cocos2d {
+class Data;
+}
 
 class CEFClientHandler : public CefClient,
 						 public CefDisplayHandler,
 						 public CefLifeSpanHandler,
 						 public CefLoadHandler,
 						 public CefContextMenuHandler,
-						 public CefRequestHandler
+						 public CefRequestHandler,
+						 public CefRenderHandler,
+						 public CefMessageRouterBrowserSide::Handler
 {
 public:
-	// Implement this interface to receive notification of ClientHandler
-	// events. The methods of this class will be called on the main thread.
-	class Delegate {
+	// Implement this interface to receive the events about the page shown by
+	// a browser. They are delivered straight to the owner of the browser. The
+	// methods of this class will be called on the main thread, which is the
+	// cocos thread in multi-threaded message loop mode too.
+	class PageDelegate {
 	public:
-		// Called when the browser is created.
-		virtual void OnBrowserCreated(const CefRefPtr<CefBrowser>& browser) = 0;
-
-		// Called when the browser is closing.
-		virtual void OnBrowserClosing(const CefRefPtr<CefBrowser>& browser) = 0;
-
-		// Called when the browser has been closed.
-		virtual void OnBrowserClosed(const CefRefPtr<CefBrowser>& browser) = 0;
-
 		// Set the window URL address.
 		virtual void OnSetAddress(const std::string& url) = 0;
 
@@ -33,10 +42,7 @@ public:
 		// Set fullscreen mode.
 		virtual void OnSetFullscreen(bool fullscreen) = 0;
 
-		// Set the loading state.
-		virtual void OnSetLoadingState(bool isLoading, bool canGoBack, bool canGoForward) = 0;
-
-		// Called the loading start.
+		// Called when the main frame starts loading a document.
 		virtual void OnLoadingStart(const std::string& url) = 0;
 
 		// Called the loading finish.
@@ -51,16 +57,115 @@ public:
 		// Set the draggable regions.
 		virtual void OnSetDraggableRegions(const std::vector<CefDraggableRegion>& regions) = 0;
 
+		// The page answered the script made by BuildJSResultScript() for
+		// |requestId|. |result| is the JSON of the value, or the error text.
+		// Any script of the page may call this, only trust an answer whose
+		// |token| matches the request.
+		virtual void OnJSResult(int requestId, const std::string& token, bool success, const std::string& result) {}
+
+		// The page called window.cocos.postMessage(name, payload).
+		virtual void OnPostMessage(const std::string& name, const std::string& payload) {}
+
+		// The page called window.cocos.postBinary(name, buffer). |data| is
+		// only valid during the call, which may take its bytes over with
+		// std::move.
+		virtual void OnPostBinary(const std::string& name, cocos2d::Data& data) {}
+
+	protected:
+		virtual ~PageDelegate() {}
+	};
+
+	// Implement this interface to receive the events about the browser
+	// itself, on the same thread as PageDelegate.
+	class Delegate {
+	public:
+		// Called when the browser is created.
+		virtual void OnBrowserCreated(const CefRefPtr<CefBrowser>& browser) = 0;
+
+		// Called when the browser is closing.
+		virtual void OnBrowserClosing(const CefRefPtr<CefBrowser>& browser) = 0;
+
+		// Called when the browser has been closed.
+		virtual void OnBrowserClosed(const CefRefPtr<CefBrowser>& browser) = 0;
+
+		// Set the loading state. |historyIndex| is the index of the current
+		// navigation entry.
+		virtual void OnSetLoadingState(bool isLoading, bool canGoBack, bool canGoForward, int historyIndex) = 0;
+
 	protected:
 		virtual ~Delegate() {}
 	};
 
+	// Where the events of one browser go. Owned by its window and by the
+	// handler until the browser is closed.
+	class Route {
+	public:
+		Route(Delegate* delegate, PageDelegate* page_delegate);
+
+		// The route may outlive the Delegate object so it's necessary for the
+		// Delegate to detach itself before destruction. Page events stop too.
+		void DetachDelegate();
+
+		// Give the page events to another owner. Called on the cocos thread.
+		void SetPageDelegate(PageDelegate* page_delegate) { page_delegate_ = page_delegate; }
+
+		// Events raised before this call are not delivered. Called on the cocos
+		// thread when the browser changes owner, so that events still queued for
+		// the previous owner don't reach the next one.
+		void DropPendingEvents() { ++generation_; }
+
+		// Paint into |frame_buffer| instead of a native window. Must be set
+		// before the browser is created, with CefWindowInfo::SetAsWindowless.
+		void SetFrameBuffer(const std::shared_ptr<CEFOsrFrameBuffer>& frame_buffer) { frame_buffer_ = frame_buffer; }
+
+		// Mark the creation and first load of the browser in |profile|, may be
+		// NULL. Must be set before the browser is created.
+		void SetStartupProfile(CEFStartupProfiler::Browser* profile) { startup_profile_ = profile; }
+
+	private:
+		friend class CEFClientHandler;
+
+		// Only touched on the cocos thread.
+		Delegate* delegate_;
+		PageDelegate* page_delegate_;
+		// Bumped by DropPendingEvents(), events carry the value they were
+		// raised with.
+		std::atomic<unsigned int> generation_;
+		// Set once before the browser is created, thread safe itself.
+		std::shared_ptr<CEFOsrFrameBuffer> frame_buffer_;
+		// Set once before the browser is created, owned by the CEFManager.
+		CEFStartupProfiler::Browser* startup_profile_;
+		// Navigations the cocos thread allowed after OnBeforeBrowse gave up
+		// waiting, let through once when issued again. Only touched on the CEF
+		// UI thread.
+		std::vector<std::string> approved_urls_;
+
+		DISALLOW_COPY_AND_ASSIGN(Route);
+	};
+
+private:
+	class RouteClient;
+
 public:
-	CEFClientHandler(Delegate* delegate);
+	// A handler serving the single browser of |route|.
+	explicit CEFClientHandler(const std::shared_ptr<Route>& route);
+
+	// A handler shared by many browsers, each event is dispatched by browser
+	// identifier through a flat table.
+	CEFClientHandler();
+
 	virtual ~CEFClientHandler();
-	// This object may outlive the Delegate object so it's necessary for the
-	// Delegate to detach itself before destruction.
-	void DetachDelegate();
+
+	// Returns the client to create the browser of |route| with. A handler
+	// serving one browser is its own client. A shared handler returns a small
+	// client carrying |route|, which CEF hands back through
+	// CefBrowserHost::GetClient() the first time the browser shows up.
+	CefRefPtr<CefClient> GetClientFor(const std::shared_ptr<Route>& route);
+
+	// Wrap the function body |script| so that the page reports its return
+	// value, or the value of the promise it returns, to OnJSResult() of the
+	// delegate with |requestId| and |token|, see CEFJSRequests.
+	static std::string BuildJSResultScript(int requestId, const std::string& token, const std::string& script);
 
 	// CefClient methods:
 	virtual CefRefPtr<CefDisplayHandler> GetDisplayHandler() OVERRIDE {
@@ -78,6 +183,16 @@ public:
 	virtual CefRefPtr<CefRequestHandler> GetRequestHandler() OVERRIDE {
 		return this;
 	}
+	virtual CefRefPtr<CefRenderHandler> GetRenderHandler() OVERRIDE {
+		// Only windowless browsers ask, a shared handler serves all of them.
+		if (!route_ || route_->frame_buffer_)
+			return this;
+		return NULL;
+	}
+
+	virtual bool OnProcessMessageReceived(CefRefPtr<CefBrowser> browser,
+		CefProcessId source_process,
+		CefRefPtr<CefProcessMessage> message) OVERRIDE;
 
 	// CefDisplayHandler methods:
 	virtual void OnAddressChange(CefRefPtr<CefBrowser> browser,
@@ -131,19 +246,73 @@ public:
 		CefRefPtr<CefFrame> frame,
 		CefRefPtr<CefRequest> request,
 		bool is_redirect) OVERRIDE;
+	void OnRenderProcessTerminated(CefRefPtr<CefBrowser> browser,
+		TerminationStatus status) OVERRIDE;
+
+	// CefRenderHandler methods:
+	bool GetViewRect(CefRefPtr<CefBrowser> browser, CefRect& rect) OVERRIDE;
+	void OnPaint(CefRefPtr<CefBrowser> browser,
+		PaintElementType type,
+		const RectList& dirtyRects,
+		const void* buffer,
+		int width, int height) OVERRIDE;
+
+	// CefMessageRouterBrowserSide::Handler methods:
+	bool OnQuery(CefRefPtr<CefBrowser> browser,
+		CefRefPtr<CefFrame> frame,
+		int64 query_id,
+		const CefString& request,
+		bool persistent,
+		CefRefPtr<Callback> callback) OVERRIDE;
 
 	// Class member methods:
-	bool IsClosing() const { return is_closing_; }
+	bool IsShared() const { return !route_; }
 	int GetBrowserCount() const { return browser_count_; }
 
 private:
+	// Returns the route of |browser|, empty if it has none. Call on the CEF UI
+	// thread.
+	const std::shared_ptr<Route>& GetRoute(const CefRefPtr<CefBrowser>& browser);
+
+	// Like GetRoute() but never binds a new browser, for tasks that may run
+	// after OnBeforeClose forgot it.
+	const std::shared_ptr<Route>& FindRoute(const CefRefPtr<CefBrowser>& browser) const;
+
+	// Whether |client| is a live RouteClient of this handler.
+	bool IsRouteClient(const CefClient* client) const;
+
+	// Call |notify| with the delegate, or the page delegate, of |browser| on
+	// the cocos thread. Runs it right away unless CEF has its own UI thread.
+	void NotifyDelegate(const CefRefPtr<CefBrowser>& browser, const std::function<void(Delegate*)>& notify);
+	void NotifyPageDelegate(const CefRefPtr<CefBrowser>& browser, const std::function<void(PageDelegate*)>& notify);
+	void NotifyRoute(const CefRefPtr<CefBrowser>& browser, const std::function<void(Route*)>& notify);
+
+	// Returns true if the navigation must be cancelled.
+	bool ShouldCancelNavigation(const CefRefPtr<CefBrowser>& browser,
+		const CefRefPtr<CefFrame>& frame,
+		const CefRefPtr<CefRequest>& request);
+
+	// Issue again a navigation cancelled while the cocos thread was deciding,
+	// which then allowed it. Runs on the CEF UI thread.
+	void ResumeNavigation(CefRefPtr<CefBrowser> browser, CefRefPtr<CefFrame> frame, CefRefPtr<CefRequest> request);
+
+	// The route of a handler serving one browser, NULL if shared.
+	const std::shared_ptr<Route> route_;
+
+	// SHARED HANDLER MEMBERS
+	// Routes by browser identifier. Only touched on the CEF UI thread.
+	CEFBrowserTable<std::shared_ptr<Route> > routes_;
+	// The RouteClients alive, added by GetClientFor() on the cocos thread.
+	mutable std::mutex route_clients_lock_;
+	std::unordered_set<const CefClient*> route_clients_;
+
 	// MAIN THREAD MEMBERS
 	// The following members will only be accessed on the main thread. This will
 	// be the same as the CEF UI thread except when using multi-threaded message
-	// loop mode on Windows.
-	Delegate* delegate_;
+	// loop mode on Windows, where they are touched on the CEF UI thread only.
 	int browser_count_;
-	bool is_closing_;
+	// Created with the first browser and dropped with the last one.
+	CefRefPtr<CefMessageRouterBrowserSide> message_router_;
 
 	// Include the default reference counting implementation.
 	IMPLEMENT_REFCOUNTING(CEFClientHandler);
@@ -0,0 +1,137 @@
+#include "CEFCommandQueue.h"
+
+static bool IsLoad(CEFCommandQueue::Type type)
+{
+	return type != CEFCommandQueue::kExecuteJavaScript;
+}
+
+CEFCommandQueue::CEFCommandQueue()
+	: is_waiting_for_load_(false)
+	, collapsed_count_(0)
+{
+}
+
+void CEFCommandQueue::LoadURL(const std::string& url)
+{
+	DropTrailingLoads();
+	Push(kLoadURL, url, std::string());
+}
+
+void CEFCommandQueue::LoadString(const std::string& content, const std::string& url)
+{
+	DropTrailingLoads();
+	Push(kLoadString, url, content);
+}
+
+void CEFCommandQueue::Reload()
+{
+	if (commands_.empty() || IsLoad(commands_.back().type))
+	{
+		++collapsed_count_;
+		return;
+	}
+
+	Push(kReload, std::string(), std::string());
+}
+
+void CEFCommandQueue::StopLoad()
+{
+	DropTrailingLoads();
+	++collapsed_count_;
+}
+
+void CEFCommandQueue::ExecuteJavaScript(const std::string& code, const std::string& url, int tag)
+{
+	Push(kExecuteJavaScript, url, code, tag);
+}
+
+bool CEFCommandQueue::TakeInitialURL(std::string& url)
+{
+	if (commands_.empty() || commands_.front().type != kLoadURL)
+	{
+		return false;
+	}
+
+	url = commands_.front().url;
+	commands_.erase(commands_.begin());
+	is_waiting_for_load_ = true;
+	return true;
+}
+
+void CEFCommandQueue::Replay(Target& target)
+{
+	if (is_waiting_for_load_)
+	{
+		return;
+	}
+
+	// Swap first, |target| may queue new commands while replaying.
+	std::vector<Command> commands;
+	commands.swap(commands_);
+
+	size_t i = 0;
+	while (i < commands.size())
+	{
+		const Command& command = commands[i++];
+		switch (command.type)
+		{
+		case kLoadURL:
+			target.LoadURL(command.url);
+			break;
+		case kLoadString:
+			target.LoadString(command.content, command.url);
+			break;
+		case kReload:
+			target.Reload();
+			break;
+		case kExecuteJavaScript:
+			target.ExecuteJavaScript(command.content, command.url, command.tag);
+			break;
+		}
+
+		if (IsLoad(command.type))
+		{
+			is_waiting_for_load_ = true;
+			break;
+		}
+	}
+
+	// Keep what waits for the load ahead of what |target| queued.
+	commands_.insert(commands_.begin(), commands.begin() + i, commands.end());
+}
+
+void CEFCommandQueue::ResumeAfterLoad(Target& target)
+{
+	if (!is_waiting_for_load_)
+	{
+		return;
+	}
+
+	is_waiting_for_load_ = false;
+	Replay(target);
+}
+
+void CEFCommandQueue::Clear()
+{
+	commands_.clear();
+	is_waiting_for_load_ = false;
+}
+
+void CEFCommandQueue::DropTrailingLoads()
+{
+	while (!commands_.empty() && IsLoad(commands_.back().type))
+	{
+		commands_.pop_back();
+		++collapsed_count_;
+	}
+}
+
+void CEFCommandQueue::Push(Type type, const std::string& url, const std::string& content, int tag)
+{
+	Command command;
+	command.type = type;
+	command.url = url;
+	command.content = content;
+	command.tag = tag;
+	commands_.push_back(command);
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Records what a web view is asked to do before its browser exists and replays
+// it once the browser is created. Redundant navigations are collapsed on the
+// way in, so only the last one reaches the network:
+// - A load replaces the loads and reloads queued right before it.
+// - A reload right after a load, or with nothing queued, is dropped.
+// - A stop cancels the loads queued right before it and is dropped itself,
+//   nothing can be loading yet.
+// Scripts are kept in order and end a run of loads. Replay stops after a
+// load, what follows waits for ResumeAfterLoad() once that load commits, so
+// each script runs against the document that would have been current.
+//
+// This class does not depend on CEF so it can be driven by a stub browser.
+class CEFCommandQueue
+{
+public:
+	enum Type
+	{
+		kLoadURL,
+		kLoadString,
+		kReload,
+		kExecuteJavaScript,
+	};
+
+	struct Command
+	{
+		Type type;
+		// The URL to load, or the base URL of a string or script.
+		std::string url;
+		// The document of kLoadString, the code of kExecuteJavaScript.
+		std::string content;
+		// Given back with a script, 0 if none.
+		int tag;
+	};
+
+	// What the commands are replayed on.
+	class Target
+	{
+	public:
+		virtual void LoadURL(const std::string& url) = 0;
+		virtual void LoadString(const std::string& content, const std::string& url) = 0;
+		virtual void Reload() = 0;
+		virtual void ExecuteJavaScript(const std::string& code, const std::string& url, int tag) = 0;
+
+	protected:
+		virtual ~Target() {}
+	};
+
+	CEFCommandQueue();
+
+	void LoadURL(const std::string& url);
+	void LoadString(const std::string& content, const std::string& url);
+	void Reload();
+	void StopLoad();
+	void ExecuteJavaScript(const std::string& code, const std::string& url, int tag = 0);
+
+	// Remove the load of a URL opening the queue and return its URL, so the
+	// browser can be created on it rather than on a blank page. Returns false
+	// if the queue starts with anything else. What follows waits for that load.
+	bool TakeInitialURL(std::string& url);
+
+	// Run the queued commands on |target| in order, up to and including the
+	// first load. The rest stays queued until ResumeAfterLoad(). Does nothing
+	// while waiting for a load.
+	void Replay(Target& target);
+
+	// Called once the load replayed last commits, or is given up. Replays
+	// what was waiting for it.
+	void ResumeAfterLoad(Target& target);
+
+	// True while commands wait for a load to commit. New commands must be
+	// queued behind them rather than sent.
+	bool IsWaitingForLoad() const { return is_waiting_for_load_ && !commands_.empty(); }
+
+	void Clear();
+	bool IsEmpty() const { return commands_.empty(); }
+	const std::vector<Command>& GetCommands() const { return commands_; }
+
+	// Number of commands dropped by collapsing.
+	uint64_t GetCollapsedCount() const { return collapsed_count_; }
+
+private:
+	// Drop the loads and reloads at the back of the queue.
+	void DropTrailingLoads();
+	void Push(Type type, const std::string& url, const std::string& content, int tag = 0);
+
+	std::vector<Command> commands_;
+	bool is_waiting_for_load_;
+	uint64_t collapsed_count_;
+};
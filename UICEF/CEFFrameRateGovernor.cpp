@@ -0,0 +1,107 @@
+#include "CEFFrameRateGovernor.h"
+
+#include <algorithm>
+#include <chrono>
+
+static double SteadyClockSeconds()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+CEFFrameRateGovernor::Policy::Policy()
+	: max_fps(60)
+	, small_view_fps(15)
+	, small_area_fraction(0.1f)
+	, unfocused_fps(30)
+	, idle_fps(10)
+	, idle_after(2.0)
+	, lower_delay(1.0)
+{
+}
+
+CEFFrameRateGovernor::CEFFrameRateGovernor(const Clock& clock)
+	: clock_(clock ? clock : Clock(SteadyClockSeconds))
+	, is_visible_(true)
+	, is_focused_(true)
+	, coverage_(1.0f)
+	, frame_rate_(policy_.max_fps)
+	, lower_since_(-1.0)
+{
+	last_paint_ = clock_();
+}
+
+void CEFFrameRateGovernor::SetPolicy(const Policy& policy)
+{
+	policy_ = policy;
+}
+
+void CEFFrameRateGovernor::SetVisible(bool visible)
+{
+	is_visible_ = visible;
+}
+
+void CEFFrameRateGovernor::SetFocused(bool focused)
+{
+	is_focused_ = focused;
+}
+
+void CEFFrameRateGovernor::SetScreenCoverage(float fraction)
+{
+	coverage_ = std::max(0.0f, std::min(fraction, 1.0f));
+}
+
+void CEFFrameRateGovernor::OnPaint()
+{
+	last_paint_ = clock_();
+}
+
+int CEFFrameRateGovernor::GetWantedFrameRate() const
+{
+	if (!is_visible_ || coverage_ <= 0.0f)
+	{
+		return 0;
+	}
+
+	int fps = policy_.max_fps;
+	if (coverage_ < policy_.small_area_fraction)
+	{
+		fps = std::min(fps, policy_.small_view_fps);
+	}
+	if (!is_focused_)
+	{
+		fps = std::min(fps, policy_.unfocused_fps);
+	}
+	if (clock_() - last_paint_ >= policy_.idle_after)
+	{
+		fps = std::min(fps, policy_.idle_fps);
+	}
+
+	return std::max(fps, 1);
+}
+
+int CEFFrameRateGovernor::Update()
+{
+	int wanted = GetWantedFrameRate();
+
+	// Hiding and raising the rate apply at once.
+	if (wanted == 0 || wanted >= frame_rate_ || frame_rate_ == 0)
+	{
+		frame_rate_ = wanted;
+		lower_since_ = -1.0;
+		return frame_rate_;
+	}
+
+	double now = clock_();
+	if (lower_since_ < 0.0)
+	{
+		lower_since_ = now;
+	}
+
+	if (now - lower_since_ >= policy_.lower_delay)
+	{
+		frame_rate_ = wanted;
+		lower_since_ = -1.0;
+	}
+
+	return frame_rate_;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <functional>
+
+// Picks the frame rate a web view should render at from what the player can
+// see of it. Hidden views get 0, views that are small, unfocused or showing
+// static content get a lower rate than a full-screen animated page.
+//
+// Raising the rate takes effect at once. Lowering it waits until the lower
+// rate has been wanted for |Policy::lower_delay| seconds so that short pauses
+// in an animation don't make the rate flap.
+//
+// The clock is injectable so the decisions can be tested without waiting.
+class CEFFrameRateGovernor
+{
+public:
+	// Returns a monotonic time in seconds.
+	typedef std::function<double()> Clock;
+
+	struct Policy
+	{
+		int max_fps;
+		// Rate for views covering less than |small_area_fraction| of the screen.
+		int small_view_fps;
+		float small_area_fraction;
+		int unfocused_fps;
+		// Rate once nothing was painted for |idle_after| seconds.
+		int idle_fps;
+		double idle_after;
+		double lower_delay;
+
+		Policy();
+	};
+
+	explicit CEFFrameRateGovernor(const Clock& clock = Clock());
+
+	void SetPolicy(const Policy& policy);
+	const Policy& GetPolicy() const { return policy_; }
+
+	void SetVisible(bool visible);
+	void SetFocused(bool focused);
+
+	// Fraction of the screen covered by the view, 0 to 1.
+	void SetScreenCoverage(float fraction);
+
+	// The browser painted a new frame.
+	void OnPaint();
+
+	// Re-evaluate the inputs and return the rate to apply, 0 means hidden.
+	int Update();
+
+	// Last value returned by Update().
+	int GetFrameRate() const { return frame_rate_; }
+
+	// The rate the inputs ask for right now, before the lowering delay.
+	int GetWantedFrameRate() const;
+
+private:
+	Clock clock_;
+	Policy policy_;
+	bool is_visible_;
+	bool is_focused_;
+	float coverage_;
+	double last_paint_;
+	int frame_rate_;
+	// When the current lower rate started being wanted, < 0 if it isn't.
+	double lower_since_;
+};
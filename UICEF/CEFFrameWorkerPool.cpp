@@ -0,0 +1,54 @@
+#include "CEFFrameWorkerPool.h"
+
+CEFFrameWorkerPool::CEFFrameWorkerPool(int thread_count)
+	: is_stopping_(false)
+{
+	for (int i = 0; i < thread_count || i == 0; ++i)
+	{
+		threads_.push_back(std::thread(&CEFFrameWorkerPool::Run, this));
+	}
+}
+
+CEFFrameWorkerPool::~CEFFrameWorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(lock_);
+		is_stopping_ = true;
+	}
+	cond_.notify_all();
+
+	for (size_t i = 0; i < threads_.size(); ++i)
+	{
+		threads_[i].join();
+	}
+}
+
+void CEFFrameWorkerPool::PostTask(std::function<void()>&& task)
+{
+	{
+		std::lock_guard<std::mutex> lock(lock_);
+		tasks_.push_back(std::move(task));
+	}
+	cond_.notify_one();
+}
+
+void CEFFrameWorkerPool::Run()
+{
+	std::unique_lock<std::mutex> lock(lock_);
+	for (;;)
+	{
+		cond_.wait(lock, [this] { return is_stopping_ || !tasks_.empty(); });
+		if (tasks_.empty())
+		{
+			// Stopping and drained.
+			return;
+		}
+
+		std::function<void()> task = std::move(tasks_.front());
+		tasks_.pop_front();
+
+		lock.unlock();
+		task();
+		lock.lock();
+	}
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Small thread pool for converting off-screen frames away from the cocos
+// thread. Tasks run in FIFO order on whichever worker is free; the frame
+// buffers serialize their own work on top of it.
+class CEFFrameWorkerPool
+{
+public:
+	explicit CEFFrameWorkerPool(int thread_count);
+
+	// Runs the tasks already posted, then joins the workers.
+	~CEFFrameWorkerPool();
+
+	void PostTask(std::function<void()>&& task);
+
+	int GetThreadCount() const { return static_cast<int>(threads_.size()); }
+
+private:
+	void Run();
+
+	std::mutex lock_;
+	std::condition_variable cond_;
+	std::deque<std::function<void()> > tasks_;
+	std::vector<std::thread> threads_;
+	bool is_stopping_;
+
+	CEFFrameWorkerPool(const CEFFrameWorkerPool&);
+	CEFFrameWorkerPool& operator=(const CEFFrameWorkerPool&);
+};
@@ -0,0 +1,106 @@
+#include "CEFJSBatch.h"
+
+// Runs the array of scripts it is called with. Whether inline scripts are
+// allowed is probed once per document and kept on window.
+static const char s_kRunnerPrefix[] =
+	"(function(s){"
+	"var w=window,d=document,r=d.documentElement;"
+	"var add=function(t){var e=d.createElement('script');e.textContent=t;r.appendChild(e);r.removeChild(e);};"
+	"if(r&&w.__cocosInlineScripts===undefined){"
+	"w.__cocosInlineScripts=false;"
+	"w.__cocosInlineProbe=function(){w.__cocosInlineScripts=true;};"
+	"add('__cocosInlineProbe()');"
+	"delete w.__cocosInlineProbe;}"
+	"for(var i=0;i<s.length;++i){"
+	"if(r&&w.__cocosInlineScripts)add(s[i]);"
+	"else try{(0,eval)(s[i]);}catch(e){console.error(e);}}"
+	"})([";
+static const char s_kRunnerSuffix[] = "]);";
+
+CEFJSBatch::CEFJSBatch()
+	: count_(0)
+{
+}
+
+void CEFJSBatch::Add(const std::string& script)
+{
+	if (count_ == 0)
+	{
+		first_ = script;
+	}
+	else
+	{
+		items_ += ',';
+	}
+	AppendJSONString(items_, script);
+	++count_;
+}
+
+std::string CEFJSBatch::Take()
+{
+	if (count_ == 1)
+	{
+		std::string script;
+		script.swap(first_);
+		Clear();
+		return script;
+	}
+
+	std::string script;
+	script.reserve(sizeof(s_kRunnerPrefix) + items_.size() + sizeof(s_kRunnerSuffix));
+	script += s_kRunnerPrefix;
+	script += items_;
+	script += s_kRunnerSuffix;
+
+	Clear();
+	return script;
+}
+
+void CEFJSBatch::Clear()
+{
+	first_.clear();
+	items_.clear();
+	count_ = 0;
+}
+
+void CEFJSBatch::AppendJSONString(std::string& out, const std::string& text)
+{
+	static const char kHex[] = "0123456789abcdef";
+
+	out.reserve(out.size() + text.size() + 2);
+	out += '"';
+	for (size_t i = 0; i < text.size(); ++i)
+	{
+		unsigned char c = static_cast<unsigned char>(text[i]);
+		switch (c)
+		{
+		case '"': out += "\\\""; break;
+		case '\\': out += "\\\\"; break;
+		case '\n': out += "\\n"; break;
+		case '\r': out += "\\r"; break;
+		case '\t': out += "\\t"; break;
+		case '\b': out += "\\b"; break;
+		case '\f': out += "\\f"; break;
+		default:
+			if (c < 0x20)
+			{
+				out += "\\u00";
+				out += kHex[c >> 4];
+				out += kHex[c & 0xf];
+			}
+			// U+2028 and U+2029 end a line in a JavaScript string.
+			else if (c == 0xe2 && i + 2 < text.size() && static_cast<unsigned char>(text[i + 1]) == 0x80 &&
+				(static_cast<unsigned char>(text[i + 2]) & 0xfe) == 0xa8)
+			{
+				out += static_cast<unsigned char>(text[i + 2]) == 0xa8 ? "\\u2028" : "\\u2029";
+				i += 2;
+			}
+			else
+			{
+				out += static_cast<char>(c);
+			}
+			break;
+		}
+	}
+	out += '"';
+}
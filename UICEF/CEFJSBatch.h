@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Collects scripts to run in a page as one execution that behaves like one
+// execution per script. The scripts cross as an array of JSON strings and
+// the page runs each as a classic script of its own, through a script
+// element, so its top-level let, const and class declarations stay global
+// and its syntax errors and exceptions don't stop the others. Where the
+// content security policy forbids inline scripts, each runs through an
+// indirect eval in its own try block instead: var and function declarations
+// still become globals there, lexical ones stay local to the script.
+//
+// This class does not depend on CEF so the scripts it builds can be checked
+// on their own.
+class CEFJSBatch
+{
+public:
+	CEFJSBatch();
+
+	void Add(const std::string& script);
+
+	// Returns the script running everything added since the last call, and
+	// starts a new batch. A lone script is returned as is.
+	std::string Take();
+
+	void Clear();
+
+	bool IsEmpty() const { return count_ == 0; }
+	size_t GetCount() const { return count_; }
+
+	// Append |text|, UTF-8, to |out| as a JSON string literal that is also a
+	// valid JavaScript one.
+	static void AppendJSONString(std::string& out, const std::string& text);
+
+private:
+	// The first script of the batch, as given.
+	std::string first_;
+	// The JSON strings of the scripts, comma separated.
+	std::string items_;
+	size_t count_;
+
+	CEFJSBatch(const CEFJSBatch&);
+	CEFJSBatch& operator=(const CEFJSBatch&);
+};
@@ -0,0 +1,96 @@
+#include "CEFJSRequests.h"
+#include <cstdlib>
+
+const char CEFJSRequests::kQueryPrefix[] = "cocos-result:";
+
+CEFJSRequests::CEFJSRequests()
+	: next_id_(0)
+{
+	std::random_device device;
+	std::seed_seq seed{ device(), device(), device(), device() };
+	engine_.seed(seed);
+}
+
+int CEFJSRequests::Add(const Callback& callback, std::string& token, bool held)
+{
+	static const char kHex[] = "0123456789abcdef";
+
+	uint64_t value = engine_();
+	token.resize(16);
+	for (size_t i = 0; i < 16; ++i)
+	{
+		token[i] = kHex[(value >> (i * 4)) & 0xf];
+	}
+
+	int id = ++next_id_;
+	Entry& entry = requests_[id];
+	entry.token = token;
+	entry.callback = callback;
+	entry.held = held;
+	return id;
+}
+
+void CEFJSRequests::MarkSent(int id)
+{
+	auto iter = requests_.find(id);
+	if (iter != requests_.end())
+	{
+		iter->second.held = false;
+	}
+}
+
+bool CEFJSRequests::Take(int id, const std::string* token, Callback& callback)
+{
+	auto iter = requests_.find(id);
+	if (iter == requests_.end() || (token && *token != iter->second.token))
+	{
+		return false;
+	}
+
+	callback = iter->second.callback;
+	requests_.erase(iter);
+	return true;
+}
+
+void CEFJSRequests::TakeAll(std::vector<Request>& requests, bool include_held)
+{
+	for (auto iter = requests_.begin(); iter != requests_.end();)
+	{
+		if (iter->second.held && !include_held)
+		{
+			++iter;
+			continue;
+		}
+
+		Request request = { iter->first, iter->second.token, iter->second.callback };
+		requests.push_back(request);
+		iter = requests_.erase(iter);
+	}
+}
+
+bool CEFJSRequests::ParseQuery(const std::string& query, bool& is_valid, int& id, std::string& token,
+	bool& success, std::string& result)
+{
+	static const size_t kPrefixLength = sizeof(kQueryPrefix) - 1;
+
+	is_valid = false;
+	if (query.compare(0, kPrefixLength, kQueryPrefix) != 0)
+	{
+		return false;
+	}
+
+	size_t id_end = query.find(':', kPrefixLength);
+	size_t token_end = id_end == std::string::npos ? std::string::npos : query.find(':', id_end + 1);
+	size_t status_end = token_end == std::string::npos ? std::string::npos : query.find(':', token_end + 1);
+	if (status_end == std::string::npos || id_end == kPrefixLength)
+	{
+		return true;
+	}
+
+	id = atoi(query.substr(kPrefixLength, id_end - kPrefixLength).c_str());
+	token = query.substr(id_end + 1, token_end - id_end - 1);
+	success = query.compare(token_end + 1, status_end - token_end - 1, "ok") == 0;
+	result = query.substr(status_end + 1);
+	is_valid = true;
+	return true;
+}
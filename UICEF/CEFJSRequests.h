@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// The requests of evaluateJSAsync waiting for the page to answer. Each gets a
+// sequential ID and a random token. The page reports through window.cefQuery,
+// which any script of the page can call, so an answer only counts if it
+// carries the token of its request: a script can't settle a request it
+// wasn't given by guessing the next ID.
+//
+// The answers are queries of the form
+// "cocos-result:<id>:<token>:<ok|error>:<result>".
+//
+// This class does not depend on CEF so it can be driven by a stub router.
+// Not thread safe.
+class CEFJSRequests
+{
+public:
+	typedef std::function<void(bool success, const std::string& result)> Callback;
+
+	struct Request
+	{
+		int id;
+		std::string token;
+		Callback callback;
+	};
+
+	// Prefix of the queries answering a request.
+	static const char kQueryPrefix[];
+
+	CEFJSRequests();
+
+	// Returns the ID of a new request, and its token in |token|. A |held|
+	// request's script waits in the command queue for a load, see MarkSent.
+	int Add(const Callback& callback, std::string& token, bool held = false);
+
+	// The script of the held request |id| went to the page.
+	void MarkSent(int id);
+
+	// Remove the request |id| and return its callback in |callback|. Returns
+	// false if there is no such request, or if |token| is given and isn't its
+	// token.
+	bool Take(int id, const std::string* token, Callback& callback);
+
+	// Remove every request, appending them to |requests|. Without
+	// |include_held| the held ones stay, the page they wait for isn't loaded.
+	void TakeAll(std::vector<Request>& requests, bool include_held = true);
+
+	bool IsEmpty() const { return requests_.empty(); }
+
+	// Split a query made for a request. Returns false if |query| doesn't
+	// start with kQueryPrefix, |is_valid| tells whether the rest is well formed.
+	static bool ParseQuery(const std::string& query, bool& is_valid, int& id, std::string& token,
+		bool& success, std::string& result);
+
+private:
+	struct Entry
+	{
+		std::string token;
+		Callback callback;
+		bool held;
+	};
+
+	std::unordered_map<int, Entry> requests_;
+	int next_id_;
+	std::mt19937_64 engine_;
+
+	CEFJSRequests(const CEFJSRequests&);
+	CEFJSRequests& operator=(const CEFJSRequests&);
+};
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Bounded lock-free queue for many producers and a single consumer, based on
+// Dmitry Vyukov's bounded MPMC array queue. Every slot carries a sequence
+// number so producers claim slots with a single CAS and the consumer never
+// takes a lock. Items are popped in the order their slots were claimed, so the
+// order of each producer is preserved.
+//
+// TryPush() and TryPop() may be called from any number of producer threads and
+// exactly one consumer thread respectively.
+template <typename T>
+class CEFMPSCQueue
+{
+public:
+	// |capacity| is rounded up to a power of two.
+	explicit CEFMPSCQueue(size_t capacity)
+		: cells_(RoundUpToPowerOfTwo(capacity))
+		, mask_(cells_.size() - 1)
+		, enqueue_pos_(0)
+		, dequeue_pos_(0)
+	{
+		for (size_t i = 0; i < cells_.size(); ++i)
+		{
+			cells_[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	// Returns false if the queue is full.
+	bool TryPush(T&& value)
+	{
+		Cell* cell;
+		size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			cell = &cells_[pos & mask_];
+			size_t seq = cell->sequence.load(std::memory_order_acquire);
+			intptr_t dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+			if (dif == 0)
+			{
+				if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					break;
+				}
+			}
+			else if (dif < 0)
+			{
+				return false;
+			}
+			else
+			{
+				pos = enqueue_pos_.load(std::memory_order_relaxed);
+			}
+		}
+
+		cell->data = std::move(value);
+		cell->sequence.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Returns false if the queue is empty, or if the oldest claimed slot has
+	// not been published yet.
+	bool TryPop(T& value)
+	{
+		Cell* cell = &cells_[dequeue_pos_ & mask_];
+		size_t seq = cell->sequence.load(std::memory_order_acquire);
+		if (static_cast<intptr_t>(seq) - static_cast<intptr_t>(dequeue_pos_ + 1) < 0)
+		{
+			return false;
+		}
+
+		value = std::move(cell->data);
+		cell->data = T();
+		cell->sequence.store(dequeue_pos_ + mask_ + 1, std::memory_order_release);
+		++dequeue_pos_;
+		return true;
+	}
+
+	size_t Capacity() const { return cells_.size(); }
+
+private:
+	struct Cell
+	{
+		std::atomic<size_t> sequence;
+		T data;
+
+		Cell() : sequence(0) {}
+		Cell(const Cell&) : sequence(0) {}
+	};
+
+	static size_t RoundUpToPowerOfTwo(size_t value)
+	{
+		size_t result = 2;
+		while (result < value)
+		{
+			result <<= 1;
+		}
+		return result;
+	}
+
+	std::vector<Cell> cells_;
+	const size_t mask_;
+
+	// Keep the producer and consumer positions on separate cache lines.
+	char pad0_[64];
+	std::atomic<size_t> enqueue_pos_;
+	char pad1_[64];
+	size_t dequeue_pos_;
+
+	CEFMPSCQueue(const CEFMPSCQueue&);
+	CEFMPSCQueue& operator=(const CEFMPSCQueue&);
+};
@@ -1,9 +1,38 @@
 #include "CEFManager.h"
+#include "CEFApp.h"
+#include "CEFBrowserPool.h"
 #include "CEFClientHandler.h"
 #include "CEFWebViewWrapper.h"
 #include "./include/cef_app.h"
 
-#define USE_CEF_MULTI_THREADED_MESSAGE_LOOP false
+// Pump interval while there is work or a browser on screen, and the upper
+// bound of the backoff once every browser is hidden and idle.
+static const int kMessagePumpMinDelayMs = 10;
+static const int kMessagePumpMaxDelayMs = 100;
+
+// Default share of a 60 fps frame that CEF may use.
+static const float kMessageLoopFrameBudgetMs = 4.0f;
+
+// Tasks from the CEF UI thread that can wait for the next frame. A full queue
+// makes producers wait rather than drop events.
+static const size_t kCocosThreadTaskCapacity = 1024;
+
+// One thread keeps paint conversion off the CEF UI thread for a few web views.
+static const int kDefaultFrameWorkerCount = 1;
+
+// How long CefShutdown waits for the browsers to close, and how often the
+// wait pumps CEF when it has no UI thread of its own.
+static const int kShutdownDrainTimeoutMs = 1000;
+static const int kShutdownDrainSliceMs = 10;
+
+static const char* const s_kShutdownUpdateKey = "CEFManager::updateShutdown";
+
+static const CEFManager::ColdStartStats kEmptyColdStartStats = { false, 0.0, 0.0, 0.0, 0.0 };
+
+static double MillisecondsSince(const std::chrono::steady_clock::time_point& start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
 
 CEFManager* CEFManager::instance_ = nullptr;
 
@@ -27,79 +56,456 @@ void CEFManager::releaseInstance()
 }
 
 CEFManager::CEFManager()
-	: is_close_cef_(false)
+	: shutdown_drain_timeout_ms_(kShutdownDrainTimeoutMs)
+	, is_lazy_init_(false)
+	, is_init_pending_(false)
+	, is_init_scheduled_(false)
+	, is_initialized_(false)
+	, is_multi_process_(true)
+	, instance_handle_(NULL)
+	, cold_start_stats_(kEmptyColdStartStats)
+	, is_first_browser_requested_(false)
+	, is_first_browser_created_(false)
+	, is_multi_threaded_loop_(false)
+	, is_windowless_rendering_(false)
+	, frame_worker_count_(kDefaultFrameWorkerCount)
+	, browser_pool_(new CEFBrowserPool())
+	, is_shared_client_handler_(false)
+	, loading_browser_count_(0)
+	, visible_browser_count_(0)
+	, message_loop_budget_(kMessageLoopFrameBudgetMs)
+	, after_draw_listener_(nullptr)
+	, is_after_draw_(false)
+	, message_pump_(std::bind(&CEFManager::dispatchMessageLoop, this), kMessagePumpMinDelayMs, kMessagePumpMaxDelayMs)
+	, cocos_thread_tasks_(kCocosThreadTaskCapacity)
 {
+	CEFShutdownCoordinator::Callbacks callbacks;
+	callbacks.started = [this]() {
+		cocos2d::Director::getInstance()->getScheduler()->schedule([this](float) {
+			shutdown_coordinator_.Update();
+		}, this, 0.0f, false, s_kShutdownUpdateKey);
+	};
+	callbacks.finished = [this]() {
+		cocos2d::Director::getInstance()->getScheduler()->unschedule(s_kShutdownUpdateKey, this);
+		logShutdownReports();
+	};
+	callbacks.quit = []() {
+		//quit message should run in main thread.
+		cocos2d::AsyncTaskPool::getInstance()->enqueue(cocos2d::AsyncTaskPool::TaskType::TASK_OTHER, [](void*) {
+			::PostQuitMessage(0);
+		}, nullptr, []() {});
+	};
+	shutdown_coordinator_.SetCallbacks(callbacks);
 }
 
 CEFManager::~CEFManager()
 {
-	if (thread_.joinable())
-	{
-		thread_.join();
-	}
+	// The Director may be gone already, so only move the state here.
+	shutdown_state_.Advance(CEFShutdownState::kClosing);
+	message_pump_.Stop();
+
+	// Deliver what the CEF UI thread sent before the browsers went away.
+	runCocosThreadTasks();
+
+	frame_worker_pool_.reset();
+
+	// Drop the references to pooled browsers while CEF is still alive.
+	browser_pool_.reset();
+	shared_client_handler_ = NULL;
 
 	releaseCEF();
 }
 
-bool CEFManager::initCEF(HINSTANCE instance, bool bMultiProcess)
+bool CEFManager::initCEF(HINSTANCE instance, bool bMultiProcess, bool bMultiThreadedMessageLoop)
 {
 	CefMainArgs mainargs(instance);
+	cocos_thread_id_ = std::this_thread::get_id();
+
+	// The render process needs the app for the JS side of the message router.
+	cef_app_ = new CEFApp();
 
-	int exit_code = CefExecuteProcess(mainargs, NULL, NULL);
+	// Sub-processes run the same executable, so this can't be deferred.
+	startup_profiler_.BeginPhase(CEFStartupProfiler::kExecuteProcess);
+	int exit_code = CefExecuteProcess(mainargs, cef_app_, NULL);
+	startup_profiler_.EndPhase(CEFStartupProfiler::kExecuteProcess);
+	cold_start_stats_.execute_process_ms = startup_profiler_.GetPhaseMs(CEFStartupProfiler::kExecuteProcess);
 	if (exit_code >= 0)
 	{
 		// The sub-process has completed so return here.
 		return false;
 	}
 
+	instance_handle_ = instance;
+	is_multi_process_ = bMultiProcess;
+	is_multi_threaded_loop_ = bMultiThreadedMessageLoop;
+	is_init_pending_ = true;
+	cold_start_stats_.lazy = is_lazy_init_;
+
+	startup_profiler_.BeginPhase(CEFStartupProfiler::kEnableHighDPISupport);
 	CefEnableHighDPISupport();
+	startup_profiler_.EndPhase(CEFStartupProfiler::kEnableHighDPISupport);
+
+	if (is_lazy_init_)
+	{
+		return true;
+	}
+
+	return ensureInitialized();
+}
+
+bool CEFManager::ensureInitialized()
+{
+	if (!is_init_pending_)
+	{
+		return is_initialized_;
+	}
+	is_init_pending_ = false;
+
+	CefMainArgs mainargs(instance_handle_);
 	CefSettings settings;
 	settings.multi_threaded_message_loop = isMulThreadedMessageLoop();
+	settings.windowless_rendering_enabled = is_windowless_rendering_;
 	settings.no_sandbox = true;
-	settings.single_process = !bMultiProcess;
+	settings.single_process = !is_multi_process_;
+
+	startup_profiler_.BeginPhase(CEFStartupProfiler::kInitialize);
 	auto ret = CefInitialize(mainargs, settings, cef_app_, nullptr);
-	if (ret)
+	startup_profiler_.EndPhase(CEFStartupProfiler::kInitialize);
+	cold_start_stats_.initialize_ms = startup_profiler_.GetPhaseMs(CEFStartupProfiler::kInitialize);
+	if (is_first_browser_requested_)
+	{
+		cold_start_stats_.init_wait_ms = MillisecondsSince(first_browser_request_time_);
+	}
+
+	if (ret && isMulThreadedMessageLoop())
+	{
+		cocos2d::Director::getInstance()->getScheduler()->schedule(&CEFManager::drainCocosThreadTasks,
+			&instance_, 0.0f, false, "CEFManager::drainCocosThreadTasks");
+	}
+	else if (ret)
 	{
-		thread_ = std::thread(
-			[this]
+		message_pump_.Start();
+	}
+
+	is_initialized_ = ret;
+
+	// Callbacks may add more, those run right away.
+	std::vector<std::function<void()> > callbacks;
+	callbacks.swap(init_callbacks_);
+	for (size_t i = 0; i < callbacks.size(); ++i)
+	{
+		callbacks[i]();
+	}
+
+	browser_pool_->Fill();
+
+	return ret;
+}
+
+void CEFManager::warmUp()
+{
+	if (!is_init_pending_ || is_init_scheduled_)
+	{
+		return;
+	}
+	is_init_scheduled_ = true;
+
+	cocos2d::Director::getInstance()->getScheduler()->performFunctionInCocosThread([]() {
+		if (instance_)
 		{
-			for (;;)
-			{
-				if (this->is_close_cef_ && CEFWebViewWrapper::isEmpty())
-				{
-					return;
-				}
-				else if (CEFWebViewWrapper::getWrapperCount() > 0)
-				{
-					cocos2d::Director::getInstance()->getScheduler()->performFunctionInCocosThread(std::bind(&CEFManager::doMessageLoop, this));
-				}
-
-				std::this_thread::sleep_for(std::chrono::milliseconds(10));
-			}
+			instance_->ensureInitialized();
 		}
-		);
+	});
+}
 
+void CEFManager::whenInitialized(std::function<void()>&& callback)
+{
+	if (is_init_pending_)
+	{
+		init_callbacks_.push_back(std::move(callback));
 	}
+	else
+	{
+		callback();
+	}
+}
 
-	return ret;
+void CEFManager::onBrowserRequested()
+{
+	if (!is_first_browser_requested_)
+	{
+		is_first_browser_requested_ = true;
+		first_browser_request_time_ = std::chrono::steady_clock::now();
+	}
+}
+
+void CEFManager::onBrowserCreated()
+{
+	if (is_first_browser_requested_ && !is_first_browser_created_)
+	{
+		is_first_browser_created_ = true;
+		cold_start_stats_.first_browser_ms = MillisecondsSince(first_browser_request_time_);
+
+		CCLOG("CEF cold start (%s): CefExecuteProcess %.1f ms, CefInitialize %.1f ms, waited %.1f ms, first browser %.1f ms",
+			cold_start_stats_.lazy ? "lazy" : "eager", cold_start_stats_.execute_process_ms, cold_start_stats_.initialize_ms,
+			cold_start_stats_.init_wait_ms, cold_start_stats_.first_browser_ms);
+	}
 }
 
 void CEFManager::closeCEF()
 {
-	is_close_cef_ = true;
+	// Hand the remaining work back to the scheduler while the Director is alive.
+	setMessageLoopAfterDraw(false);
+
+	shutdown_state_.Close();
+
+	// Let the pump thread see the new state now rather than after its backoff.
+	scheduleMessageLoopWork();
+}
+
+void CEFManager::onBrowseWindowCreated()
+{
+	shutdown_state_.OnWindowCreated();
+}
+
+void CEFManager::onBrowseWindowDestroyed()
+{
+	shutdown_state_.OnWindowDestroyed();
+}
+
+void CEFManager::onBrowserLifeSpan(bool alive)
+{
+	shutdown_state_.OnBrowserLifeSpan(alive);
+}
+
+void CEFManager::drainBrowsers()
+{
+	bool drained = shutdown_state_.Drain(shutdown_drain_timeout_ms_, kShutdownDrainSliceMs, [this]() {
+		// With its own UI thread CEF closes them by itself, the cocos side
+		// still has to take the notifications.
+		if (!isMulThreadedMessageLoop())
+		{
+			CefDoMessageLoopWork();
+		}
+		runCocosThreadTasks();
+	});
+
+	if (!drained)
+	{
+		CCLOG("CEF shutdown: %d browsers still open after %d ms", shutdown_state_.GetLiveBrowserCount(), shutdown_drain_timeout_ms_);
+	}
+}
+
+void CEFManager::logShutdownReports() const
+{
+	const std::vector<CEFShutdownCoordinator::Report>& reports = shutdown_coordinator_.GetReports();
+	for (size_t i = 0; i < reports.size(); ++i)
+	{
+		const CEFShutdownCoordinator::Report& report = reports[i];
+		CCLOG("CEF shutdown: browser %d %s after %.1f ms%s", report.browser_id,
+			report.abandoned ? "still open" : "closed", report.close_ms, report.forced ? " (forced)" : "");
+	}
+}
+
+void CEFManager::scheduleMessageLoopWork(int64_t delay_ms)
+{
+	message_pump_.ScheduleWork(delay_ms);
+}
+
+void CEFManager::onBrowserLoadingStateChange(bool isLoading)
+{
+	loading_browser_count_ += isLoading ? 1 : -1;
+	CCASSERT(loading_browser_count_ >= 0, "unbalanced browser loading state");
+
+	updateMessagePumpBusy();
+	if (isLoading)
+	{
+		scheduleMessageLoopWork();
+	}
+}
+
+void CEFManager::onBrowserVisibilityChange(bool visible)
+{
+	visible_browser_count_ += visible ? 1 : -1;
+	CCASSERT(visible_browser_count_ >= 0, "unbalanced browser visibility");
+
+	updateMessagePumpBusy();
+}
+
+void CEFManager::updateMessagePumpBusy()
+{
+	message_pump_.SetBusy(loading_browser_count_ > 0 || visible_browser_count_ > 0);
+}
+
+void CEFManager::setMessageLoopAfterDraw(bool enable)
+{
+	if (enable == is_after_draw_)
+	{
+		return;
+	}
+
+	auto dispatcher = cocos2d::Director::getInstance()->getEventDispatcher();
+	if (enable)
+	{
+		after_draw_listener_ = dispatcher->addCustomEventListener(cocos2d::Director::EVENT_AFTER_DRAW,
+			std::bind(&CEFManager::onAfterDraw, this, std::placeholders::_1));
+		is_after_draw_ = true;
+	}
+	else
+	{
+		is_after_draw_ = false;
+		dispatcher->removeEventListener(after_draw_listener_);
+		after_draw_listener_ = nullptr;
+
+		if (message_loop_budget_.HasPendingWork())
+		{
+			scheduleMessageLoopWork();
+		}
+	}
+}
+
+void CEFManager::setFrameWorkerCount(int count)
+{
+	if (count != frame_worker_count_)
+	{
+		// Buffers of existing browsers fall back to converting in OnPaint.
+		frame_worker_count_ = count;
+		frame_worker_pool_.reset();
+	}
+}
+
+void CEFManager::setSharedClientHandler(bool shared)
+{
+	is_shared_client_handler_ = shared;
+	if (!shared)
+	{
+		// Browsers already using it keep their reference.
+		shared_client_handler_ = NULL;
+	}
+}
+
+CefRefPtr<CEFClientHandler> CEFManager::getSharedClientHandler()
+{
+	if (!shared_client_handler_ && is_shared_client_handler_)
+	{
+		shared_client_handler_ = new CEFClientHandler();
+	}
+
+	return shared_client_handler_;
+}
+
+void CEFManager::setBrowserPoolSize(int count)
+{
+	browser_pool_->SetCapacity(count);
+}
+
+std::shared_ptr<CEFFrameWorkerPool> CEFManager::getFrameWorkerPool()
+{
+	if (!frame_worker_pool_ && frame_worker_count_ > 0)
+	{
+		frame_worker_pool_ = std::make_shared<CEFFrameWorkerPool>(frame_worker_count_);
+	}
+
+	return frame_worker_pool_;
 }
 
 void CEFManager::releaseCEF()
 {
-	CefShutdown();
+	if (is_initialized_)
+	{
+		// CefShutdown expects every browser to be closed.
+		drainBrowsers();
+		is_initialized_ = false;
+		CefShutdown();
+	}
+
+	shutdown_state_.Advance(CEFShutdownState::kShutDown);
+}
+
+void CEFManager::postToCocosThread(std::function<void()>&& task)
+{
+	while (!cocos_thread_tasks_.TryPush(std::move(task)))
+	{
+		if (std::this_thread::get_id() == cocos_thread_id_)
+		{
+			// Nobody else would make room, run the queued tasks now. They keep
+			// their order and this one goes after them.
+			runCocosThreadTasks();
+		}
+		else
+		{
+			// The cocos thread is behind, wait for it instead of losing the event.
+			std::this_thread::yield();
+		}
+	}
+}
+
+void CEFManager::drainCocosThreadTasks(float dt)
+{
+	// Scheduled against |instance_| rather than the object so a callback that
+	// outlives the manager does nothing.
+	if (instance_)
+	{
+		instance_->runCocosThreadTasks();
+	}
+}
+
+void CEFManager::runCocosThreadTasks()
+{
+	// Bounded so that producers posting while we drain can't hold up the frame.
+	std::function<void()> task;
+	for (size_t i = 0; i < cocos_thread_tasks_.Capacity() && cocos_thread_tasks_.TryPop(task); ++i)
+	{
+		task();
+	}
 }
 
-bool CEFManager::isMulThreadedMessageLoop()
+bool CEFManager::dispatchMessageLoop()
 {
-	return USE_CEF_MULTI_THREADED_MESSAGE_LOOP;
+	// Runs on the pump thread, only reads atomics.
+	if (shutdown_state_.GetState() >= CEFShutdownState::kDrained)
+	{
+		return false;
+	}
+	else if (shutdown_state_.GetWindowCount() > 0)
+	{
+		message_loop_budget_.Request();
+
+		// After draw the work is picked up by onAfterDraw.
+		if (!is_after_draw_ && message_loop_budget_.TryPost())
+		{
+			cocos2d::Director::getInstance()->getScheduler()->performFunctionInCocosThread(std::bind(&CEFManager::doMessageLoop, this));
+		}
+	}
+
+	return true;
 }
 
 void CEFManager::doMessageLoop()
 {
-	CefDoMessageLoopWork();
-}
\ No newline at end of file
+	message_loop_budget_.OnPostRun();
+
+	if (!runMessageLoopWork())
+	{
+		// Out of budget, the pump posts the rest for the next frame.
+		scheduleMessageLoopWork();
+	}
+}
+
+void CEFManager::onAfterDraw(cocos2d::EventCustom* event)
+{
+	// Out of budget, the rest stays pending for the next frame.
+	runMessageLoopWork();
+}
+
+bool CEFManager::runMessageLoopWork()
+{
+	// A pump queued before CefShutdown.
+	if (shutdown_state_.GetState() == CEFShutdownState::kShutDown)
+	{
+		message_loop_budget_.CancelPending();
+		return true;
+	}
+
+	return message_loop_budget_.Run(cocos2d::Director::getInstance()->getTotalFrames(), CefDoMessageLoopWork);
+}
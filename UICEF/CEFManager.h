@@ -1,27 +1,222 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
 #include "cocos2d.h"
 #include "./include/cef_app.h"
+#include "CEFMessageLoopBudget.h"
+#include "CEFMessagePump.h"
+#include "CEFMPSCQueue.h"
+#include "CEFFrameWorkerPool.h"
+#include "CEFShutdownCoordinator.h"
+#include "CEFShutdownState.h"
+#include "CEFStartupProfiler.h"
+
+class CEFBrowserPool;
+class CEFClientHandler;
 
 class CEFManager
 {
 public:
+	// Cost of CefDoMessageLoopWork on the cocos thread during one frame.
+	typedef CEFMessageLoopBudget::FrameStats MessageLoopFrameStats;
+
+	// Where launch time went, in milliseconds.
+	struct ColdStartStats
+	{
+		bool lazy;
+		double execute_process_ms;
+		double initialize_ms;
+		// From the first web view request to CEF being initialized, 0 unless
+		// the request had to wait.
+		double init_wait_ms;
+		// From the first web view request to its browser being created.
+		double first_browser_ms;
+	};
+
+	// Steps of the shutdown, the state only moves forward.
+	typedef CEFShutdownState::State ShutdownState;
+
 	static CEFManager * getInstance();
 	static void releaseInstance();
+	static bool hasInstance() { return instance_ != nullptr; }
 	
-	bool initCEF(HINSTANCE instance, bool bMultiProcess);
+	// With |bMultiThreadedMessageLoop| CEF runs its own UI thread and browser
+	// events are delivered to the cocos thread once per frame.
+	bool initCEF(HINSTANCE instance, bool bMultiProcess, bool bMultiThreadedMessageLoop = false);
 	void closeCEF();
 	void releaseCEF();
 
+	ShutdownState getShutdownState() const { return shutdown_state_.GetState(); }
+
+	// How long releaseCEF waits for the browsers still alive to close before
+	// calling CefShutdown. Defaults to 1000.
+	void setShutdownDrainTimeout(int ms) { shutdown_drain_timeout_ms_ = ms; }
+
+	// Called by the windows on the cocos thread. The pump runs while any exists.
+	void onBrowseWindowCreated();
+	void onBrowseWindowDestroyed();
+
+	// Called by the client handlers when CEF creates and closes a browser,
+	// from the CEF UI thread.
+	void onBrowserLifeSpan(bool alive);
+
+	// Let initCEF only handle the sub-processes and leave CefInitialize to the
+	// first web view or to warmUp(). Must be set before initCEF.
+	void setLazyInit(bool lazy) { is_lazy_init_ = lazy; }
+	bool isLazyInit() const { return is_lazy_init_; }
+	bool isInitialized() const { return is_initialized_; }
+
+	// Run the CefInitialize deferred by initCEF now. CEF must be initialized on
+	// the main thread, so this blocks it.
+	bool ensureInitialized();
+
+	// Initialize at the start of the next frame, e.g. while a loading screen is
+	// shown.
+	void warmUp();
+
+	// Run |callback| on the main thread once the deferred init is done, right
+	// away if there is none. Callbacks run in the order they were added and
+	// should check isInitialized(), the init may have failed.
+	void whenInitialized(std::function<void()>&& callback);
+
+	// Called by the web views to time the first browser.
+	void onBrowserRequested();
+	void onBrowserCreated();
+	const ColdStartStats& getColdStartStats() const { return cold_start_stats_; }
+
+	// Startup phases and per browser creation milestones.
+	CEFStartupProfiler* getStartupProfiler() { return &startup_profiler_; }
+
+	// Tracks the closes started by CEFWebViewWrapper::closeAll().
+	CEFShutdownCoordinator* getShutdownCoordinator() { return &shutdown_coordinator_; }
+
+	// Render new web views off-screen into cocos textures. Must be set before
+	// initCEF since CEF only supports it when enabled at startup.
+	void setWindowlessRendering(bool enable) { is_windowless_rendering_ = enable; }
+	bool isWindowlessRendering() const { return is_windowless_rendering_; }
+
+	// Threads converting off-screen frames, 0 converts them in OnPaint on the
+	// CEF UI thread. Takes effect for browsers created afterwards.
+	void setFrameWorkerCount(int count);
+	int getFrameWorkerCount() const { return frame_worker_count_; }
+
+	// The shared frame conversion pool, empty when disabled.
+	std::shared_ptr<CEFFrameWorkerPool> getFrameWorkerPool();
+
+	// Let one client handler serve every browser instead of one handler per
+	// browser. Takes effect for browsers created afterwards.
+	void setSharedClientHandler(bool shared);
+	bool isSharedClientHandler() const { return is_shared_client_handler_; }
+
+	// The handler new browsers should use, NULL when each creates its own.
+	CefRefPtr<CEFClientHandler> getSharedClientHandler();
+
+	// Browsers kept ready for new web views. Call after the GL view is created.
+	void setBrowserPoolSize(int count);
+	CEFBrowserPool* getBrowserPool() const { return browser_pool_.get(); }
+
+	// Ask the pump to run CefDoMessageLoopWork after |delay_ms|, 0 means as soon as possible.
+	void scheduleMessageLoopWork(int64_t delay_ms = 0);
+
+	// Called by the web views when their loading state changes. The pump stays
+	// at its shortest interval while any browser is loading.
+	void onBrowserLoadingStateChange(bool isLoading);
+
+	// Called by the windows when they are shown or hidden. The pump stays at
+	// its shortest interval while any browser is on screen, timers, animations
+	// and paints of a visible page can't wait for the idle backoff.
+	void onBrowserVisibilityChange(bool visible);
+
+	bool isMulThreadedMessageLoop() const { return is_multi_threaded_loop_; }
+
+	// Run |task| on the cocos thread during the next frame. May be called from
+	// any thread; tasks keep the order in which each thread posted them. At
+	// most 1024 tasks wait at a time: once full, other threads wait for the
+	// cocos thread to make room, and the cocos thread runs the queued tasks
+	// right away.
+	void postToCocosThread(std::function<void()>&& task);
+
+	// Max milliseconds of CefDoMessageLoopWork per cocos frame. The first call
+	// of a frame always runs, the pumps requested while it runs only as long
+	// as the budget allows. The rest is deferred to the next frame.
+	void setMessageLoopFrameBudget(float budget_ms) { message_loop_budget_.SetBudget(budget_ms); }
+	float getMessageLoopFrameBudget() const { return message_loop_budget_.GetBudget(); }
+
+	// Number of pump requests merged into an already queued one.
+	uint64_t getCoalescedPumpCount() const { return message_loop_budget_.GetCoalescedCount(); }
+
+	// Number of pumps pushed to the next frame because the budget was spent.
+	uint64_t getDeferredPumpCount() const { return message_loop_budget_.GetDeferredCount(); }
+
+	// Run pending pump work right after Director::drawScene instead of through
+	// performFunctionInCocosThread. Work that does not fit in the frame budget
+	// is carried over to the next frame. Must be called on the cocos thread.
+	void setMessageLoopAfterDraw(bool enable);
+	bool isMessageLoopAfterDraw() const { return is_after_draw_; }
+
+	// Stats of the last frame that ran the pump, and of the most expensive
+	// frame since resetMessageLoopFrameStats().
+	const MessageLoopFrameStats& getLastFrameStats() const { return message_loop_budget_.GetLastFrameStats(); }
+	const MessageLoopFrameStats& getWorstFrameStats() const { return message_loop_budget_.GetWorstFrameStats(); }
+	void resetMessageLoopFrameStats() { message_loop_budget_.ResetStats(); }
+
 private:
 	CEFManager();
 	~CEFManager();
+	bool dispatchMessageLoop();
 	void doMessageLoop();
-	bool isMulThreadedMessageLoop();
+	bool runMessageLoopWork();
+	void onAfterDraw(cocos2d::EventCustom* event);
+	static void drainCocosThreadTasks(float dt);
+	void runCocosThreadTasks();
+
+	// Keep the pump at its shortest interval while a browser loads or shows.
+	void updateMessagePumpBusy();
+
+	// Pump until CEF closed every browser or the drain timeout passed.
+	void drainBrowsers();
+
+	// Log how long each close tracked by |shutdown_coordinator_| took.
+	void logShutdownReports() const;
 
 private:
 	CefRefPtr<CefApp>	cef_app_;
-	bool				is_close_cef_;
-	std::thread			thread_;
+	// Read by the pump thread and the CEF UI thread.
+	CEFShutdownState	shutdown_state_;
+	int					shutdown_drain_timeout_ms_;
+	bool				is_lazy_init_;
+	bool				is_init_pending_;
+	bool				is_init_scheduled_;
+	bool				is_initialized_;
+	bool				is_multi_process_;
+	HINSTANCE			instance_handle_;
+	std::vector<std::function<void()> > init_callbacks_;
+	ColdStartStats		cold_start_stats_;
+	CEFStartupProfiler	startup_profiler_;
+	CEFShutdownCoordinator shutdown_coordinator_;
+	bool				is_first_browser_requested_;
+	bool				is_first_browser_created_;
+	std::chrono::steady_clock::time_point first_browser_request_time_;
+	bool				is_multi_threaded_loop_;
+	bool				is_windowless_rendering_;
+	int					frame_worker_count_;
+	std::shared_ptr<CEFFrameWorkerPool> frame_worker_pool_;
+	std::unique_ptr<CEFBrowserPool> browser_pool_;
+	bool				is_shared_client_handler_;
+	CefRefPtr<CEFClientHandler> shared_client_handler_;
+	int					loading_browser_count_;
+	int					visible_browser_count_;
+	CEFMessageLoopBudget message_loop_budget_;
+	cocos2d::EventListenerCustom* after_draw_listener_;
+	std::atomic<bool>	is_after_draw_;
+	CEFMessagePump		message_pump_;
+	CEFMPSCQueue<std::function<void()> > cocos_thread_tasks_;
+	// The consumer of |cocos_thread_tasks_|, the thread that called initCEF.
+	std::thread::id		cocos_thread_id_;
 	static CEFManager*	instance_;
 };
@@ -0,0 +1,99 @@
+#include "CEFMessageLoopBudget.h"
+
+#include <algorithm>
+#include <chrono>
+
+static const CEFMessageLoopBudget::FrameStats kEmptyFrameStats = { 0, 0, 0, 0.0f, 0.0f };
+
+static double SteadyClockMilliseconds()
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+CEFMessageLoopBudget::CEFMessageLoopBudget(float budget_ms, const Clock& clock)
+	: clock_(clock ? clock : Clock(SteadyClockMilliseconds))
+	, budget_ms_(budget_ms)
+	, call_cost_ms_(0.0f)
+	, deferred_count_(0)
+	, is_pending_(false)
+	, is_posted_(false)
+	, coalesced_count_(0)
+{
+	ResetStats();
+}
+
+void CEFMessageLoopBudget::Request()
+{
+	is_pending_ = true;
+}
+
+bool CEFMessageLoopBudget::TryPost()
+{
+	// Keep at most one run queued on the cocos thread. A stalled game thread
+	// would otherwise run a burst of them back to back once it resumes.
+	if (is_posted_.exchange(true))
+	{
+		++coalesced_count_;
+		return false;
+	}
+	return true;
+}
+
+void CEFMessageLoopBudget::OnPostRun()
+{
+	is_posted_ = false;
+}
+
+bool CEFMessageLoopBudget::Run(unsigned int frame, const std::function<void()>& work)
+{
+	BeginFrame(frame);
+
+	while (is_pending_.exchange(false))
+	{
+		if (frame_stats_.calls > 0 && frame_stats_.total_ms + call_cost_ms_ > budget_ms_)
+		{
+			is_pending_ = true;
+			++frame_stats_.deferred;
+			++deferred_count_;
+			return false;
+		}
+
+		double start = clock_();
+		work();
+		float cost_ms = static_cast<float>(clock_() - start);
+
+		++frame_stats_.calls;
+		frame_stats_.total_ms += cost_ms;
+		frame_stats_.worst_call_ms = std::max(frame_stats_.worst_call_ms, cost_ms);
+		call_cost_ms_ += (cost_ms - call_cost_ms_) * 0.125f;
+	}
+
+	return true;
+}
+
+void CEFMessageLoopBudget::BeginFrame(unsigned int frame)
+{
+	if (frame == frame_stats_.frame)
+	{
+		return;
+	}
+
+	if (frame_stats_.calls > 0 || frame_stats_.deferred > 0)
+	{
+		last_frame_stats_ = frame_stats_;
+		if (frame_stats_.total_ms > worst_frame_stats_.total_ms)
+		{
+			worst_frame_stats_ = frame_stats_;
+		}
+	}
+
+	frame_stats_ = kEmptyFrameStats;
+	frame_stats_.frame = frame;
+}
+
+void CEFMessageLoopBudget::ResetStats()
+{
+	frame_stats_ = kEmptyFrameStats;
+	last_frame_stats_ = kEmptyFrameStats;
+	worst_frame_stats_ = kEmptyFrameStats;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+
+// Spreads the pump work requested by the pump thread over the cocos frames.
+// Requests made while a run is queued on the cocos thread are merged into it,
+// and a run keeps doing the work requested during it until the frame budget is
+// spent. The rest is carried over to the next frame. The first call of a frame
+// always runs, so work that costs more than the whole budget still progresses.
+//
+// Request() and TryPost() may be called from any thread, the rest only from
+// the cocos thread. This class does not depend on CEF or cocos2d, and the
+// clock is injectable, so the budget can be tested with a stub work function.
+class CEFMessageLoopBudget
+{
+public:
+	// Returns a monotonic time in milliseconds.
+	typedef std::function<double()> Clock;
+
+	// Cost of the work during one frame.
+	struct FrameStats
+	{
+		unsigned int frame;
+		int calls;
+		int deferred;
+		float total_ms;
+		float worst_call_ms;
+	};
+
+	explicit CEFMessageLoopBudget(float budget_ms, const Clock& clock = Clock());
+
+	void SetBudget(float budget_ms) { budget_ms_ = budget_ms; }
+	float GetBudget() const { return budget_ms_; }
+
+	// Work was asked for.
+	void Request();
+
+	// Returns true if the caller should post a run to the cocos thread, false
+	// if one is queued already and will do the work.
+	bool TryPost();
+
+	// Called by the posted run before it calls Run().
+	void OnPostRun();
+
+	bool HasPendingWork() const { return is_pending_; }
+
+	// Drop the requested work, returns whether there was any.
+	bool CancelPending() { return is_pending_.exchange(false); }
+
+	// Call |work| while work is requested and the budget of |frame| allows.
+	// Returns false if work was left for the next frame.
+	bool Run(unsigned int frame, const std::function<void()>& work);
+
+	// Number of requests merged into an already queued run.
+	uint64_t GetCoalescedCount() const { return coalesced_count_; }
+
+	// Number of times work was left for the next frame.
+	uint64_t GetDeferredCount() const { return deferred_count_; }
+
+	// Stats of the last frame that ran the work, and of the most expensive
+	// frame since ResetStats().
+	const FrameStats& GetLastFrameStats() const { return last_frame_stats_; }
+	const FrameStats& GetWorstFrameStats() const { return worst_frame_stats_; }
+	void ResetStats();
+
+private:
+	// Close the stats of the previous frame when |frame| starts.
+	void BeginFrame(unsigned int frame);
+
+	Clock clock_;
+	float budget_ms_;
+	// Moving average used to predict whether the next call still fits.
+	float call_cost_ms_;
+	uint64_t deferred_count_;
+	FrameStats frame_stats_;
+	FrameStats last_frame_stats_;
+	FrameStats worst_frame_stats_;
+	std::atomic<bool> is_pending_;
+	std::atomic<bool> is_posted_;
+	std::atomic<uint64_t> coalesced_count_;
+
+	CEFMessageLoopBudget(const CEFMessageLoopBudget&);
+	CEFMessageLoopBudget& operator=(const CEFMessageLoopBudget&);
+};
@@ -0,0 +1,138 @@
+#include "CEFMessagePump.h"
+
+#include <algorithm>
+
+CEFMessagePump::CEFMessagePump(const DispatchFunc& dispatch, int min_delay_ms, int max_delay_ms)
+	: dispatch_(dispatch)
+	, min_delay_(std::chrono::milliseconds(min_delay_ms))
+	, max_delay_(std::chrono::milliseconds(std::max(min_delay_ms, max_delay_ms)))
+	, idle_delay_(std::chrono::milliseconds(min_delay_ms))
+	, is_running_(false)
+	, is_stopping_(false)
+	, is_busy_(false)
+	, work_requested_(false)
+	, wakeup_count_(0)
+	, dispatch_count_(0)
+{
+}
+
+CEFMessagePump::~CEFMessagePump()
+{
+	Stop();
+}
+
+void CEFMessagePump::Start()
+{
+	std::lock_guard<std::mutex> lock(lock_);
+	if (is_running_ || thread_.joinable())
+	{
+		return;
+	}
+
+	is_running_ = true;
+	is_stopping_ = false;
+	idle_delay_ = min_delay_;
+	next_due_ = Clock::now();
+	thread_ = std::thread(&CEFMessagePump::Run, this);
+}
+
+void CEFMessagePump::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(lock_);
+		is_stopping_ = true;
+	}
+	cond_.notify_one();
+
+	if (thread_.joinable())
+	{
+		thread_.join();
+	}
+}
+
+void CEFMessagePump::ScheduleWork(int64_t delay_ms)
+{
+	std::lock_guard<std::mutex> lock(lock_);
+	work_requested_ = true;
+
+	auto due = Clock::now() + std::chrono::milliseconds(std::max<int64_t>(delay_ms, 0));
+	if (due < next_due_)
+	{
+		next_due_ = due;
+		cond_.notify_one();
+	}
+}
+
+void CEFMessagePump::SetBusy(bool busy)
+{
+	std::lock_guard<std::mutex> lock(lock_);
+	is_busy_ = busy;
+	if (busy && idle_delay_ > min_delay_)
+	{
+		// Don't wait for the backed off interval to expire.
+		idle_delay_ = min_delay_;
+		auto due = Clock::now() + min_delay_;
+		if (due < next_due_)
+		{
+			next_due_ = due;
+			cond_.notify_one();
+		}
+	}
+}
+
+bool CEFMessagePump::IsRunning() const
+{
+	std::lock_guard<std::mutex> lock(lock_);
+	return is_running_;
+}
+
+uint64_t CEFMessagePump::GetWakeupCount() const
+{
+	std::lock_guard<std::mutex> lock(lock_);
+	return wakeup_count_;
+}
+
+uint64_t CEFMessagePump::GetDispatchCount() const
+{
+	std::lock_guard<std::mutex> lock(lock_);
+	return dispatch_count_;
+}
+
+void CEFMessagePump::Run()
+{
+	std::unique_lock<std::mutex> lock(lock_);
+	while (!is_stopping_)
+	{
+		auto now = Clock::now();
+		if (now < next_due_)
+		{
+			// |next_due_| may move forward while waiting, so re-check after every wakeup.
+			cond_.wait_until(lock, next_due_);
+			++wakeup_count_;
+			continue;
+		}
+
+		if (work_requested_ || is_busy_)
+		{
+			idle_delay_ = min_delay_;
+		}
+		else
+		{
+			idle_delay_ = std::min(idle_delay_ * 2, max_delay_);
+		}
+		work_requested_ = false;
+		next_due_ = now + idle_delay_;
+		++dispatch_count_;
+
+		lock.unlock();
+		bool keep_running = dispatch_();
+		lock.lock();
+
+		if (!keep_running)
+		{
+			break;
+		}
+	}
+
+	is_running_ = false;
+}
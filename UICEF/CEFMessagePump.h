@@ -0,0 +1,68 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Decides when CefDoMessageLoopWork should run. A background thread sleeps
+// until work is due and then calls the dispatch function, which is expected to
+// hand the real pump over to the thread that owns CEF. Work requested through
+// ScheduleWork() is dispatched immediately; while nothing asks for work the
+// interval backs off exponentially from |min_delay_ms| to |max_delay_ms|.
+//
+// This class does not depend on CEF or cocos2d so it can be driven by a stub
+// work source.
+class CEFMessagePump
+{
+public:
+	// Return false to stop the pump thread.
+	typedef std::function<bool()> DispatchFunc;
+
+	CEFMessagePump(const DispatchFunc& dispatch, int min_delay_ms, int max_delay_ms);
+	~CEFMessagePump();
+
+	// Start the pump thread.
+	void Start();
+
+	// Stop and join the pump thread. Must not be called from the dispatch function.
+	void Stop();
+
+	// Request a pump in |delay_ms| milliseconds, 0 means as soon as possible.
+	// May be called from any thread.
+	void ScheduleWork(int64_t delay_ms);
+
+	// While busy the pump keeps the minimum interval instead of backing off.
+	void SetBusy(bool busy);
+
+	bool IsRunning() const;
+
+	// Number of times the pump thread woke up.
+	uint64_t GetWakeupCount() const;
+
+	// Number of times the dispatch function was called.
+	uint64_t GetDispatchCount() const;
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	void Run();
+
+	DispatchFunc dispatch_;
+	const Clock::duration min_delay_;
+	const Clock::duration max_delay_;
+
+	mutable std::mutex lock_;
+	std::condition_variable cond_;
+	std::thread thread_;
+	Clock::time_point next_due_;
+	Clock::duration idle_delay_;
+	bool is_running_;
+	bool is_stopping_;
+	bool is_busy_;
+	bool work_requested_;
+	uint64_t wakeup_count_;
+	uint64_t dispatch_count_;
+};
@@ -0,0 +1,64 @@
+#include "CEFNavigationDecision.h"
+#include <chrono>
+
+CEFNavigationDecision::CEFNavigationDecision()
+	: is_decided_(false)
+	, is_allowed_(false)
+	, is_abandoned_(false)
+{
+}
+
+bool CEFNavigationDecision::Wait(int timeout_ms, bool& allowed)
+{
+	std::unique_lock<std::mutex> lock(lock_);
+	if (!cond_.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this]() { return is_decided_; }))
+	{
+		return false;
+	}
+
+	allowed = is_allowed_;
+	return true;
+}
+
+bool CEFNavigationDecision::GiveUp(const LateCallback& late, bool& allowed)
+{
+	std::lock_guard<std::mutex> lock(lock_);
+	if (is_decided_)
+	{
+		allowed = is_allowed_;
+		return false;
+	}
+
+	is_abandoned_ = true;
+	late_ = late;
+	return true;
+}
+
+void CEFNavigationDecision::Decide(bool allowed)
+{
+	LateCallback late;
+	{
+		std::lock_guard<std::mutex> lock(lock_);
+		if (is_decided_)
+		{
+			return;
+		}
+
+		is_decided_ = true;
+		is_allowed_ = allowed;
+		if (is_abandoned_)
+		{
+			late.swap(late_);
+		}
+	}
+
+	// Outside the lock, the callback may post to other threads.
+	if (late)
+	{
+		late(allowed);
+	}
+	else
+	{
+		cond_.notify_one();
+	}
+}
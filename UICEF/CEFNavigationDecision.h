@@ -0,0 +1,43 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+
+// Carries the answer to "may this navigation go ahead" from the thread that
+// decides to the thread that waits for it, for a bounded time. A waiter that
+// gives up leaves a callback behind, which gets the answer once it comes, so a
+// late approval can still issue the navigation again.
+//
+// Exactly one of the waiter or the late callback sees the answer. This class
+// does not depend on CEF so it can be driven by stub threads.
+class CEFNavigationDecision
+{
+public:
+	typedef std::function<void(bool allowed)> LateCallback;
+
+	CEFNavigationDecision();
+
+	// Wait up to |timeout_ms| for Decide(). Returns false if it didn't come,
+	// the waiter must then call GiveUp().
+	bool Wait(int timeout_ms, bool& allowed);
+
+	// Stop waiting, |late| is called by Decide() on the deciding thread.
+	// Returns false if the answer came in the meantime, it is then in
+	// |allowed| and |late| is never called.
+	bool GiveUp(const LateCallback& late, bool& allowed);
+
+	// Give the answer, to the waiter or to its late callback.
+	void Decide(bool allowed);
+
+private:
+	std::mutex lock_;
+	std::condition_variable cond_;
+	bool is_decided_;
+	bool is_allowed_;
+	bool is_abandoned_;
+	LateCallback late_;
+
+	CEFNavigationDecision(const CEFNavigationDecision&);
+	CEFNavigationDecision& operator=(const CEFNavigationDecision&);
+};
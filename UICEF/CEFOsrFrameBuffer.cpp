@@ -0,0 +1,469 @@
+#include "CEFOsrFrameBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+#include "CEFFrameWorkerPool.h"
+#include "CEFPixelConvert.h"
+
+// Keeps the per-frame copy and upload call count low.
+static const size_t kMaxDirtyRects = 8;
+
+// Paints waiting for the pool before they are folded into one full frame.
+static const size_t kMaxQueuedJobs = 2;
+
+static int64_t RectArea(const CEFOsrFrameBuffer::Rect& rect)
+{
+	return static_cast<int64_t>(rect.width) * rect.height;
+}
+
+static CEFOsrFrameBuffer::Rect RectUnion(const CEFOsrFrameBuffer::Rect& a, const CEFOsrFrameBuffer::Rect& b)
+{
+	int right = std::max(a.x + a.width, b.x + b.width);
+	int bottom = std::max(a.y + a.height, b.y + b.height);
+	CEFOsrFrameBuffer::Rect result = { std::min(a.x, b.x), std::min(a.y, b.y), 0, 0 };
+	result.width = right - result.x;
+	result.height = bottom - result.y;
+	return result;
+}
+
+// True if the rects overlap or share an edge.
+static bool RectsTouch(const CEFOsrFrameBuffer::Rect& a, const CEFOsrFrameBuffer::Rect& b)
+{
+	return a.x <= b.x + b.width && b.x <= a.x + a.width &&
+		a.y <= b.y + b.height && b.y <= a.y + a.height;
+}
+
+// Clip |rects| to the frame and drop empty ones.
+static void ClipRects(const CEFOsrFrameBuffer::Rect* rects, size_t count, int width, int height,
+	std::vector<CEFOsrFrameBuffer::Rect>& out)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		int left = std::max(rects[i].x, 0);
+		int top = std::max(rects[i].y, 0);
+		int right = std::min(rects[i].x + rects[i].width, width);
+		int bottom = std::min(rects[i].y + rects[i].height, height);
+		if (right > left && bottom > top)
+		{
+			CEFOsrFrameBuffer::Rect rect = { left, top, right - left, bottom - top };
+			out.push_back(rect);
+		}
+	}
+}
+
+static void CopyRows(const uint8_t* src, uint8_t* dst, int width, const CEFOsrFrameBuffer::Rect& rect)
+{
+	for (int y = rect.y; y < rect.y + rect.height; ++y)
+	{
+		size_t offset = (static_cast<size_t>(y) * width + rect.x) * 4;
+		memcpy(dst + offset, src + offset, static_cast<size_t>(rect.width) * 4);
+	}
+}
+
+CEFOsrFrameBuffer::CEFOsrFrameBuffer(const std::shared_ptr<CEFFrameWorkerPool>& pool)
+	: pool_(pool)
+	, latest_(-1)
+	, reading_(-1)
+	, latest_seq_(0)
+	, acquired_seq_(0)
+	, is_scheduled_(false)
+	, paint_width_(0)
+	, paint_height_(0)
+	, acquired_width_(0)
+	, acquired_height_(0)
+	, pending_full_(false)
+	, full_update_threshold_(0.5f)
+	, view_width_(0)
+	, view_height_(0)
+{
+	for (int i = 0; i < kSlotCount; ++i)
+	{
+		slots_[i].width = slots_[i].height = 0;
+		slots_[i].valid = false;
+	}
+
+	memset(&stats_, 0, sizeof(stats_));
+}
+
+void CEFOsrFrameBuffer::SetViewSize(int width, int height)
+{
+	std::lock_guard<std::mutex> lock(lock_);
+	view_width_ = width;
+	view_height_ = height;
+}
+
+void CEFOsrFrameBuffer::GetViewSize(int& width, int& height) const
+{
+	std::lock_guard<std::mutex> lock(lock_);
+	width = view_width_;
+	height = view_height_;
+}
+
+void CEFOsrFrameBuffer::SetFullUpdateThreshold(float fraction)
+{
+	std::lock_guard<std::mutex> lock(lock_);
+	full_update_threshold_ = fraction;
+}
+
+void CEFOsrFrameBuffer::OnPaint(const void* bgra, int width, int height, const Rect* dirty, size_t dirty_count)
+{
+	if (!bgra || width <= 0 || height <= 0)
+	{
+		return;
+	}
+
+	std::shared_ptr<CEFFrameWorkerPool> pool = pool_.lock();
+
+	std::vector<Rect> rects;
+	ClipRects(dirty, dirty_count, width, height, rects);
+	MergeRects(rects, kMaxDirtyRects);
+
+	bool full;
+	{
+		std::lock_guard<std::mutex> lock(lock_);
+		++stats_.paints;
+
+		// A paint storm: rather than queue more, the next job replaces the
+		// queued ones and must then carry the whole frame.
+		full = width != paint_width_ || height != paint_height_ ||
+			IsFullUpdate(rects, width, height) ||
+			(pool && jobs_.size() >= kMaxQueuedJobs);
+		paint_width_ = width;
+		paint_height_ = height;
+	}
+
+	Job job;
+	MakeJob(job, static_cast<const uint8_t*>(bgra), width, height, rects, full, pool != nullptr);
+
+	if (!pool)
+	{
+		ProcessJob(job);
+		return;
+	}
+
+	bool post;
+	{
+		std::lock_guard<std::mutex> lock(lock_);
+		if (job.full && !jobs_.empty())
+		{
+			stats_.dropped_paints += jobs_.size();
+			jobs_.clear();
+		}
+
+		jobs_.push_back(std::move(job));
+		post = !is_scheduled_;
+		is_scheduled_ = true;
+	}
+
+	if (post)
+	{
+		std::shared_ptr<CEFOsrFrameBuffer> self = shared_from_this();
+		pool->PostTask([self]() {
+			self->RunJobs();
+		});
+	}
+}
+
+bool CEFOsrFrameBuffer::AcquireFrame(Frame& frame)
+{
+	std::lock_guard<std::mutex> lock(lock_);
+	if (latest_ < 0 || latest_seq_ == acquired_seq_)
+	{
+		return false;
+	}
+
+	reading_ = latest_;
+	acquired_seq_ = latest_seq_;
+	++stats_.acquires;
+
+	const Slot& slot = slots_[reading_];
+	frame.pixels = slot.pixels.data();
+	frame.width = slot.width;
+	frame.height = slot.height;
+	frame.full_update = pending_full_ ||
+		slot.width != acquired_width_ || slot.height != acquired_height_ ||
+		IsFullUpdate(pending_dirty_, slot.width, slot.height);
+
+	if (frame.full_update)
+	{
+		Rect full = { 0, 0, slot.width, slot.height };
+		acquired_dirty_.assign(1, full);
+	}
+	else
+	{
+		acquired_dirty_.swap(pending_dirty_);
+	}
+	pending_dirty_.clear();
+	pending_full_ = false;
+	acquired_width_ = slot.width;
+	acquired_height_ = slot.height;
+
+	frame.dirty_rects = acquired_dirty_.data();
+	frame.dirty_count = acquired_dirty_.size();
+
+	uint64_t upload = 0;
+	for (size_t i = 0; i < acquired_dirty_.size(); ++i)
+	{
+		upload += RectArea(acquired_dirty_[i]) * 4;
+	}
+	stats_.upload_bytes += upload;
+	stats_.last_upload_bytes = upload;
+
+	uint64_t latency = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - latest_painted_).count();
+	stats_.last_latency_us = latency;
+	stats_.max_latency_us = std::max(stats_.max_latency_us, latency);
+	stats_.total_latency_us += latency;
+
+	return true;
+}
+
+void CEFOsrFrameBuffer::Flush()
+{
+	std::unique_lock<std::mutex> lock(lock_);
+	flushed_.wait(lock, [this] { return jobs_.empty() && !is_scheduled_; });
+}
+
+void CEFOsrFrameBuffer::MakeJob(Job& job, const uint8_t* bgra, int width, int height, std::vector<Rect>& rects, bool full, bool pack)
+{
+	job.width = width;
+	job.height = height;
+	job.full = full;
+	job.painted = Clock::now();
+
+	if (full)
+	{
+		Rect rect = { 0, 0, width, height };
+		job.rects.assign(1, rect);
+	}
+	else
+	{
+		job.rects.swap(rects);
+	}
+
+	if (!pack)
+	{
+		job.direct = bgra;
+		return;
+	}
+
+	// CEF's buffer is only valid during OnPaint, keep the dirty rows.
+	job.direct = NULL;
+	size_t bytes = 0;
+	for (size_t i = 0; i < job.rects.size(); ++i)
+	{
+		bytes += static_cast<size_t>(RectArea(job.rects[i])) * 4;
+	}
+	job.data.resize(bytes);
+
+	uint8_t* dst = job.data.data();
+	for (size_t i = 0; i < job.rects.size(); ++i)
+	{
+		const Rect& rect = job.rects[i];
+		size_t row_bytes = static_cast<size_t>(rect.width) * 4;
+		for (int y = rect.y; y < rect.y + rect.height; ++y, dst += row_bytes)
+		{
+			memcpy(dst, bgra + (static_cast<size_t>(y) * width + rect.x) * 4, row_bytes);
+		}
+	}
+}
+
+void CEFOsrFrameBuffer::RunJobs()
+{
+	std::unique_lock<std::mutex> lock(lock_);
+	while (!jobs_.empty())
+	{
+		Job job = std::move(jobs_.front());
+		jobs_.pop_front();
+
+		lock.unlock();
+		ProcessJob(job);
+		lock.lock();
+	}
+
+	is_scheduled_ = false;
+	flushed_.notify_all();
+}
+
+void CEFOsrFrameBuffer::ProcessJob(const Job& job)
+{
+	// Write into the slot that is neither being read nor about to be.
+	int target = 0;
+	int source;
+	std::vector<Rect> catch_up;
+	{
+		std::lock_guard<std::mutex> lock(lock_);
+		while (target == reading_ || target == latest_)
+		{
+			++target;
+		}
+
+		Slot& slot = slots_[target];
+		if (slot.width != job.width || slot.height != job.height)
+		{
+			slot.pixels.resize(static_cast<size_t>(job.width) * job.height * 4);
+			slot.width = job.width;
+			slot.height = job.height;
+			slot.valid = false;
+		}
+
+		source = latest_;
+		if (!job.full)
+		{
+			if (slot.valid)
+			{
+				catch_up = slot.stale;
+			}
+			else
+			{
+				Rect rect = { 0, 0, job.width, job.height };
+				catch_up.assign(1, rect);
+			}
+		}
+	}
+
+	Slot& slot = slots_[target];
+	uint64_t copied = 0;
+
+	// Only the newest slot is read here, which no other writer touches. A
+	// partial job always follows a job of the same size.
+	if (!catch_up.empty() && source >= 0 &&
+		slots_[source].width == job.width && slots_[source].height == job.height)
+	{
+		for (size_t i = 0; i < catch_up.size(); ++i)
+		{
+			CopyRows(slots_[source].pixels.data(), slot.pixels.data(), job.width, catch_up[i]);
+			copied += RectArea(catch_up[i]) * 4;
+		}
+	}
+
+	const uint8_t* packed = job.data.data();
+	for (size_t i = 0; i < job.rects.size(); ++i)
+	{
+		const Rect& rect = job.rects[i];
+		for (int y = rect.y; y < rect.y + rect.height; ++y)
+		{
+			const uint8_t* src;
+			if (job.direct)
+			{
+				src = job.direct + (static_cast<size_t>(y) * job.width + rect.x) * 4;
+			}
+			else
+			{
+				src = packed;
+				packed += static_cast<size_t>(rect.width) * 4;
+			}
+
+			uint8_t* dst = slot.pixels.data() + (static_cast<size_t>(y) * job.width + rect.x) * 4;
+			CEFPixelConvert::ConvertRow(src, dst, rect.width, 0);
+		}
+		copied += RectArea(rect) * 4;
+	}
+
+	std::lock_guard<std::mutex> lock(lock_);
+	slot.valid = true;
+	slot.stale.clear();
+	for (int i = 0; i < kSlotCount; ++i)
+	{
+		if (i == target)
+		{
+			continue;
+		}
+
+		slots_[i].stale.insert(slots_[i].stale.end(), job.rects.begin(), job.rects.end());
+		MergeRects(slots_[i].stale, kMaxDirtyRects);
+	}
+
+	if (latest_ >= 0 && latest_seq_ != acquired_seq_)
+	{
+		++stats_.skipped_frames;
+	}
+	latest_ = target;
+	++latest_seq_;
+	latest_painted_ = job.painted;
+
+	++stats_.frames;
+	if (job.full)
+	{
+		++stats_.full_copies;
+		pending_full_ = true;
+	}
+	else
+	{
+		pending_dirty_.insert(pending_dirty_.end(), job.rects.begin(), job.rects.end());
+		MergeRects(pending_dirty_, kMaxDirtyRects);
+	}
+	stats_.copied_bytes += copied;
+	stats_.last_copied_bytes = copied;
+}
+
+CEFOsrFrameBuffer::Stats CEFOsrFrameBuffer::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(lock_);
+	return stats_;
+}
+
+void CEFOsrFrameBuffer::MergeRects(std::vector<Rect>& rects, size_t max_count)
+{
+	for (;;)
+	{
+		// Overlapping or touching rects always merge. Repeat until stable since
+		// a merged rect can reach new neighbours.
+		bool merged = true;
+		while (merged)
+		{
+			merged = false;
+			for (size_t i = 0; i < rects.size(); ++i)
+			{
+				for (size_t j = i + 1; j < rects.size(); )
+				{
+					if (RectsTouch(rects[i], rects[j]))
+					{
+						rects[i] = RectUnion(rects[i], rects[j]);
+						rects.erase(rects.begin() + j);
+						merged = true;
+					}
+					else
+					{
+						++j;
+					}
+				}
+			}
+		}
+
+		if (rects.size() <= max_count || rects.size() < 2)
+		{
+			break;
+		}
+
+		// Over the cap, merge the pair that adds the least area.
+		size_t best_i = 0, best_j = 1;
+		int64_t best_cost = -1;
+		for (size_t i = 0; i < rects.size(); ++i)
+		{
+			for (size_t j = i + 1; j < rects.size(); ++j)
+			{
+				int64_t cost = RectArea(RectUnion(rects[i], rects[j])) - RectArea(rects[i]) - RectArea(rects[j]);
+				if (best_cost < 0 || cost < best_cost)
+				{
+					best_cost = cost;
+					best_i = i;
+					best_j = j;
+				}
+			}
+		}
+
+		rects[best_i] = RectUnion(rects[best_i], rects[best_j]);
+		rects.erase(rects.begin() + best_j);
+	}
+}
+
+bool CEFOsrFrameBuffer::IsFullUpdate(const std::vector<Rect>& rects, int width, int height) const
+{
+	int64_t area = 0;
+	for (size_t i = 0; i < rects.size(); ++i)
+	{
+		area += RectArea(rects[i]);
+	}
+
+	return area > static_cast<int64_t>(full_update_threshold_ * static_cast<float>(width) * height);
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class CEFFrameWorkerPool;
+
+// Triple-buffered CPU copy of the frames painted by a windowless browser.
+// OnPaint() takes the BGRA frame from CEF and stores it as RGBA, AcquireFrame()
+// returns the newest completed frame for upload and skips older ones. The two
+// may run on different threads.
+//
+// With a worker pool, OnPaint() only packs the dirty rows into a job and the
+// conversion runs on the pool, one job at a time per buffer. If paints arrive
+// faster than the pool converts them, the queued jobs are replaced by a single
+// full frame. Without a pool, or once it is gone, the conversion runs inside
+// OnPaint().
+//
+// Only dirty rows are converted. Each slot remembers what changed while the
+// others were written and catches up from the newest slot before it is reused.
+// Once the dirty area passes the full update threshold the whole frame is
+// converted and uploaded instead.
+//
+// This class does not depend on CEF or cocos2d so it can be fed with synthetic
+// paints. Create it with std::make_shared when a pool is used.
+class CEFOsrFrameBuffer : public std::enable_shared_from_this<CEFOsrFrameBuffer>
+{
+public:
+	struct Rect
+	{
+		int x;
+		int y;
+		int width;
+		int height;
+	};
+
+	struct Frame
+	{
+		// RGBA pixels with premultiplied alpha and an upper-left origin, rows
+		// are |width| * 4 bytes. Valid until the next AcquireFrame() call.
+		const uint8_t* pixels;
+		int width;
+		int height;
+
+		// Non-overlapping areas changed since the previously acquired frame.
+		// A full update is a single rect covering the frame.
+		const Rect* dirty_rects;
+		size_t dirty_count;
+		bool full_update;
+	};
+
+	struct Stats
+	{
+		uint64_t paints;
+		// Queued paints replaced by a full frame because the pool fell behind.
+		uint64_t dropped_paints;
+		// Frames converted, and those replaced before they were acquired.
+		uint64_t frames;
+		uint64_t skipped_frames;
+		uint64_t acquires;
+		uint64_t full_copies;
+		// Bytes written to the slots by conversions and catch-up copies.
+		uint64_t copied_bytes;
+		uint64_t last_copied_bytes;
+		// Bytes covered by the dirty rects of acquired frames.
+		uint64_t upload_bytes;
+		uint64_t last_upload_bytes;
+		// Time from OnPaint() to AcquireFrame() of the acquired frames.
+		uint64_t last_latency_us;
+		uint64_t max_latency_us;
+		uint64_t total_latency_us;
+	};
+
+	explicit CEFOsrFrameBuffer(const std::shared_ptr<CEFFrameWorkerPool>& pool = std::shared_ptr<CEFFrameWorkerPool>());
+
+	// Size of the view the browser should paint, in pixels.
+	void SetViewSize(int width, int height);
+	void GetViewSize(int& width, int& height) const;
+
+	// Fraction of the frame area above which a paint is converted and uploaded
+	// whole. Defaults to 0.5.
+	void SetFullUpdateThreshold(float fraction);
+
+	// |bgra| holds |width| * |height| BGRA pixels and |dirty| the areas that
+	// changed since the previous paint.
+	void OnPaint(const void* bgra, int width, int height, const Rect* dirty, size_t dirty_count);
+
+	// Returns false if no frame was completed since the last call.
+	bool AcquireFrame(Frame& frame);
+
+	// Wait until every queued paint is converted.
+	void Flush();
+
+	Stats GetStats() const;
+
+	// Merge overlapping or touching rects, then the cheapest pairs until at most
+	// |max_count| are left.
+	static void MergeRects(std::vector<Rect>& rects, size_t max_count);
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	enum { kSlotCount = 3 };
+
+	struct Slot
+	{
+		std::vector<uint8_t> pixels;
+		int width;
+		int height;
+		// False until the slot holds a complete frame of its size.
+		bool valid;
+		// Areas written to other slots since this one was written.
+		std::vector<Rect> stale;
+	};
+
+	struct Job
+	{
+		int width;
+		int height;
+		bool full;
+		Clock::time_point painted;
+		std::vector<Rect> rects;
+		// Either the CEF buffer itself, or the rows of |rects| packed one after
+		// the other in |data|.
+		const uint8_t* direct;
+		std::vector<uint8_t> data;
+	};
+
+	void MakeJob(Job& job, const uint8_t* bgra, int width, int height, std::vector<Rect>& rects, bool full, bool pack);
+	void RunJobs();
+	void ProcessJob(const Job& job);
+	bool IsFullUpdate(const std::vector<Rect>& rects, int width, int height) const;
+
+	// Weak so the pool is never destroyed from one of its own workers.
+	std::weak_ptr<CEFFrameWorkerPool> pool_;
+
+	mutable std::mutex lock_;
+	std::condition_variable flushed_;
+	Slot slots_[kSlotCount];
+	int latest_;
+	int reading_;
+	uint64_t latest_seq_;
+	uint64_t acquired_seq_;
+	Clock::time_point latest_painted_;
+	std::deque<Job> jobs_;
+	bool is_scheduled_;
+	int paint_width_;
+	int paint_height_;
+	int acquired_width_;
+	int acquired_height_;
+	bool pending_full_;
+	std::vector<Rect> pending_dirty_;
+	std::vector<Rect> acquired_dirty_;
+	float full_update_threshold_;
+	int view_width_;
+	int view_height_;
+	Stats stats_;
+};
@@ -0,0 +1,301 @@
+#include "CEFPixelConvert.h"
+
+#include <algorithm>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define CEF_PIXEL_CONVERT_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+// MSVC compiles any intrinsic, GCC and Clang need the target enabled per function.
+#if defined(CEF_PIXEL_CONVERT_X86) && !defined(_MSC_VER)
+#define CEF_TARGET(isa) __attribute__((target(isa)))
+#else
+#define CEF_TARGET(isa)
+#endif
+
+typedef void (*ConvertRowFunc)(const uint8_t* bgra, uint8_t* rgba, int pixels, bool unpremultiply);
+
+static inline uint8_t Unpremultiply(uint8_t c, uint8_t a)
+{
+	if (a == 0)
+	{
+		return 0;
+	}
+
+	// Rounded c * 255 / a. The SIMD kernels compute the same value in float,
+	// which is exact for these magnitudes.
+	unsigned value = (c * 255u + (a >> 1)) / a;
+	return static_cast<uint8_t>(std::min(value, 255u));
+}
+
+static void ConvertRowScalar(const uint8_t* bgra, uint8_t* rgba, int pixels, bool unpremultiply)
+{
+	for (int i = 0; i < pixels; ++i, bgra += 4, rgba += 4)
+	{
+		uint8_t b = bgra[0], g = bgra[1], r = bgra[2], a = bgra[3];
+		if (unpremultiply && a != 255)
+		{
+			r = Unpremultiply(r, a);
+			g = Unpremultiply(g, a);
+			b = Unpremultiply(b, a);
+		}
+
+		rgba[0] = r;
+		rgba[1] = g;
+		rgba[2] = b;
+		rgba[3] = a;
+	}
+}
+
+#if defined(CEF_PIXEL_CONVERT_X86)
+
+// Un-premultiply four RGBA pixels.
+CEF_TARGET("sse2")
+static inline __m128i UnpremultiplySSE2(__m128i rgba)
+{
+	const __m128i byte_mask = _mm_set1_epi32(0xFF);
+	const __m128 max_value = _mm_set1_ps(255.0f);
+
+	__m128i a = _mm_srli_epi32(rgba, 24);
+	__m128 af = _mm_cvtepi32_ps(a);
+	__m128 half = _mm_cvtepi32_ps(_mm_srli_epi32(a, 1));
+	__m128i zero_alpha = _mm_cmpeq_epi32(a, _mm_setzero_si128());
+
+	__m128i result = _mm_slli_epi32(a, 24);
+	for (int shift = 0; shift < 24; shift += 8)
+	{
+		__m128i c = _mm_and_si128(_mm_srl_epi32(rgba, _mm_cvtsi32_si128(shift)), byte_mask);
+		__m128 n = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(c), max_value), half);
+		__m128i q = _mm_cvttps_epi32(_mm_min_ps(_mm_div_ps(n, af), max_value));
+		q = _mm_andnot_si128(zero_alpha, q);
+		result = _mm_or_si128(result, _mm_sll_epi32(q, _mm_cvtsi32_si128(shift)));
+	}
+
+	return result;
+}
+
+CEF_TARGET("sse2")
+static void ConvertRowSSE2(const uint8_t* bgra, uint8_t* rgba, int pixels, bool unpremultiply)
+{
+	const __m128i keep_mask = _mm_set1_epi32(0xFF00FF00);
+	const __m128i byte_mask = _mm_set1_epi32(0xFF);
+
+	int i = 0;
+	for (; i + 4 <= pixels; i += 4, bgra += 16, rgba += 16)
+	{
+		__m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bgra));
+
+		// Swap the bytes 0 and 2 of every pixel.
+		__m128i swapped = _mm_or_si128(
+			_mm_and_si128(px, keep_mask),
+			_mm_or_si128(
+				_mm_and_si128(_mm_srli_epi32(px, 16), byte_mask),
+				_mm_slli_epi32(_mm_and_si128(px, byte_mask), 16)));
+
+		if (unpremultiply)
+		{
+			swapped = UnpremultiplySSE2(swapped);
+		}
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(rgba), swapped);
+	}
+
+	ConvertRowScalar(bgra, rgba, pixels - i, unpremultiply);
+}
+
+CEF_TARGET("ssse3")
+static void ConvertRowSSSE3(const uint8_t* bgra, uint8_t* rgba, int pixels, bool unpremultiply)
+{
+	const __m128i shuffle = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+	int i = 0;
+	for (; i + 4 <= pixels; i += 4, bgra += 16, rgba += 16)
+	{
+		__m128i px = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(bgra)), shuffle);
+
+		if (unpremultiply)
+		{
+			px = UnpremultiplySSE2(px);
+		}
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(rgba), px);
+	}
+
+	ConvertRowScalar(bgra, rgba, pixels - i, unpremultiply);
+}
+
+// Un-premultiply eight RGBA pixels.
+CEF_TARGET("avx2")
+static inline __m256i UnpremultiplyAVX2(__m256i rgba)
+{
+	const __m256i byte_mask = _mm256_set1_epi32(0xFF);
+	const __m256 max_value = _mm256_set1_ps(255.0f);
+
+	__m256i a = _mm256_srli_epi32(rgba, 24);
+	__m256 af = _mm256_cvtepi32_ps(a);
+	__m256 half = _mm256_cvtepi32_ps(_mm256_srli_epi32(a, 1));
+	__m256i zero_alpha = _mm256_cmpeq_epi32(a, _mm256_setzero_si256());
+
+	__m256i result = _mm256_slli_epi32(a, 24);
+	for (int shift = 0; shift < 24; shift += 8)
+	{
+		__m256i c = _mm256_and_si256(_mm256_srl_epi32(rgba, _mm_cvtsi32_si128(shift)), byte_mask);
+		__m256 n = _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(c), max_value), half);
+		__m256i q = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_div_ps(n, af), max_value));
+		q = _mm256_andnot_si256(zero_alpha, q);
+		result = _mm256_or_si256(result, _mm256_sll_epi32(q, _mm_cvtsi32_si128(shift)));
+	}
+
+	return result;
+}
+
+CEF_TARGET("avx2")
+static void ConvertRowAVX2(const uint8_t* bgra, uint8_t* rgba, int pixels, bool unpremultiply)
+{
+	const __m256i shuffle = _mm256_setr_epi8(
+		2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+		2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+	int i = 0;
+	for (; i + 8 <= pixels; i += 8, bgra += 32, rgba += 32)
+	{
+		__m256i px = _mm256_shuffle_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(bgra)), shuffle);
+
+		if (unpremultiply)
+		{
+			px = UnpremultiplyAVX2(px);
+		}
+
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(rgba), px);
+	}
+
+	ConvertRowSSSE3(bgra, rgba, pixels - i, unpremultiply);
+}
+
+static void CpuId(int info[4], int leaf, int subleaf)
+{
+#if defined(_MSC_VER)
+	__cpuidex(info, leaf, subleaf);
+#else
+	unsigned a = 0, b = 0, c = 0, d = 0;
+	__cpuid_count(leaf, subleaf, a, b, c, d);
+	info[0] = a;
+	info[1] = b;
+	info[2] = c;
+	info[3] = d;
+#endif
+}
+
+CEF_TARGET("xsave")
+static uint64_t ReadXCR0()
+{
+#if defined(_MSC_VER)
+	return _xgetbv(0);
+#else
+	return __builtin_ia32_xgetbv(0);
+#endif
+}
+
+static CEFPixelConvert::Isa DetectIsa()
+{
+	int info[4];
+	CpuId(info, 0, 0);
+	int max_leaf = info[0];
+
+	CpuId(info, 1, 0);
+	bool sse2 = (info[3] & (1 << 26)) != 0;
+	bool ssse3 = (info[2] & (1 << 9)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+
+	bool avx2 = false;
+	if (max_leaf >= 7 && avx && osxsave)
+	{
+		// The OS must save the YMM registers too.
+		bool ymm_enabled = (ReadXCR0() & 0x6) == 0x6;
+		CpuId(info, 7, 0);
+		avx2 = ymm_enabled && (info[1] & (1 << 5)) != 0;
+	}
+
+	if (avx2)
+		return CEFPixelConvert::kAVX2;
+	if (ssse3)
+		return CEFPixelConvert::kSSSE3;
+	if (sse2)
+		return CEFPixelConvert::kSSE2;
+	return CEFPixelConvert::kScalar;
+}
+
+#else
+
+static CEFPixelConvert::Isa DetectIsa()
+{
+	return CEFPixelConvert::kScalar;
+}
+
+#endif // CEF_PIXEL_CONVERT_X86
+
+static ConvertRowFunc GetConvertRowFunc(CEFPixelConvert::Isa isa)
+{
+	switch (isa)
+	{
+#if defined(CEF_PIXEL_CONVERT_X86)
+	case CEFPixelConvert::kAVX2:
+		return ConvertRowAVX2;
+	case CEFPixelConvert::kSSSE3:
+		return ConvertRowSSSE3;
+	case CEFPixelConvert::kSSE2:
+		return ConvertRowSSE2;
+#endif
+	default:
+		return ConvertRowScalar;
+	}
+}
+
+// Detected once; SetIsa() may swap the kernel afterwards.
+static CEFPixelConvert::Isa s_isa_ = DetectIsa();
+static ConvertRowFunc s_convertRow_ = GetConvertRowFunc(s_isa_);
+
+void CEFPixelConvert::ConvertRect(const uint8_t* bgra, uint8_t* rgba, int stride, int frame_height,
+	int x, int y, int width, int height, int flags)
+{
+	bool unpremultiply = (flags & kUnpremultiply) != 0;
+	bool flip = (flags & kFlipVertical) != 0;
+	ConvertRowFunc convert = s_convertRow_;
+
+	for (int row = y; row < y + height; ++row)
+	{
+		int dst_row = flip ? frame_height - 1 - row : row;
+		const uint8_t* src = bgra + static_cast<size_t>(row) * stride + static_cast<size_t>(x) * 4;
+		uint8_t* dst = rgba + static_cast<size_t>(dst_row) * stride + static_cast<size_t>(x) * 4;
+		convert(src, dst, width, unpremultiply);
+	}
+}
+
+void CEFPixelConvert::ConvertRow(const uint8_t* bgra, uint8_t* rgba, int pixels, int flags)
+{
+	s_convertRow_(bgra, rgba, pixels, (flags & kUnpremultiply) != 0);
+}
+
+CEFPixelConvert::Isa CEFPixelConvert::GetSupportedIsa()
+{
+	static const Isa supported = DetectIsa();
+	return supported;
+}
+
+CEFPixelConvert::Isa CEFPixelConvert::GetIsa()
+{
+	return s_isa_;
+}
+
+void CEFPixelConvert::SetIsa(Isa isa)
+{
+	s_isa_ = std::min(isa, GetSupportedIsa());
+	s_convertRow_ = GetConvertRowFunc(s_isa_);
+}
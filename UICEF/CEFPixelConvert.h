@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+
+// BGRA to RGBA conversion for off-screen web view frames. Rows are converted
+// with SSE2, SSSE3 or AVX2 kernels picked at runtime from CPUID, with a scalar
+// fallback that gives the same result bit for bit.
+class CEFPixelConvert
+{
+public:
+	enum Flags
+	{
+		// Divide the color channels by alpha. CEF paints premultiplied pixels.
+		kUnpremultiply = 1 << 0,
+		// Write rows bottom-up, for textures with a lower-left origin.
+		kFlipVertical = 1 << 1,
+	};
+
+	enum Isa
+	{
+		kScalar,
+		kSSE2,
+		kSSSE3,
+		kAVX2,
+	};
+
+	// Convert the |width| x |height| area at |x|, |y| of a frame that is
+	// |frame_height| rows high. Source and destination share the layout, rows
+	// are |stride| bytes. With kFlipVertical row y lands on frame_height - 1 - y.
+	static void ConvertRect(const uint8_t* bgra, uint8_t* rgba, int stride, int frame_height,
+		int x, int y, int width, int height, int flags);
+
+	// Convert |pixels| contiguous pixels.
+	static void ConvertRow(const uint8_t* bgra, uint8_t* rgba, int pixels, int flags);
+
+	// The best instruction set supported by this CPU.
+	static Isa GetSupportedIsa();
+
+	// The instruction set in use. SetIsa() is clamped to GetSupportedIsa() and
+	// is meant for comparing the kernels.
+	static Isa GetIsa();
+	static void SetIsa(Isa isa);
+};
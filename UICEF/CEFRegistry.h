@@ -0,0 +1,162 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Keeps objects by integer ID with constant time add, remove and lookup. IDs
+// are slot indexes tagged with a serial number, so the ID of a removed object
+// never finds the object that reuses its slot.
+//
+// ForEach() may be called while objects are added or removed, including by
+// the callback itself. Objects removed before their turn are skipped, objects
+// added during the walk are not visited: slots are not reused while walking.
+//
+// At most 65536 objects may be registered at once.
+//
+// The registry does not own nor retain the objects. Not thread safe.
+template <typename T>
+class CEFRegistry
+{
+public:
+	typedef int Id;
+
+	static const Id kInvalidId = 0;
+
+	CEFRegistry()
+		: size_(0)
+		, walk_depth_(0)
+		, next_serial_(1)
+	{
+	}
+
+	// Returns the ID of |item|, which must not be registered already.
+	Id Add(T* item)
+	{
+		// A free slot may lie ahead of a walk in progress.
+		size_t index;
+		if (!free_.empty() && walk_depth_ == 0)
+		{
+			index = free_.back();
+			free_.pop_back();
+		}
+		else
+		{
+			index = slots_.size();
+			assert(index <= kIndexMask && "too many objects for the bits of an ID");
+			slots_.push_back(Slot());
+		}
+
+		Slot& slot = slots_[index];
+		slot.item = item;
+		slot.serial = next_serial_++ & kSerialMask;
+		if (slot.serial == 0)
+		{
+			slot.serial = next_serial_++ & kSerialMask;
+		}
+		++size_;
+
+		return static_cast<Id>((slot.serial << kIndexBits) | static_cast<uint32_t>(index));
+	}
+
+	// Returns false if |id| is not registered.
+	bool Remove(Id id)
+	{
+		Slot* slot = FindSlot(id);
+		if (!slot)
+		{
+			return false;
+		}
+
+		slot->item = NULL;
+		slot->serial = 0;
+		--size_;
+
+		// A slot reused during a walk could be visited as if it was old.
+		if (walk_depth_ > 0)
+		{
+			pending_free_.push_back(IndexOf(id));
+		}
+		else
+		{
+			free_.push_back(IndexOf(id));
+		}
+
+		return true;
+	}
+
+	// Returns NULL if |id| is not registered.
+	T* Find(Id id) const
+	{
+		const Slot* slot = FindSlot(id);
+		return slot ? slot->item : NULL;
+	}
+
+	// Call |callback| with each object.
+	template <typename Callback>
+	void ForEach(const Callback& callback)
+	{
+		++walk_depth_;
+
+		size_t count = slots_.size();
+		for (size_t i = 0; i < count; ++i)
+		{
+			// Read again each time, the callback may add or remove objects.
+			T* item = slots_[i].item;
+			if (item)
+			{
+				callback(item);
+			}
+		}
+
+		if (--walk_depth_ == 0)
+		{
+			free_.insert(free_.end(), pending_free_.begin(), pending_free_.end());
+			pending_free_.clear();
+		}
+	}
+
+	size_t Size() const { return size_; }
+	bool IsEmpty() const { return size_ == 0; }
+
+private:
+	static const int kIndexBits = 16;
+	static const uint32_t kIndexMask = (1u << kIndexBits) - 1;
+	// Keeps IDs positive.
+	static const uint32_t kSerialMask = (1u << (31 - kIndexBits)) - 1;
+
+	struct Slot
+	{
+		Slot() : item(NULL), serial(0) {}
+
+		T* item;
+		uint32_t serial;
+	};
+
+	static size_t IndexOf(Id id) { return static_cast<uint32_t>(id) & kIndexMask; }
+
+	Slot* FindSlot(Id id)
+	{
+		return const_cast<Slot*>(static_cast<const CEFRegistry*>(this)->FindSlot(id));
+	}
+
+	const Slot* FindSlot(Id id) const
+	{
+		size_t index = IndexOf(id);
+		uint32_t serial = static_cast<uint32_t>(id) >> kIndexBits;
+		if (id <= 0 || index >= slots_.size() || serial == 0 || slots_[index].serial != serial)
+		{
+			return NULL;
+		}
+
+		return &slots_[index];
+	}
+
+	std::vector<Slot> slots_;
+	std::vector<size_t> free_;
+	std::vector<size_t> pending_free_;
+	size_t size_;
+	int walk_depth_;
+	uint32_t next_serial_;
+};
@@ -0,0 +1,82 @@
+#include "CEFSharedMemory.h"
+
+CEFSharedMemory::CEFSharedMemory()
+	: mapping_(NULL)
+	, memory_(NULL)
+	, size_(0)
+{
+}
+
+CEFSharedMemory::~CEFSharedMemory()
+{
+	Close();
+}
+
+bool CEFSharedMemory::Create(const std::string& name, size_t size)
+{
+	Close();
+
+	unsigned long long size64 = size;
+	HANDLE mapping = ::CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+		static_cast<DWORD>(size64 >> 32), static_cast<DWORD>(size64 & 0xffffffff), name.c_str());
+	if (!mapping)
+	{
+		return false;
+	}
+
+	// Someone else's block.
+	if (::GetLastError() == ERROR_ALREADY_EXISTS)
+	{
+		::CloseHandle(mapping);
+		return false;
+	}
+
+	return Map(mapping, name, size);
+}
+
+bool CEFSharedMemory::Open(const std::string& name, size_t size)
+{
+	Close();
+
+	HANDLE mapping = ::OpenFileMappingA(FILE_MAP_READ | FILE_MAP_WRITE, FALSE, name.c_str());
+	if (!mapping)
+	{
+		return false;
+	}
+
+	return Map(mapping, name, size);
+}
+
+bool CEFSharedMemory::Map(HANDLE mapping, const std::string& name, size_t size)
+{
+	void* memory = ::MapViewOfFile(mapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, size);
+	if (!memory)
+	{
+		::CloseHandle(mapping);
+		return false;
+	}
+
+	mapping_ = mapping;
+	memory_ = memory;
+	size_ = size;
+	name_ = name;
+	return true;
+}
+
+void CEFSharedMemory::Close()
+{
+	if (memory_)
+	{
+		::UnmapViewOfFile(memory_);
+		memory_ = NULL;
+	}
+
+	if (mapping_)
+	{
+		::CloseHandle(mapping_);
+		mapping_ = NULL;
+	}
+
+	size_ = 0;
+	name_.clear();
+}
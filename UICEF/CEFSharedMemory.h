@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <windows.h>
+
+// A named block of memory mapped by the browser process and a render process,
+// backed by the paging file. The block goes away once both have closed it.
+class CEFSharedMemory
+{
+public:
+	CEFSharedMemory();
+	~CEFSharedMemory();
+
+	// Create a zeroed block of |size| bytes under |name|. Fails if the name is
+	// taken.
+	bool Create(const std::string& name, size_t size);
+
+	// Map the block another process created under |name|.
+	bool Open(const std::string& name, size_t size);
+
+	void Close();
+
+	void* GetMemory() const { return memory_; }
+	size_t GetSize() const { return size_; }
+	const std::string& GetName() const { return name_; }
+
+private:
+	bool Map(HANDLE mapping, const std::string& name, size_t size);
+
+	HANDLE mapping_;
+	void* memory_;
+	size_t size_;
+	std::string name_;
+
+	CEFSharedMemory(const CEFSharedMemory&);
+	CEFSharedMemory& operator=(const CEFSharedMemory&);
+};
@@ -0,0 +1,227 @@
+#include "CEFSharedRing.h"
+#include <cstring>
+#include <new>
+
+// Both processes must agree on the layout, so the counters have to be lock-free
+// atomics, which keep no state outside of the shared memory.
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "64 bit atomics must be lock-free");
+
+typedef std::atomic<unsigned long long> SharedCounter;
+
+static const uint32_t kRingMagic = 0x43524e47; // "CRNG"
+static const uint32_t kRingVersion = 1;
+
+// Keep the header and every slot on their own cache lines.
+static const size_t kCacheLineSize = 64;
+
+static size_t RoundUp(size_t value, size_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+struct CEFSharedRing::Header
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t record_size;
+	uint32_t capacity;
+	// Records written so far, the next one goes to slot write_count % capacity.
+	SharedCounter write_count;
+};
+
+struct CEFSharedRing::Slot
+{
+	// 2 * index + 1 while record |index| is written, 2 * index + 2 once done.
+	SharedCounter sequence;
+	// The record follows, GetRecordSize() bytes.
+	unsigned char record[sizeof(SharedCounter)];
+};
+
+size_t CEFSharedRing::GetHeaderSize()
+{
+	return RoundUp(sizeof(Header), kCacheLineSize);
+}
+
+size_t CEFSharedRing::GetSlotSize(size_t record_size)
+{
+	return RoundUp(sizeof(SharedCounter) + record_size, kCacheLineSize);
+}
+
+size_t CEFSharedRing::GetRequiredSize(size_t record_size, size_t capacity)
+{
+	return GetHeaderSize() + GetSlotSize(record_size) * capacity;
+}
+
+CEFSharedRing::CEFSharedRing()
+	: header_(NULL)
+	, slots_(NULL)
+	, record_size_(0)
+	, capacity_(0)
+	, slot_size_(0)
+	, read_index_(0)
+{
+}
+
+bool CEFSharedRing::Create(void* memory, size_t size, size_t record_size, size_t capacity)
+{
+	Detach();
+
+	if (!memory || record_size == 0 || capacity == 0 ||
+		record_size > UINT32_MAX || capacity > UINT32_MAX ||
+		size < GetRequiredSize(record_size, capacity))
+	{
+		return false;
+	}
+
+	unsigned char* bytes = static_cast<unsigned char*>(memory);
+	size_t slot_size = GetSlotSize(record_size);
+	for (size_t i = 0; i < capacity; ++i)
+	{
+		new (bytes + GetHeaderSize() + i * slot_size) SharedCounter(0);
+	}
+
+	Header* header = static_cast<Header*>(memory);
+	header->record_size = static_cast<uint32_t>(record_size);
+	header->capacity = static_cast<uint32_t>(capacity);
+	header->version = kRingVersion;
+	new (&header->write_count) SharedCounter(0);
+
+	// The consumer checks the magic last.
+	std::atomic_thread_fence(std::memory_order_release);
+	header->magic = kRingMagic;
+
+	header_ = header;
+	slots_ = bytes + GetHeaderSize();
+	record_size_ = record_size;
+	capacity_ = capacity;
+	slot_size_ = slot_size;
+	return true;
+}
+
+bool CEFSharedRing::Attach(void* memory, size_t size)
+{
+	Detach();
+
+	if (!memory || size < GetHeaderSize())
+	{
+		return false;
+	}
+
+	Header* header = static_cast<Header*>(memory);
+	if (header->magic != kRingMagic)
+	{
+		return false;
+	}
+	std::atomic_thread_fence(std::memory_order_acquire);
+
+	if (header->version != kRingVersion || header->record_size == 0 || header->capacity == 0 ||
+		size < GetRequiredSize(header->record_size, header->capacity))
+	{
+		return false;
+	}
+
+	header_ = header;
+	slots_ = static_cast<unsigned char*>(memory) + GetHeaderSize();
+	record_size_ = header->record_size;
+	capacity_ = header->capacity;
+	slot_size_ = GetSlotSize(record_size_);
+	// Start with the oldest record still in the ring. The records overwritten
+	// before are counted as lost by the first Read().
+	read_index_ = 0;
+	return true;
+}
+
+void CEFSharedRing::Detach()
+{
+	header_ = NULL;
+	slots_ = NULL;
+	record_size_ = 0;
+	capacity_ = 0;
+	slot_size_ = 0;
+	read_index_ = 0;
+}
+
+CEFSharedRing::Slot* CEFSharedRing::GetSlot(uint64_t index) const
+{
+	return reinterpret_cast<Slot*>(slots_ + static_cast<size_t>(index % capacity_) * slot_size_);
+}
+
+void CEFSharedRing::Write(const void* record)
+{
+	if (!header_)
+	{
+		return;
+	}
+
+	unsigned long long index = header_->write_count.load(std::memory_order_relaxed);
+	Slot* slot = GetSlot(index);
+
+	// A seqlock: readers that see an odd or different sequence drop the copy.
+	slot->sequence.store(2 * index + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	memcpy(slot->record, record, record_size_);
+	slot->sequence.store(2 * index + 2, std::memory_order_release);
+
+	header_->write_count.store(index + 1, std::memory_order_release);
+}
+
+uint64_t CEFSharedRing::GetWriteCount() const
+{
+	return header_ ? header_->write_count.load(std::memory_order_acquire) : 0;
+}
+
+uint64_t CEFSharedRing::GetPendingCount() const
+{
+	return header_ ? header_->write_count.load(std::memory_order_acquire) - read_index_ : 0;
+}
+
+size_t CEFSharedRing::Read(void* out, size_t max_records, uint64_t* lost)
+{
+	if (!header_)
+	{
+		return 0;
+	}
+
+	uint64_t skipped = 0;
+	unsigned long long written = header_->write_count.load(std::memory_order_acquire);
+
+	// The producer lapped us, those records are gone.
+	if (written - read_index_ > capacity_)
+	{
+		skipped += written - capacity_ - read_index_;
+		read_index_ = written - capacity_;
+	}
+
+	unsigned char* target = static_cast<unsigned char*>(out);
+	size_t copied = 0;
+	while (read_index_ < written && copied < max_records)
+	{
+		Slot* slot = GetSlot(read_index_);
+		unsigned long long expected = 2 * read_index_ + 2;
+		++read_index_;
+
+		if (slot->sequence.load(std::memory_order_acquire) != expected)
+		{
+			++skipped;
+			continue;
+		}
+
+		memcpy(target + copied * record_size_, slot->record, record_size_);
+
+		// Overwritten while copying.
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (slot->sequence.load(std::memory_order_relaxed) != expected)
+		{
+			++skipped;
+			continue;
+		}
+
+		++copied;
+	}
+
+	if (lost)
+	{
+		*lost += skipped;
+	}
+	return copied;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Single producer, single consumer ring of fixed size records laid out in a
+// block of memory given by the caller, usually shared by two processes. The
+// producer never waits: once the consumer falls a full lap behind, the oldest
+// records are overwritten and the consumer skips them. Every slot carries a
+// sequence number, odd while the record is written, so a record overwritten
+// while it is read is detected and dropped rather than returned torn.
+//
+// The layout only uses fixed width fields and lock-free atomics, so both sides
+// may be different processes. This class does not depend on CEF nor on the way
+// the memory is shared.
+class CEFSharedRing
+{
+public:
+	// Bytes needed for |capacity| records of |record_size| bytes.
+	static size_t GetRequiredSize(size_t record_size, size_t capacity);
+
+	CEFSharedRing();
+
+	// Lay out an empty ring in |memory|, which must be 8 byte aligned and hold
+	// GetRequiredSize() bytes. Producer side.
+	bool Create(void* memory, size_t size, size_t record_size, size_t capacity);
+
+	// Use the ring laid out in |memory| by Create(), in this process or
+	// another. Returns false if the block does not hold a ring. Consumer side.
+	// Records written before are read too, those already overwritten count
+	// as lost.
+	bool Attach(void* memory, size_t size);
+
+	// Forget the memory, which the caller releases.
+	void Detach();
+
+	bool IsValid() const { return header_ != NULL; }
+	size_t GetRecordSize() const { return record_size_; }
+	size_t GetCapacity() const { return capacity_; }
+
+	// Append a record of GetRecordSize() bytes. Producer only.
+	void Write(const void* record);
+
+	// Number of records written so far.
+	uint64_t GetWriteCount() const;
+
+	// Copy the records written since the last call into |out|, oldest first, up
+	// to |max_records| of them. Those left over are returned by the next call.
+	// |lost| is increased by the records that were overwritten before they
+	// could be read, may be NULL. Consumer only.
+	size_t Read(void* out, size_t max_records, uint64_t* lost);
+
+	// Number of records written and not read yet, including those the
+	// producer already overwrote. Consumer only.
+	uint64_t GetPendingCount() const;
+
+private:
+	struct Header;
+	struct Slot;
+
+	static size_t GetHeaderSize();
+	static size_t GetSlotSize(size_t record_size);
+
+	Slot* GetSlot(uint64_t index) const;
+
+	Header* header_;
+	unsigned char* slots_;
+	size_t record_size_;
+	size_t capacity_;
+	size_t slot_size_;
+	// Only touched by the consumer.
+	uint64_t read_index_;
+
+	CEFSharedRing(const CEFSharedRing&);
+	CEFSharedRing& operator=(const CEFSharedRing&);
+};
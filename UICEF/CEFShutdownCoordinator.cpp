@@ -0,0 +1,161 @@
+#include "CEFShutdownCoordinator.h"
+#include <algorithm>
+#include <chrono>
+
+static const int kDefaultForceAfterMs = 2000;
+static const int kDefaultQuitAfterMs = 3000;
+
+static double SteadyClockMilliseconds()
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+CEFShutdownCoordinator::CEFShutdownCoordinator(const Clock& clock)
+	: clock_(clock ? clock : Clock(SteadyClockMilliseconds))
+	, is_shutting_down_(false)
+	, is_forced_(false)
+	, is_quit_posted_(false)
+	, force_after_ms_(kDefaultForceAfterMs)
+	, quit_after_ms_(kDefaultQuitAfterMs)
+	, begin_ms_(0.0)
+{
+}
+
+void CEFShutdownCoordinator::SetDeadlines(int force_after_ms, int quit_after_ms)
+{
+	force_after_ms_ = std::max(force_after_ms, 0);
+	quit_after_ms_ = std::max(quit_after_ms, force_after_ms_);
+}
+
+void CEFShutdownCoordinator::Begin()
+{
+	if (is_shutting_down_ || is_quit_posted_)
+	{
+		return;
+	}
+
+	is_shutting_down_ = true;
+	is_forced_ = false;
+	begin_ms_ = clock_();
+
+	if (callbacks_.started)
+	{
+		callbacks_.started();
+	}
+}
+
+void CEFShutdownCoordinator::OnCloseStarted(Window* window, int browser_id)
+{
+	if (!is_shutting_down_ || pending_.count(window))
+	{
+		return;
+	}
+
+	Pending pending;
+	pending.browser_id = browser_id;
+	pending.start_ms = clock_();
+	pending.forced = false;
+	pending_[window] = pending;
+}
+
+void CEFShutdownCoordinator::OnCloseFinished(Window* window)
+{
+	auto iter = pending_.find(window);
+	if (iter == pending_.end())
+	{
+		return;
+	}
+
+	Report report;
+	report.browser_id = iter->second.browser_id;
+	report.close_ms = clock_() - iter->second.start_ms;
+	report.forced = iter->second.forced;
+	report.abandoned = false;
+	reports_.push_back(report);
+
+	pending_.erase(iter);
+}
+
+void CEFShutdownCoordinator::Quit()
+{
+	if (is_quit_posted_)
+	{
+		return;
+	}
+	is_quit_posted_ = true;
+
+	Finish();
+
+	if (callbacks_.quit)
+	{
+		callbacks_.quit();
+	}
+}
+
+void CEFShutdownCoordinator::Finish()
+{
+	if (!is_shutting_down_)
+	{
+		return;
+	}
+	is_shutting_down_ = false;
+
+	// Closes still pending are abandoned, a late close finds nothing.
+	double now_ms = clock_();
+	for (auto iter = pending_.begin(); iter != pending_.end(); ++iter)
+	{
+		Report report;
+		report.browser_id = iter->second.browser_id;
+		report.close_ms = now_ms - iter->second.start_ms;
+		report.forced = iter->second.forced;
+		report.abandoned = true;
+		reports_.push_back(report);
+	}
+	pending_.clear();
+
+	if (callbacks_.finished)
+	{
+		callbacks_.finished();
+	}
+}
+
+void CEFShutdownCoordinator::Update()
+{
+	if (!is_shutting_down_)
+	{
+		return;
+	}
+
+	double elapsed_ms = clock_() - begin_ms_;
+
+	if (!is_forced_ && elapsed_ms >= force_after_ms_)
+	{
+		is_forced_ = true;
+		ForcePendingCloses();
+	}
+
+	if (elapsed_ms >= quit_after_ms_)
+	{
+		Quit();
+	}
+}
+
+void CEFShutdownCoordinator::ForcePendingCloses()
+{
+	// A forced close may finish right away and change |pending_|.
+	std::vector<Window*> windows;
+	windows.reserve(pending_.size());
+	for (auto iter = pending_.begin(); iter != pending_.end(); ++iter)
+	{
+		iter->second.forced = true;
+		windows.push_back(iter->first);
+	}
+
+	for (size_t i = 0; i < windows.size(); ++i)
+	{
+		if (pending_.count(windows[i]))
+		{
+			windows[i]->ForceClose();
+		}
+	}
+}
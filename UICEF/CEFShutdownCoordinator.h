@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+// Bounds the time the game takes to exit once every browser was asked to
+// close. Closes started after Begin() are tracked until their browser is
+// gone. Browsers still open after the force deadline are closed by force,
+// which skips unload handlers. Once the quit deadline passes the game quits
+// even if a renderer never answered.
+//
+// The latency of each close is kept for GetReports(). Must be used on the
+// cocos thread. This class does not depend on CEF or cocos2d, and the clock
+// is injectable, so the deadlines can be tested with stub windows.
+class CEFShutdownCoordinator
+{
+public:
+	// Returns a monotonic time in milliseconds.
+	typedef std::function<double()> Clock;
+
+	// A window whose close is tracked.
+	class Window
+	{
+	public:
+		// Close the browser now, CloseBrowser(true).
+		virtual void ForceClose() = 0;
+
+	protected:
+		virtual ~Window() {}
+	};
+
+	// What the coordinator has its owner do, on the cocos thread.
+	struct Callbacks
+	{
+		// Begin() was called, call Update() every frame until |finished|.
+		std::function<void()> started;
+		// The reports are final.
+		std::function<void()> finished;
+		// Post the message quitting the game.
+		std::function<void()> quit;
+	};
+
+	struct Report
+	{
+		int browser_id;
+		double close_ms;
+		// Closed by force after the deadline.
+		bool forced;
+		// Still open when the game quit.
+		bool abandoned;
+	};
+
+	explicit CEFShutdownCoordinator(const Clock& clock = Clock());
+
+	void SetCallbacks(const Callbacks& callbacks) { callbacks_ = callbacks; }
+
+	// Milliseconds after Begin() to force the remaining closes, and to quit
+	// anyway. Defaults to 2000 and 3000.
+	void SetDeadlines(int force_after_ms, int quit_after_ms);
+
+	// Start tracking closes and the deadlines. Does nothing if started already.
+	void Begin();
+	bool IsShuttingDown() const { return is_shutting_down_; }
+
+	// Called by the windows when they start closing, and when their browser
+	// is closed or they are deleted. |browser_id| is 0 if there is no browser.
+	void OnCloseStarted(Window* window, int browser_id);
+	void OnCloseFinished(Window* window);
+
+	// Number of closes started and not finished.
+	size_t GetPendingCount() const { return pending_.size(); }
+
+	// Enforces the deadlines, called every frame while shutting down.
+	void Update();
+
+	// Stop tracking, the game quits on its own.
+	void Finish();
+
+	// Finish and quit, once.
+	void Quit();
+	bool IsQuitPosted() const { return is_quit_posted_; }
+
+	const std::vector<Report>& GetReports() const { return reports_; }
+
+private:
+	struct Pending
+	{
+		int browser_id;
+		double start_ms;
+		bool forced;
+	};
+
+	void ForcePendingCloses();
+
+	Clock clock_;
+	Callbacks callbacks_;
+	bool is_shutting_down_;
+	bool is_forced_;
+	bool is_quit_posted_;
+	int force_after_ms_;
+	int quit_after_ms_;
+	double begin_ms_;
+	std::unordered_map<Window*, Pending> pending_;
+	std::vector<Report> reports_;
+
+	CEFShutdownCoordinator(const CEFShutdownCoordinator&);
+	CEFShutdownCoordinator& operator=(const CEFShutdownCoordinator&);
+};
@@ -0,0 +1,79 @@
+#include "CEFShutdownState.h"
+#include <algorithm>
+#include <chrono>
+
+CEFShutdownState::CEFShutdownState()
+	: state_(kRunning)
+	, window_count_(0)
+	, live_browser_count_(0)
+{
+}
+
+void CEFShutdownState::Advance(State state)
+{
+	{
+		std::lock_guard<std::mutex> lock(lock_);
+		if (state_ >= state)
+		{
+			return;
+		}
+		state_ = state;
+	}
+	cond_.notify_all();
+}
+
+void CEFShutdownState::Close()
+{
+	Advance(kClosing);
+	if (window_count_ == 0)
+	{
+		Advance(kDrained);
+	}
+}
+
+void CEFShutdownState::OnWindowCreated()
+{
+	++window_count_;
+}
+
+void CEFShutdownState::OnWindowDestroyed()
+{
+	if (--window_count_ == 0 && state_ == kClosing)
+	{
+		Advance(kDrained);
+	}
+}
+
+void CEFShutdownState::OnBrowserLifeSpan(bool alive)
+{
+	{
+		// Under the lock so Drain can't miss the wakeup.
+		std::lock_guard<std::mutex> lock(lock_);
+		live_browser_count_ += alive ? 1 : -1;
+	}
+	cond_.notify_all();
+}
+
+bool CEFShutdownState::Drain(int timeout_ms, int slice_ms, const std::function<void()>& pump)
+{
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+	while (live_browser_count_ > 0 && std::chrono::steady_clock::now() < deadline)
+	{
+		pump();
+
+		std::unique_lock<std::mutex> lock(lock_);
+		auto slice = std::chrono::steady_clock::now() + std::chrono::milliseconds(slice_ms);
+		cond_.wait_until(lock, std::min(slice, deadline), [this]() {
+			return live_browser_count_ == 0;
+		});
+	}
+
+	if (live_browser_count_ > 0)
+	{
+		return false;
+	}
+
+	// Deliver what the last browsers sent before they went away.
+	pump();
+	return true;
+}
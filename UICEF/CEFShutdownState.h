@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+
+// The steps of the CEF shutdown and the counts that drive them, shared by the
+// cocos thread, the pump thread and the CEF UI thread.
+//
+// The state only moves forward. It is an atomic changed under a mutex, and a
+// condition variable signals every change of the state or of the live browser
+// count. This class does not depend on CEF so the shutdown can be driven by
+// stub threads.
+class CEFShutdownState
+{
+public:
+	enum State
+	{
+		kRunning,
+		// Close() was called, the browsers are closing.
+		kClosing,
+		// No window is left, the pump thread stops.
+		kDrained,
+		// CefShutdown() returned.
+		kShutDown,
+	};
+
+	CEFShutdownState();
+
+	State GetState() const { return static_cast<State>(state_.load()); }
+
+	// Move to |state| unless the shutdown is already past it, and wake the
+	// threads waiting for a change.
+	void Advance(State state);
+
+	// Start closing, drained right away if no window is left.
+	void Close();
+
+	// Called by the windows on the cocos thread.
+	void OnWindowCreated();
+	void OnWindowDestroyed();
+	int GetWindowCount() const { return window_count_; }
+
+	// Called when CEF creates and closes a browser, from the CEF UI thread.
+	void OnBrowserLifeSpan(bool alive);
+	int GetLiveBrowserCount() const { return live_browser_count_; }
+
+	// Call |pump| until every browser closed or |timeout_ms| passed, waiting
+	// at most |slice_ms| between calls, then once more. Returns false on
+	// timeout. The browser count must drop after the close notification is
+	// queued, so that last call delivers it.
+	bool Drain(int timeout_ms, int slice_ms, const std::function<void()>& pump);
+
+private:
+	std::atomic<int> state_;
+	std::atomic<int> window_count_;
+	std::atomic<int> live_browser_count_;
+	std::mutex lock_;
+	std::condition_variable cond_;
+
+	CEFShutdownState(const CEFShutdownState&);
+	CEFShutdownState& operator=(const CEFShutdownState&);
+};
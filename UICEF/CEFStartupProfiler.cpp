@@ -0,0 +1,165 @@
+#include "CEFStartupProfiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+static const char* const s_kPhaseNames[CEFStartupProfiler::kPhaseCount] = {
+	"CefExecuteProcess",
+	"CefEnableHighDPISupport",
+	"CefInitialize",
+};
+
+static const char* const s_kMilestoneNames[CEFStartupProfiler::kMilestoneCount] = {
+	"register_window_class_begin",
+	"register_window_class_end",
+	"create_browser_begin",
+	"create_browser_end",
+	"after_created",
+	"first_load_end",
+};
+
+CEFStartupProfiler::Browser::Browser()
+	: id_(0)
+	, is_windowless_(false)
+{
+	for (int i = 0; i < kMilestoneCount; ++i)
+	{
+		times_[i] = 0;
+	}
+}
+
+void CEFStartupProfiler::Browser::Mark(Milestone milestone)
+{
+	// Only the first time counts, e.g. the first of many loads.
+	int64_t unset = 0;
+	times_[milestone].compare_exchange_strong(unset, Now(), std::memory_order_relaxed);
+}
+
+CEFStartupProfiler::CEFStartupProfiler()
+	: origin_(Now())
+	, browser_count_(0)
+{
+	std::fill(phase_begin_, phase_begin_ + kPhaseCount, 0);
+	std::fill(phase_end_, phase_end_ + kPhaseCount, 0);
+}
+
+void CEFStartupProfiler::BeginPhase(Phase phase)
+{
+	phase_begin_[phase] = Now();
+	phase_end_[phase] = 0;
+}
+
+void CEFStartupProfiler::EndPhase(Phase phase)
+{
+	phase_end_[phase] = Now();
+}
+
+double CEFStartupProfiler::GetPhaseMs(Phase phase) const
+{
+	if (!phase_begin_[phase] || !phase_end_[phase])
+	{
+		return 0.0;
+	}
+
+	return (phase_end_[phase] - phase_begin_[phase]) / 1e6;
+}
+
+CEFStartupProfiler::Browser* CEFStartupProfiler::AddBrowser(bool windowless)
+{
+	size_t index = browser_count_++;
+	if (index >= kMaxBrowsers)
+	{
+		return NULL;
+	}
+
+	Browser* browser = &browsers_[index];
+	browser->is_windowless_ = windowless;
+	return browser;
+}
+
+size_t CEFStartupProfiler::GetBrowserCount() const
+{
+	return std::min<size_t>(browser_count_, kMaxBrowsers);
+}
+
+double CEFStartupProfiler::ToMs(int64_t time) const
+{
+	return (time - origin_) / 1e6;
+}
+
+std::string CEFStartupProfiler::ToJSON() const
+{
+	char number[32];
+	std::string json = "{\"phases\":{";
+
+	bool first = true;
+	for (int i = 0; i < kPhaseCount; ++i)
+	{
+		if (!phase_begin_[i] || !phase_end_[i])
+		{
+			continue;
+		}
+
+		snprintf(number, sizeof(number), "%.3f", ToMs(phase_begin_[i]));
+		json += first ? "\"" : ",\"";
+		json += s_kPhaseNames[i];
+		json += "\":{\"begin_ms\":";
+		json += number;
+		snprintf(number, sizeof(number), "%.3f", GetPhaseMs(static_cast<Phase>(i)));
+		json += ",\"duration_ms\":";
+		json += number;
+		json += "}";
+		first = false;
+	}
+
+	json += "},\"browsers\":[";
+
+	size_t count = GetBrowserCount();
+	for (size_t i = 0; i < count; ++i)
+	{
+		const Browser& browser = browsers_[i];
+
+		snprintf(number, sizeof(number), "%d", browser.GetIdentifier());
+		json += i ? ",{\"id\":" : "{\"id\":";
+		json += number;
+		json += browser.IsWindowless() ? ",\"windowless\":true" : ",\"windowless\":false";
+
+		for (int j = 0; j < kMilestoneCount; ++j)
+		{
+			int64_t time = browser.GetTime(static_cast<Milestone>(j));
+			if (!time)
+			{
+				continue;
+			}
+
+			snprintf(number, sizeof(number), "%.3f", ToMs(time));
+			json += ",\"";
+			json += s_kMilestoneNames[j];
+			json += "_ms\":";
+			json += number;
+		}
+
+		json += "}";
+	}
+
+	json += "]}";
+	return json;
+}
+
+const char* CEFStartupProfiler::GetPhaseName(Phase phase)
+{
+	return s_kPhaseNames[phase];
+}
+
+const char* CEFStartupProfiler::GetMilestoneName(Milestone milestone)
+{
+	return s_kMilestoneNames[milestone];
+}
+
+int64_t CEFStartupProfiler::Now()
+{
+	int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+	return now ? now : 1;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Records when each step of the CEF startup happened, so launch time can be
+// split between initialization and the creation of the first browsers.
+//
+// Process phases are timed on the main thread around initCEF. Each browser
+// gets a record with its own milestones, which CEF may mark from its UI
+// thread. Marking reads the steady clock and does one compare-exchange, so
+// the first mark wins, with no lock or allocation. It stays well under a
+// microsecond, see CEFStartupProfilerBenchmark.
+//
+// Times are reported in milliseconds since the profiler was created.
+class CEFStartupProfiler
+{
+public:
+	enum Phase
+	{
+		kExecuteProcess,
+		kEnableHighDPISupport,
+		kInitialize,
+		kPhaseCount,
+	};
+
+	enum Milestone
+	{
+		// Only windowed browsers register the window class, once per process.
+		kRegisterWindowClassBegin,
+		kRegisterWindowClassEnd,
+		// Around the CefBrowserHost::CreateBrowser call.
+		kCreateBrowserBegin,
+		kCreateBrowserEnd,
+		kAfterCreated,
+		// The first main frame load that ended.
+		kFirstLoadEnd,
+		kMilestoneCount,
+	};
+
+	// Milestones of one browser. Each one keeps the first time it was marked.
+	class Browser
+	{
+	public:
+		Browser();
+
+		void Mark(Milestone milestone);
+		void SetIdentifier(int id) { id_ = id; }
+
+		int GetIdentifier() const { return id_; }
+		bool IsWindowless() const { return is_windowless_; }
+		// Returns 0 if |milestone| was not reached yet.
+		int64_t GetTime(Milestone milestone) const { return times_[milestone]; }
+
+	private:
+		friend class CEFStartupProfiler;
+
+		std::atomic<int64_t> times_[kMilestoneCount];
+		std::atomic<int> id_;
+		bool is_windowless_;
+	};
+
+	// Browsers past this count are not profiled.
+	static const size_t kMaxBrowsers = 64;
+
+	CEFStartupProfiler();
+
+	void BeginPhase(Phase phase);
+	void EndPhase(Phase phase);
+
+	// Duration of a finished phase in milliseconds, 0 otherwise.
+	double GetPhaseMs(Phase phase) const;
+
+	// Returns a record for a browser about to be created, NULL once
+	// kMaxBrowsers are profiled. Records live as long as the profiler.
+	Browser* AddBrowser(bool windowless);
+
+	size_t GetBrowserCount() const;
+	const Browser* GetBrowser(size_t index) const { return &browsers_[index]; }
+
+	// Milliseconds from the creation of the profiler to |time|.
+	double ToMs(int64_t time) const;
+
+	// The phases and the browsers' milestones as a JSON object. Unreached
+	// milestones are left out. Call on the main thread.
+	std::string ToJSON() const;
+
+	static const char* GetPhaseName(Phase phase);
+	static const char* GetMilestoneName(Milestone milestone);
+
+	// Steady clock in nanoseconds, never 0.
+	static int64_t Now();
+
+private:
+	int64_t origin_;
+	int64_t phase_begin_[kPhaseCount];
+	int64_t phase_end_[kPhaseCount];
+	Browser browsers_[kMaxBrowsers];
+	std::atomic<size_t> browser_count_;
+};
@@ -1,9 +1,10 @@
 #include "CEFUtils.h"
+#include "CEFBrowserPool.h"
 #include "CEFManager.h"
 
-bool cocos2d::CEFUtils::initCEF(void* instance, bool bMultiProcess)
+bool cocos2d::CEFUtils::initCEF(void* instance, bool bMultiProcess, bool bMultiThreadedMessageLoop)
 {
-	return CEFManager::getInstance()->initCEF((HINSTANCE)instance, bMultiProcess);
+	return CEFManager::getInstance()->initCEF((HINSTANCE)instance, bMultiProcess, bMultiThreadedMessageLoop);
 }
 
 void cocos2d::CEFUtils::closeCEF()
@@ -14,4 +15,49 @@ void cocos2d::CEFUtils::closeCEF()
 void cocos2d::CEFUtils::releaseCEF()
 {
 	CEFManager::releaseInstance();
+}
+
+void cocos2d::CEFUtils::setWindowlessRendering(bool enable)
+{
+	CEFManager::getInstance()->setWindowlessRendering(enable);
+}
+
+void cocos2d::CEFUtils::setLazyInit(bool lazy)
+{
+	CEFManager::getInstance()->setLazyInit(lazy);
+}
+
+void cocos2d::CEFUtils::warmUpCEF()
+{
+	CEFManager::getInstance()->warmUp();
+}
+
+std::string cocos2d::CEFUtils::getStartupProfileJSON()
+{
+	return CEFManager::getInstance()->getStartupProfiler()->ToJSON();
+}
+
+void cocos2d::CEFUtils::setSharedClientHandler(bool shared)
+{
+	CEFManager::getInstance()->setSharedClientHandler(shared);
+}
+
+void cocos2d::CEFUtils::setCloseDeadlines(int forceAfterMs, int quitAfterMs)
+{
+	CEFManager::getInstance()->getShutdownCoordinator()->SetDeadlines(forceAfterMs, quitAfterMs);
+}
+
+void cocos2d::CEFUtils::setBrowserPoolSize(int count)
+{
+	CEFManager::getInstance()->setBrowserPoolSize(count);
+}
+
+bool cocos2d::CEFUtils::preloadURL(const std::string& url)
+{
+	return CEFManager::getInstance()->getBrowserPool()->Preload(url);
+}
+
+void cocos2d::CEFUtils::setPreloadLimits(int maxCount, size_t memoryBudget)
+{
+	CEFManager::getInstance()->getBrowserPool()->SetPreloadLimits(maxCount, memoryBudget);
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <string>
 #include "platform/CCPlatformMacros.h"
 
 namespace cocos2d {
@@ -7,9 +8,41 @@ namespace cocos2d {
 class CC_DLL CEFUtils
 {
 public:
-	static bool initCEF(void* instance, bool bMultiProcess);
+	static bool initCEF(void* instance, bool bMultiProcess, bool bMultiThreadedMessageLoop = false);
 	static void closeCEF();
 	static void releaseCEF();
+
+	// Render web views into cocos textures instead of native child windows.
+	// Call before initCEF.
+	static void setWindowlessRendering(bool enable);
+
+	// Defer CefInitialize until the first web view is created, initCEF then
+	// only starts the sub-processes. Call before initCEF.
+	static void setLazyInit(bool lazy);
+
+	// With lazy init, initialize CEF at the start of the next frame, e.g. while
+	// a loading screen is shown, so the first web view does not wait for it.
+	static void warmUpCEF();
+
+	// Startup phases and the creation milestones of each browser, as JSON.
+	static std::string getStartupProfileJSON();
+
+	// Serve every browser with one client handler that dispatches events by
+	// browser identifier, instead of one handler per browser.
+	static void setSharedClientHandler(bool shared);
+
+	// On exit, force the browsers still open after |forceAfterMs| to close and
+	// quit after |quitAfterMs| even if some never did.
+	static void setCloseDeadlines(int forceAfterMs, int quitAfterMs);
+
+	// Keep |count| browsers created in advance for new web views. Call after
+	// initCEF and once the GL view exists.
+	static void setBrowserPoolSize(int count);
+
+	// Load |url| in a hidden browser so that a web view loading it later shows
+	// it at once. Preloading is off until the limits are set.
+	static bool preloadURL(const std::string& url);
+	static void setPreloadLimits(int maxCount, size_t memoryBudget);
 };
 
 };
@@ -1,16 +1,76 @@
 #include "CEFWebViewWrapper.h"
+#include "CEFApp.h"
+#include "CEFBrowserPool.h"
 #include "CEFManager.h"
 #include "include/cef_parser.h"
 
-CEFWebViewWrapper::WebViewList CEFWebViewWrapper::s_vec_webView_;
+// Scheduler key of the timeout of a request of evaluateJSAsync.
+static std::string JSRequestTimeoutKey(int requestId)
+{
+	return "evaluateJSAsync#" + std::to_string(requestId);
+}
+
+CEFWebViewWrapper::WebViewRegistry CEFWebViewWrapper::s_webViews_;
 WNDPROC CEFWebViewWrapper::s_pCocosWndProc_ = nullptr;
 bool CEFWebViewWrapper::s_bExitApp_ = false;
 int CEFWebViewWrapper::s_iWrapperCount_ = 0;
 
+// Replays the commands issued before the browser was created, or while it
+// waits for a load to commit.
+class BrowserCommandTarget : public CEFCommandQueue::Target
+{
+public:
+	BrowserCommandTarget(const CefRefPtr<CefBrowser>& browser, CEFJSRequests* requests)
+		: browser_(browser)
+		, requests_(requests)
+	{
+	}
+
+	virtual void LoadURL(const std::string& url) override
+	{
+		browser_->GetMainFrame()->LoadURL(url);
+	}
+
+	virtual void LoadString(const std::string& content, const std::string& url) override
+	{
+		browser_->GetMainFrame()->LoadString(content, url);
+	}
+
+	virtual void Reload() override
+	{
+		browser_->ReloadIgnoreCache();
+	}
+
+	virtual void ExecuteJavaScript(const std::string& code, const std::string& url, int tag) override
+	{
+		// The tag is the request of evaluateJSAsync the script answers.
+		if (tag != 0)
+		{
+			requests_->MarkSent(tag);
+		}
+		browser_->GetMainFrame()->ExecuteJavaScript(code, url, 0);
+	}
+
+private:
+	CefRefPtr<CefBrowser> browser_;
+	CEFJSRequests* requests_;
+};
+
 CEFWebViewWrapper::CEFWebViewWrapper()
 	: bIsCreated_(false)
+	, bIsLoading_(false)
+	, bCanGoBack_(false)
+	, bCanGoForward_(false)
+	, bIsFromPool_(false)
+	, bIsWaitingFirstPaint_(false)
+	, bBatchJS_(true)
+	, bIsJSFlushScheduled_(false)
+	, bIsDoorbellScheduled_(false)
 	, bScalePageToFit_(false)
+	, fOpacity_(1.0f)
+	, texture_(nullptr)
 	, cef_browse_window_(nullptr)
+	, iWebViewId_(WebViewRegistry::kInvalidId)
 {
 	s_iWrapperCount_++;
 }
@@ -19,11 +79,22 @@ CEFWebViewWrapper::~CEFWebViewWrapper()
 {
 	s_iWrapperCount_--;
 
+	// Nobody is left to answer.
+	std::vector<CEFJSRequests::Request> requests;
+	js_requests_.TakeAll(requests);
+	cocos2d::Scheduler* scheduler = cocos2d::Director::getInstance()->getScheduler();
+	for (size_t i = 0; i < requests.size(); ++i)
+	{
+		scheduler->unschedule(JSRequestTimeoutKey(requests[i].id), this);
+	}
+
 	if (cef_browse_window_)
 	{ 
 		delete cef_browse_window_;
 		cef_browse_window_ = nullptr;
 	}
+
+	CC_SAFE_RELEASE_NULL(texture_);
 }
 
 CEFWebViewWrapper * CEFWebViewWrapper::create(const std::string& url, const cocos2d::Rect& rect)
@@ -46,16 +117,66 @@ CEFWebViewWrapper * CEFWebViewWrapper::create()
 
 bool CEFWebViewWrapper::init(const std::string& url, const cocos2d::Rect& rect)
 {
-	cef_browse_window_ = new(std::nothrow) CEFBrowseWindow(this);
+	auto manager = CEFManager::getInstance();
+	bool windowless = manager->isWindowlessRendering();
+	auto pool = manager->getBrowserPool();
+	manager->onBrowserRequested();
+
+	if (!url.empty() && initPreloaded(url, rect))
+	{
+		return true;
+	}
+
+	cef_browse_window_ = pool->Acquire(windowless, this);
+	if (cef_browse_window_)
+	{
+		bIsFromPool_ = true;
+		pool->OnCreate(true);
+
+		cef_browse_window_->SetBounds((int)rect.origin.x, (int)rect.origin.y, (size_t)rect.size.width, (size_t)rect.size.height);
+		cef_browse_window_->Show();
+		cef_browse_window_->Resume();
+
+		// The browser already exists, go through the usual creation path.
+		if (!url.empty())
+		{
+			loadURL(url);
+		}
+		OnBrowserCreated(cef_browse_window_->GetBrowser());
+
+		return true;
+	}
+
+	pool->OnCreate(false);
+	cef_browse_window_ = new(std::nothrow) CEFBrowseWindow(this, windowless);
 	if (cef_browse_window_)
 	{
+		// Queued like any later load so that only the last one hits the network.
+		if (!url.empty())
+		{
+			loadURL(url);
+		}
 
-		auto direct = cocos2d::Director::getInstance();
-		CefRect cer_rect = { (int)rect.origin.x, (int)rect.origin.y, (int)rect.size.width, (int)rect.size.height };
-		auto hWnd = direct->getOpenGLView()->getWin32Window();
+		// The window keeps the bounds and visibility set until CEF is ready.
+		cef_browse_window_->SetBounds((int)rect.origin.x, (int)rect.origin.y, (size_t)rect.size.width, (size_t)rect.size.height);
 
-		CefBrowserSettings browser_settings;
-		cef_browse_window_->CreateBrowser(url, hWnd, cer_rect, browser_settings, NULL);
+		if (manager->isInitialized())
+		{
+			createBrowser();
+		}
+		else
+		{
+			// Lazy init, create once CEF is up unless this web view is gone by then.
+			manager->warmUp();
+			retain();
+			manager->whenInitialized([this]() {
+				if (getReferenceCount() > 1 && CEFManager::getInstance()->isInitialized())
+				{
+					createBrowser();
+				}
+				release();
+			});
+		}
 
 		return true;
 	}
@@ -63,21 +184,64 @@ bool CEFWebViewWrapper::init(const std::string& url, const cocos2d::Rect& rect)
 	return false;
 }
 
+void CEFWebViewWrapper::createBrowser()
+{
+	auto direct = cocos2d::Director::getInstance();
+	auto hWnd = direct->getOpenGLView()->getWin32Window();
+	CefRect cer_rect = cef_browse_window_->GetBounds();
+
+	// Start on the page asked for so far instead of loading it once
+	// OnAfterCreated made it back to this thread. What follows is replayed then.
+	std::string url;
+	pending_commands_.TakeInitialURL(url);
+
+	CefBrowserSettings browser_settings;
+	browser_settings.windowless_frame_rate = frame_rate_governor_.GetPolicy().max_fps;
+	cef_browse_window_->CreateBrowser(url, hWnd, cer_rect, browser_settings, NULL);
+
+	// A child window is created visible.
+	if (cef_browse_window_->IsHidden())
+	{
+		cef_browse_window_->Hide();
+	}
+	CEFManager::getInstance()->scheduleMessageLoopWork();
+}
+
 void CEFWebViewWrapper::OnBrowserCreated(const CefRefPtr<CefBrowser>& browser)
 {
 	bIsCreated_ = true;
+	CEFManager::getInstance()->onBrowserCreated();
 	hookWindowsProc();
 	addWebView(this);
 
-	if (!strUrl_.empty())
+	if (!pending_commands_.IsEmpty())
+	{
+		BrowserCommandTarget target(browser, &js_requests_);
+		pending_commands_.Replay(target);
+		CEFManager::getInstance()->scheduleMessageLoopWork();
+	}
+}
+
+bool CEFWebViewWrapper::isQueuingCommands() const
+{
+	return !bIsCreated_ || pending_commands_.IsWaitingForLoad();
+}
+
+void CEFWebViewWrapper::resumePendingCommands()
+{
+	if (!bIsCreated_ || pending_commands_.IsEmpty())
 	{
-		loadURL(strUrl_);
+		return;
 	}
+
+	BrowserCommandTarget target(cef_browse_window_->GetBrowser(), &js_requests_);
+	pending_commands_.ResumeAfterLoad(target);
+	CEFManager::getInstance()->scheduleMessageLoopWork();
 }
 
 void CEFWebViewWrapper::OnBrowserWindowDestroyed()
 {
-	bIsCreated_ = false;
+	resetBrowserState();
 	deleteWebView(this);
 }
 
@@ -95,15 +259,39 @@ void CEFWebViewWrapper::OnSetFullscreen(bool fullscreen)
 
 void CEFWebViewWrapper::OnSetLoadingState(bool isLoading, bool canGoBack, bool canGoForward)
 {
+	bCanGoBack_ = canGoBack;
+	bCanGoForward_ = canGoForward;
+
+	if (bIsLoading_ != isLoading)
+	{
+		bIsLoading_ = isLoading;
+		CEFManager::getInstance()->onBrowserLoadingStateChange(isLoading);
+	}
+
+	// A load that failed or was aborted before committing never reports its
+	// start, don't hold the commands queued behind it forever.
+	if (!isLoading)
+	{
+		resumePendingCommands();
+	}
 }
 
 void CEFWebViewWrapper::OnLoadingStart(const std::string& url)
 {
-	
+	// The scripts waited for went with the previous document, whoever
+	// started the navigation. Those held for this one can run now.
+	failJSRequests("cancelled");
+	resumePendingCommands();
 }
 
 void CEFWebViewWrapper::OnLoadingFinish(const std::string& url)
 {
+	// Windowed browsers don't report paints, their first load stands in.
+	if (!isWindowless())
+	{
+		onFirstPaint();
+	}
+
 	if (didFinishLoading)
 	{
 		didFinishLoading(url);
@@ -120,8 +308,9 @@ void CEFWebViewWrapper::OnLoadingError(const std::string& url)
 
 bool CEFWebViewWrapper::OnProcessRequest(const std::string& url)
 {
-	std::string scheme = url.substr(0, url.find_first_of(':'));
-	if (scheme == strCustomScheme_)
+	// Compared in place, every navigation goes through here.
+	size_t schemeLength = strCustomScheme_.size();
+	if (url.compare(0, schemeLength, strCustomScheme_) == 0 && (url.size() == schemeLength || url[schemeLength] == ':'))
 	{
 		if (onJsCallback)
 		{
@@ -142,6 +331,39 @@ void CEFWebViewWrapper::OnSetDraggableRegions(const std::vector<CefDraggableRegi
 {
 }
 
+void CEFWebViewWrapper::OnJSResult(int requestId, const std::string& token, bool success, const std::string& result)
+{
+	finishJSRequest(requestId, &token, success, result);
+}
+
+void CEFWebViewWrapper::OnPostMessage(const std::string& name, const std::string& payload)
+{
+	if (onJsMessage)
+	{
+		onJsMessage(name, payload);
+	}
+	else if (onJsCallback)
+	{
+		// The shape of the calls made through the scheme, escaped as the page
+		// would have to so that any name and payload survive the URL.
+		std::string url = strCustomScheme_ + "://" + CefURIEncode(name, false).ToString();
+		if (!payload.empty())
+		{
+			url += '?';
+			url += CefURIEncode(payload, false).ToString();
+		}
+		onJsCallback(url);
+	}
+}
+
+void CEFWebViewWrapper::OnPostBinary(const std::string& name, cocos2d::Data& data)
+{
+	if (onJsBinaryMessage)
+	{
+		onJsBinaryMessage(name, data);
+	}
+}
+
 void CEFWebViewWrapper::OnWindowDestroyed()
 {
 
@@ -154,18 +376,41 @@ void CEFWebViewWrapper::loadData(const cocos2d::Data & data, const std::string &
 
 void CEFWebViewWrapper::loadHTMLString(const std::string &string, const std::string &baseURL /*= ""*/)
 {
-	if (bIsCreated_)
+	flushJS();
+	failJSRequests("cancelled");
+	onLoadRequested();
+	if (!isQueuingCommands())
 	{
 		cef_browse_window_->GetBrowser()->GetMainFrame()->LoadString(string, baseURL);
+		CEFManager::getInstance()->scheduleMessageLoopWork();
+	}
+	else
+	{
+		pending_commands_.LoadString(string, baseURL);
 	}
 }
 
 void CEFWebViewWrapper::loadURL(const std::string &url)
 {
-	strUrl_ = url;
-	if (bIsCreated_)
+	// Scripts issued before the load run against the current page, which
+	// won't answer anymore.
+	flushJS();
+	failJSRequests("cancelled");
+
+	if (promotePreloaded(url))
+	{
+		return;
+	}
+
+	onLoadRequested();
+	if (!isQueuingCommands())
 	{
 		cef_browse_window_->GetBrowser()->GetMainFrame()->LoadURL(url);
+		CEFManager::getInstance()->scheduleMessageLoopWork();
+	}
+	else
+	{
+		pending_commands_.LoadURL(url);
 	}
 }
 
@@ -181,58 +426,310 @@ void CEFWebViewWrapper::loadFile(const std::string & fileName)
 
 void CEFWebViewWrapper::stopLoading()
 {
+	flushJS();
+	if (isQueuingCommands())
+	{
+		pending_commands_.StopLoad();
+	}
+
+	// Also stops the load the queue waits for.
 	if (bIsCreated_)
 	{
 		cef_browse_window_->GetBrowser()->StopLoad();
+		CEFManager::getInstance()->scheduleMessageLoopWork();
 	}
 }
 
 void CEFWebViewWrapper::reload()
 {
-	if (bIsCreated_)
+	flushJS();
+	failJSRequests("cancelled");
+	if (!isQueuingCommands())
 	{
 		cef_browse_window_->GetBrowser()->ReloadIgnoreCache();
+		CEFManager::getInstance()->scheduleMessageLoopWork();
+	}
+	else
+	{
+		pending_commands_.Reload();
 	}
 }
 
 bool CEFWebViewWrapper::canGoBack()
 {
-	if (bIsCreated_)
-	{
-		cef_browse_window_->GetBrowser()->CanGoBack();
-	}
-
-	return false;
+	// A recycled browser may have history from its previous owner, the window
+	// only reports what was navigated for this one.
+	return bIsCreated_ && bCanGoBack_;
 }
 
 bool CEFWebViewWrapper::canGoForward()
 {
-	if (bIsCreated_)
-	{
-		cef_browse_window_->GetBrowser()->CanGoForward();
-	}
-
-	return false;
+	return bIsCreated_ && bCanGoForward_;
 }
 
 void CEFWebViewWrapper::goBack()
 {
-	if (bIsCreated_)
+	if (canGoBack())
 	{
+		flushJS();
+		failJSRequests("cancelled");
 		cef_browse_window_->GetBrowser()->GoBack();
+		CEFManager::getInstance()->scheduleMessageLoopWork();
 	}
 }
 
 void CEFWebViewWrapper::goForward()
 {
-	if (bIsCreated_)
+	if (canGoForward())
 	{
+		flushJS();
+		failJSRequests("cancelled");
 		cef_browse_window_->GetBrowser()->GoForward();
+		CEFManager::getInstance()->scheduleMessageLoopWork();
 	}
 }
 
 void CEFWebViewWrapper::evaluateJS(const std::string & js)
 {
+	if (isQueuingCommands())
+	{
+		pending_commands_.ExecuteJavaScript(js, std::string());
+		return;
+	}
+
+	if (!bBatchJS_)
+	{
+		executeJS(js);
+		return;
+	}
+
+	js_batch_.Add(js);
+
+	// Sent once per frame, on the next scheduler tick.
+	if (!bIsJSFlushScheduled_)
+	{
+		bIsJSFlushScheduled_ = true;
+		retain();
+		cocos2d::Director::getInstance()->getScheduler()->performFunctionInCocosThread([this]() {
+			bIsJSFlushScheduled_ = false;
+			flushJS();
+			release();
+		});
+	}
+}
+
+int CEFWebViewWrapper::evaluateJSAsync(const std::string& script, const JSResultCallback& callback, float timeout)
+{
+	// A script waiting in the queue for a load isn't cancelled by that load.
+	bool isHeld = isQueuingCommands();
+	std::string token;
+	int requestId = js_requests_.Add(callback, token, isHeld);
+
+	if (timeout > 0.0f)
+	{
+		cocos2d::Director::getInstance()->getScheduler()->schedule([this, requestId](float) {
+			finishJSRequest(requestId, NULL, false, "timeout");
+		}, this, 0.0f, 0, timeout, false, JSRequestTimeoutKey(requestId));
+	}
+
+	std::string js = CEFClientHandler::BuildJSResultScript(requestId, token, script);
+	if (isHeld)
+	{
+		pending_commands_.ExecuteJavaScript(js, std::string(), requestId);
+	}
+	else
+	{
+		evaluateJS(js);
+	}
+	return requestId;
+}
+
+void CEFWebViewWrapper::cancelJSAsync(int requestId)
+{
+	JSResultCallback callback;
+	if (js_requests_.Take(requestId, NULL, callback))
+	{
+		cocos2d::Director::getInstance()->getScheduler()->unschedule(JSRequestTimeoutKey(requestId), this);
+	}
+}
+
+void CEFWebViewWrapper::finishJSRequest(int requestId, const std::string* token, bool success, const std::string& result)
+{
+	// Unknown once cancelled, timed out or left behind by a navigation.
+	JSResultCallback callback;
+	if (!js_requests_.Take(requestId, token, callback))
+	{
+		return;
+	}
+
+	cocos2d::Director::getInstance()->getScheduler()->unschedule(JSRequestTimeoutKey(requestId), this);
+
+	if (callback)
+	{
+		callback(success, result);
+	}
+}
+
+void CEFWebViewWrapper::failJSRequests(const std::string& reason, bool includeHeld)
+{
+	if (js_requests_.IsEmpty())
+	{
+		return;
+	}
+
+	// The callbacks may issue new requests, or release the web view.
+	std::vector<CEFJSRequests::Request> requests;
+	js_requests_.TakeAll(requests, includeHeld);
+
+	retain();
+	cocos2d::Scheduler* scheduler = cocos2d::Director::getInstance()->getScheduler();
+	for (size_t i = 0; i < requests.size(); ++i)
+	{
+		scheduler->unschedule(JSRequestTimeoutKey(requests[i].id), this);
+		if (requests[i].callback)
+		{
+			requests[i].callback(false, reason);
+		}
+	}
+	release();
+}
+
+bool CEFWebViewWrapper::sendBinary(const std::string& name, const cocos2d::Data& data)
+{
+	if (!bIsCreated_)
+	{
+		return false;
+	}
+
+	// Keep the order with evaluateJS.
+	flushJS();
+
+	// The bytes are copied once here, the message takes the value over.
+	CefRefPtr<CefProcessMessage> message = CefProcessMessage::Create(CEFApp::kBinaryMessage);
+	CefRefPtr<CefListValue> args = message->GetArgumentList();
+	args->SetString(0, name);
+	if (!data.isNull())
+	{
+		args->SetBinary(1, CefBinaryValue::Create(data.getBytes(), static_cast<size_t>(data.getSize())));
+	}
+
+	cef_browse_window_->GetBrowser()->SendProcessMessage(PID_RENDERER, message);
+	CEFManager::getInstance()->scheduleMessageLoopWork();
+	return true;
+}
+
+bool CEFWebViewWrapper::openStateStream(size_t recordSize, size_t capacity)
+{
+	closeStateStream();
+
+	if (!bIsCreated_)
+	{
+		return false;
+	}
+
+	// Unique across the web views and instances of the game.
+	static int s_iStateStreamSerial = 0;
+	std::string name = cocos2d::StringUtils::format("Local\\cocos-cef-state-%lu-%d",
+		static_cast<unsigned long>(::GetCurrentProcessId()), ++s_iStateStreamSerial);
+
+	size_t size = CEFSharedRing::GetRequiredSize(recordSize, capacity);
+	if (!state_memory_.Create(name, size) || !state_ring_.Create(state_memory_.GetMemory(), size, recordSize, capacity))
+	{
+		state_memory_.Close();
+		return false;
+	}
+
+	CefRefPtr<CefProcessMessage> message = CefProcessMessage::Create(CEFApp::kStateStreamOpenMessage);
+	CefRefPtr<CefListValue> args = message->GetArgumentList();
+	args->SetString(0, name);
+	args->SetDouble(1, static_cast<double>(size));
+	cef_browse_window_->GetBrowser()->SendProcessMessage(PID_RENDERER, message);
+	CEFManager::getInstance()->scheduleMessageLoopWork();
+	return true;
+}
+
+void CEFWebViewWrapper::closeStateStream()
+{
+	if (!state_ring_.IsValid())
+	{
+		return;
+	}
+
+	CefRefPtr<CefBrowser> browser = cef_browse_window_ ? cef_browse_window_->GetBrowser() : nullptr;
+	if (bIsCreated_ && browser)
+	{
+		browser->SendProcessMessage(PID_RENDERER, CefProcessMessage::Create(CEFApp::kStateStreamCloseMessage));
+		CEFManager::getInstance()->scheduleMessageLoopWork();
+	}
+
+	// The render process keeps its own mapping until it got the message.
+	state_ring_.Detach();
+	state_memory_.Close();
+}
+
+void CEFWebViewWrapper::writeState(const void* record)
+{
+	if (!state_ring_.IsValid())
+	{
+		return;
+	}
+
+	state_ring_.Write(record);
+
+	// One doorbell per frame, however many records were written.
+	if (!bIsDoorbellScheduled_)
+	{
+		bIsDoorbellScheduled_ = true;
+		retain();
+		cocos2d::Director::getInstance()->getScheduler()->performFunctionInCocosThread([this]() {
+			bIsDoorbellScheduled_ = false;
+			ringStateDoorbell();
+			release();
+		});
+	}
+}
+
+void CEFWebViewWrapper::ringStateDoorbell()
+{
+	if (!bIsCreated_ || !state_ring_.IsValid())
+	{
+		return;
+	}
+
+	cef_browse_window_->GetBrowser()->SendProcessMessage(PID_RENDERER, CefProcessMessage::Create(CEFApp::kStateStreamDoorbellMessage));
+	CEFManager::getInstance()->scheduleMessageLoopWork();
+}
+
+void CEFWebViewWrapper::setJSBatching(bool enable)
+{
+	if (!enable)
+	{
+		flushJS();
+	}
+	bBatchJS_ = enable;
+}
+
+void CEFWebViewWrapper::flushJS()
+{
+	if (js_batch_.IsEmpty())
+	{
+		return;
+	}
+
+	if (!bIsCreated_)
+	{
+		js_batch_.Clear();
+		return;
+	}
+
+	executeJS(js_batch_.Take());
+}
+
+void CEFWebViewWrapper::executeJS(const std::string& js)
+{
+	CefRefPtr<CefFrame> frame = cef_browse_window_->GetBrowser()->GetMainFrame();
+	frame->ExecuteJavaScript(js, frame->GetURL(), 0);
+	CEFManager::getInstance()->scheduleMessageLoopWork();
 }
 
 void CEFWebViewWrapper::setScalesPageToFit(const bool scalesPageToFit)
@@ -242,6 +739,9 @@ void CEFWebViewWrapper::setScalesPageToFit(const bool scalesPageToFit)
 
 void CEFWebViewWrapper::setVisible(bool visible)
 {
+	frame_rate_governor_.SetVisible(visible);
+	updateFrameRate();
+
 	if (cef_browse_window_)
 	{
 		if (visible)
@@ -255,13 +755,92 @@ void CEFWebViewWrapper::setVisible(bool visible)
 	}
 }
 
+void CEFWebViewWrapper::suspend()
+{
+	if (cef_browse_window_)
+	{
+		cef_browse_window_->Suspend();
+	}
+}
+
+void CEFWebViewWrapper::resume()
+{
+	if (cef_browse_window_)
+	{
+		cef_browse_window_->Resume();
+		CEFManager::getInstance()->scheduleMessageLoopWork();
+	}
+}
+
+bool CEFWebViewWrapper::isSuspended() const
+{
+	return cef_browse_window_ && cef_browse_window_->IsSuspended();
+}
+
 void CEFWebViewWrapper::setOpacityWebView(float opacity)
 {
+	// Only windowless browsers can be blended, see WebViewImpl::draw.
+	fOpacity_ = opacity;
 }
 
 float CEFWebViewWrapper::getOpacityWebView() const
 {
-	return 0.0f;
+	return fOpacity_;
+}
+
+bool CEFWebViewWrapper::isWindowless() const
+{
+	return cef_browse_window_ && cef_browse_window_->IsWindowless();
+}
+
+bool CEFWebViewWrapper::updateTexture()
+{
+	if (!isWindowless())
+	{
+		return false;
+	}
+
+	CEFOsrFrameBuffer::Frame frame;
+	if (!cef_browse_window_->GetFrameBuffer()->AcquireFrame(frame))
+	{
+		return false;
+	}
+	frame_rate_governor_.OnPaint();
+	onFirstPaint();
+
+	if (!texture_ || texture_->getPixelsWide() != frame.width || texture_->getPixelsHigh() != frame.height)
+	{
+		if (!texture_)
+		{
+			texture_ = new (std::nothrow) cocos2d::Texture2D();
+			if (!texture_)
+			{
+				return false;
+			}
+		}
+
+		texture_->initWithData(frame.pixels, frame.width * frame.height * 4, cocos2d::Texture2D::PixelFormat::RGBA8888,
+			frame.width, frame.height, cocos2d::Size(frame.width, frame.height));
+	}
+	else if (frame.full_update)
+	{
+		texture_->updateWithData(frame.pixels, 0, 0, frame.width, frame.height);
+	}
+	else
+	{
+		// Upload the dirty rects straight from the frame, the row length lets GL
+		// step over the untouched pixels.
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, frame.width);
+		for (size_t i = 0; i < frame.dirty_count; ++i)
+		{
+			const CEFOsrFrameBuffer::Rect& rect = frame.dirty_rects[i];
+			const uint8_t* origin = frame.pixels + (static_cast<size_t>(rect.y) * frame.width + rect.x) * 4;
+			texture_->updateWithData(origin, rect.x, rect.y, rect.width, rect.height);
+		}
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	}
+
+	return true;
 }
 
 void CEFWebViewWrapper::setBackgroundTransparent()
@@ -279,8 +858,30 @@ bool CEFWebViewWrapper::closeBrowser()
 	return false;
 }
 
+void CEFWebViewWrapper::setFocused(bool focused)
+{
+	frame_rate_governor_.SetFocused(focused);
+
+	if (cef_browse_window_)
+	{
+		cef_browse_window_->SetFocus(focused);
+	}
+}
+
+void CEFWebViewWrapper::updateFrameRate()
+{
+	if (bIsCreated_ && isWindowless())
+	{
+		cef_browse_window_->SetFrameRate(frame_rate_governor_.Update());
+	}
+}
+
 void CEFWebViewWrapper::setBounds(int x, int y, size_t width, size_t height)
 {
+	auto frameSize = cocos2d::Director::getInstance()->getOpenGLView()->getFrameSize();
+	float screenArea = frameSize.width * frameSize.height;
+	frame_rate_governor_.SetScreenCoverage(screenArea > 0 ? width * height / screenArea : 1.0f);
+
 	if (cef_browse_window_)
 	{
 		cef_browse_window_->SetBounds(x, y, width, height);
@@ -304,7 +905,211 @@ void CEFWebViewWrapper::onExit()
 {
 	if (cef_browse_window_)
 	{
-		cef_browse_window_->OnExit();
+		if (bIsCreated_ && CEFManager::getInstance()->getBrowserPool()->Release(cef_browse_window_))
+		{
+			// The pool owns the browser now, finish as if it was destroyed.
+			cef_browse_window_ = nullptr;
+			OnBrowserWindowDestroyed();
+		}
+		else
+		{
+			cef_browse_window_->OnExit();
+		}
+	}
+}
+
+bool CEFWebViewWrapper::initPreloaded(const std::string& url, const cocos2d::Rect& rect)
+{
+	auto manager = CEFManager::getInstance();
+	auto pool = manager->getBrowserPool();
+	bool windowless = manager->isWindowlessRendering();
+
+	// The preloaded page was never vetted by this web view. Its load goes the
+	// usual way and is cancelled there.
+	if (!pool->IsPreloaded(url, windowless) || !OnProcessRequest(url))
+	{
+		return false;
+	}
+
+	bool isLoaded = false;
+	cef_browse_window_ = pool->TakePreloaded(url, windowless, this, isLoaded);
+	if (!cef_browse_window_)
+	{
+		return false;
+	}
+
+	bIsFromPool_ = true;
+	pool->OnCreate(true);
+
+	cef_browse_window_->SetBounds((int)rect.origin.x, (int)rect.origin.y, (size_t)rect.size.width, (size_t)rect.size.height);
+	cef_browse_window_->Show();
+	cef_browse_window_->Resume();
+
+	onPreloadedTaken(url, isLoaded);
+	return true;
+}
+
+bool CEFWebViewWrapper::promotePreloaded(const std::string& url)
+{
+	// Before the browser exists the load is queued, the window being created
+	// can't be handed to the pool. init() takes a preloaded browser itself.
+	if (!bIsCreated_ || !cef_browse_window_ || cef_browse_window_->IsClosing())
+	{
+		return false;
+	}
+
+	// The preloaded page was never vetted by this web view.
+	auto pool = CEFManager::getInstance()->getBrowserPool();
+	if (pool->IsPreloaded(url, isWindowless()) && !OnProcessRequest(url))
+	{
+		return true;
+	}
+
+	bool isLoaded = false;
+	CEFBrowseWindow* preloaded = pool->TakePreloaded(url, isWindowless(), this, isLoaded);
+	if (!preloaded)
+	{
+		return false;
+	}
+
+	// The stream belongs to the browser being replaced.
+	closeStateStream();
+
+	CEFBrowseWindow* previous = cef_browse_window_;
+	cef_browse_window_ = preloaded;
+
+	// Take over where the previous browser was shown.
+	const CefRect& bounds = previous->GetBounds();
+	cef_browse_window_->SetBounds(bounds.x, bounds.y, bounds.width, bounds.height);
+	if (!previous->IsHidden())
+	{
+		cef_browse_window_->Show();
+	}
+	if (!previous->IsSuspended())
+	{
+		cef_browse_window_->Resume();
+	}
+
+	if (!pool->Release(previous))
+	{
+		pool->Discard(previous);
+	}
+
+	// The frames of the new browser start over in a new texture.
+	CC_SAFE_RELEASE_NULL(texture_);
+
+	resetBrowserState();
+	onPreloadedTaken(url, isLoaded);
+	return true;
+}
+
+void CEFWebViewWrapper::onPreloadedTaken(const std::string& url, bool isLoaded)
+{
+	onLoadRequested();
+	OnBrowserCreated(cef_browse_window_->GetBrowser());
+
+	if (isLoaded)
+	{
+		// The load events went to the pool, tell the game on the next frame like
+		// a real load would.
+		retain();
+		cocos2d::Director::getInstance()->getScheduler()->performFunctionInCocosThread([this, url]() {
+			if (bIsCreated_)
+			{
+				OnLoadingFinish(url);
+			}
+			release();
+		});
+	}
+}
+
+void CEFWebViewWrapper::resetBrowserState()
+{
+	closeStateStream();
+	bIsCreated_ = false;
+	js_batch_.Clear();
+	pending_commands_.Clear();
+	failJSRequests("cancelled", true);
+	bCanGoBack_ = false;
+	bCanGoForward_ = false;
+	if (bIsLoading_)
+	{
+		bIsLoading_ = false;
+		CEFManager::getInstance()->onBrowserLoadingStateChange(false);
+	}
+}
+
+void CEFWebViewWrapper::onLoadRequested()
+{
+	if (!bIsWaitingFirstPaint_)
+	{
+		bIsWaitingFirstPaint_ = true;
+		loadRequestTime_ = std::chrono::steady_clock::now();
+	}
+}
+
+void CEFWebViewWrapper::onFirstPaint()
+{
+	if (bIsWaitingFirstPaint_)
+	{
+		bIsWaitingFirstPaint_ = false;
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadRequestTime_).count();
+		CEFManager::getInstance()->getBrowserPool()->OnFirstPaint(bIsFromPool_, ms);
+	}
+}
+
+bool CEFWebViewWrapper::closeAll()
+{
+	s_bExitApp_ = true;
+	CEFManager::getInstance()->getShutdownCoordinator()->Begin();
+
+	bool bClose = CEFManager::getInstance()->getBrowserPool()->CloseAll();
+
+	// A browser closing right away unregisters its web view during the walk.
+	s_webViews_.ForEach([&bClose](CEFWebViewWrapper* webView) {
+		bClose |= webView->closeBrowser();
+	});
+
+	// Nothing to wait for, the window closes right away.
+	if (!bClose)
+	{
+		CEFManager::getInstance()->getShutdownCoordinator()->Finish();
+	}
+
+	return bClose;
+}
+
+void CEFWebViewWrapper::addWebView(CEFWebViewWrapper* webView)
+{
+	if (webView->iWebViewId_ == WebViewRegistry::kInvalidId)
+	{
+		webView->retain();
+		webView->iWebViewId_ = s_webViews_.Add(webView);
+	}
+}
+
+void CEFWebViewWrapper::deleteWebView(CEFWebViewWrapper* webView)
+{
+	if (s_webViews_.Remove(webView->iWebViewId_))
+	{
+		webView->iWebViewId_ = WebViewRegistry::kInvalidId;
+		// May delete |webView|.
+		webView->release();
+	}
+
+	quitIfAllClosed();
+}
+
+bool CEFWebViewWrapper::shouldCloseApp()
+{
+	return s_bExitApp_ && s_webViews_.IsEmpty() && CEFManager::getInstance()->getBrowserPool()->IsEmpty();
+}
+
+void CEFWebViewWrapper::quitIfAllClosed()
+{
+	if (shouldCloseApp())
+	{
+		CEFManager::getInstance()->getShutdownCoordinator()->Quit();
 	}
 }
 
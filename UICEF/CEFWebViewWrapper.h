@@ -1,7 +1,15 @@
 #pragma once
 
+#include <chrono>
 #include "cocos2d.h"
 #include "CEFBrowseWindow.h"
+#include "CEFCommandQueue.h"
+#include "CEFFrameRateGovernor.h"
+#include "CEFJSBatch.h"
+#include "CEFJSRequests.h"
+#include "CEFRegistry.h"
+#include "CEFSharedMemory.h"
+#include "CEFSharedRing.h"
 
 class CEFWebViewWrapper : public cocos2d::Ref, public CEFBrowseWindow::Delegate
 {
@@ -18,6 +26,9 @@ public:
 	/**
 	 * Set javascript interface scheme.
 	 *
+	 * Navigating to it costs a cancelled navigation per call, pages should
+	 * prefer window.cocos.postMessage(name, payload), see onJsMessage.
+	 *
 	 * @see WebView::setOnJSCallback()
 	 */
 	void setJavascriptInterfaceScheme(const std::string &scheme) { strCustomScheme_ = scheme; };
@@ -100,9 +111,78 @@ public:
 
 	/**
 	 * Evaluates JavaScript in the context of the currently displayed page.
+	 * Scripts issued before the browser exists run once it is created, those
+	 * queued after a load once that load commits.
+	 *
+	 * Scripts issued during a frame are sent together on the next one, in
+	 * order, as a single execution. Each still runs as a script of its own,
+	 * see CEFJSBatch. Under a content security policy forbidding inline
+	 * scripts, declare what must outlive a script with var or on window.
 	 */
 	void evaluateJS(const std::string &js);
 
+	/**
+	 * Send each script on its own right away instead of batching them per
+	 * frame. Enabled by default.
+	 */
+	void setJSBatching(bool enable);
+
+	typedef CEFJSRequests::Callback JSResultCallback;
+
+	/**
+	 * Evaluates |script| as the body of a function in the current page, and
+	 * passes the JSON of its return value to |callback|. A returned promise is
+	 * waited for. Runs in order with evaluateJS.
+	 *
+	 * |callback| gets false with the error text if the script throws, with
+	 * "timeout" if the page did not answer within |timeout| seconds (0 waits
+	 * forever), and with "cancelled" if the page is left or closed first.
+	 *
+	 * @return The id of the request for cancelJSAsync.
+	 */
+	int evaluateJSAsync(const std::string& script, const JSResultCallback& callback, float timeout = 5.0f);
+
+	/**
+	 * Forget a request of evaluateJSAsync, its callback is not called.
+	 */
+	void cancelJSAsync(int requestId);
+
+	/**
+	 * Sends |data| to cocos.onBinaryMessage(name, arrayBuffer) of the current
+	 * page, after the scripts issued before. Pages answer with
+	 * cocos.postBinary(name, buffer), see onJsBinaryMessage.
+	 *
+	 * @return false if the browser is not created yet.
+	 */
+	bool sendBinary(const std::string& name, const cocos2d::Data& data);
+
+	/**
+	 * Opens a stream of fixed size state records for the current page, for
+	 * state written every frame. The records go through a shared memory ring
+	 * of |capacity| records of |recordSize| bytes. Only a doorbell message per
+	 * frame goes over IPC.
+	 *
+	 * The page reads the records written since its last read with
+	 * cocos.readState(), or gets them in cocos.onState(state) after each frame
+	 * with new ones. |state| holds buffer, recordSize, count and lost, the
+	 * records overwritten before the page read them.
+	 *
+	 * @return false if the browser is not created yet or the memory could not
+	 * be mapped.
+	 */
+	bool openStateStream(size_t recordSize, size_t capacity);
+
+	/**
+	 * Closes the stream, also done when the browser goes away.
+	 */
+	void closeStateStream();
+
+	/**
+	 * Appends a record of the size given to openStateStream. Never waits for
+	 * the page.
+	 */
+	void writeState(const void* record);
+
 	
 	/**
 	 * Set whether the webview bounces at end of scroll of WebView.
@@ -118,6 +198,23 @@ public:
 	 * Toggle visibility of WebView.
 	 */
 	void setVisible(bool visible);
+	/**
+	 * Put the browser to sleep while the web view is not needed. The renderer
+	 * is told it is hidden, so JS timers are throttled and nothing is painted,
+	 * and playing media is paused. Navigation still works while suspended.
+	 */
+	void suspend();
+
+	/**
+	 * Wake a suspended browser up, restoring its bounds and the paused media.
+	 */
+	void resume();
+
+	/**
+	 * Whether the browser is suspended.
+	 */
+	bool isSuspended() const;
+
 	/**
 	 * SetOpacity of webview.
 	 */
@@ -128,6 +225,41 @@ public:
 	 */
 	float getOpacityWebView() const;
 
+	/**
+	 * Whether the browser renders off-screen into getTexture().
+	 */
+	bool isWindowless() const;
+
+	/**
+	 * Texture holding the last off-screen frame, nullptr until the first paint
+	 * or for windowed browsers.
+	 */
+	cocos2d::Texture2D* getTexture() const { return texture_; }
+
+	/**
+	 * Upload the newest off-screen frame to getTexture(). Call once per frame.
+	 *
+	 * @return true if the texture changed.
+	 */
+	bool updateTexture();
+
+	/**
+	 * Tell the web view whether it has the player's attention. Unfocused
+	 * windowless views render at a lower rate.
+	 */
+	void setFocused(bool focused);
+
+	/**
+	 * Re-evaluate and apply the frame rate of a windowless browser. Call once
+	 * per frame, after updateTexture().
+	 */
+	void updateFrameRate();
+
+	/**
+	 * The policy deciding the frame rate of windowless browsers.
+	 */
+	CEFFrameRateGovernor& getFrameRateGovernor() { return frame_rate_governor_; }
+
 	/**
 	 * set the background transparent
 	 */
@@ -154,55 +286,73 @@ public:
 	void onExit();
 
 public:
-	static bool closeAll() {
-		s_bExitApp_ = true;
-
-		bool bClose = false;
-		
-		if (!s_vec_webView_.empty())
-		{
-			auto vTemp = s_vec_webView_;
-			for each(auto iter in vTemp)
-			{
-				bClose |= iter->closeBrowser();
-			}
-		}
-	
-		return bClose;
-	};
-
-	static void addWebView(CEFWebViewWrapper* webView) {
-		if (!s_vec_webView_.contains(webView))
-		{
-			s_vec_webView_.pushBack(webView);
-		}
-	}
+	static bool closeAll();
 
-	static void deleteWebView(CEFWebViewWrapper* webView) {
-		s_vec_webView_.eraseObject(webView, true);
+	// Register a web view that has a browser, retaining it until deleteWebView.
+	static void addWebView(CEFWebViewWrapper* webView);
+	static void deleteWebView(CEFWebViewWrapper* webView);
 
-		if (s_bExitApp_ && s_vec_webView_.empty())
-		{
-			//quit message should run in main thread.
-			cocos2d::AsyncTaskPool::getInstance()->enqueue(cocos2d::AsyncTaskPool::TaskType::TASK_OTHER, [](void*) {
-				::PostQuitMessage(0);
-			}, nullptr, []() {});
-		}
-	}
+	// Returns nullptr if no registered web view has this ID.
+	static CEFWebViewWrapper* getWebView(int id) { return s_webViews_.Find(id); }
+
+	// ID of the web view while it is registered, 0 otherwise.
+	int getWebViewId() const { return iWebViewId_; }
+
+	// Quit once closeAll() has closed the last browser, pooled ones included.
+	static void quitIfAllClosed();
 
 	static bool isEmpty() {
-		return s_vec_webView_.empty();
+		return s_webViews_.IsEmpty();
 	}
 
-	static bool shouldCloseApp() {
-		return s_bExitApp_ && s_vec_webView_.empty();
-	}
+	static bool shouldCloseApp();
 
 	static int getWrapperCount() { return s_iWrapperCount_; }
 
 	static float getDeviceScaleFactor();
 
 private:
+	// Start out with the browser that preloaded |url|, if the pool has one.
+	bool initPreloaded(const std::string& url, const cocos2d::Rect& rect);
+
+	// Swap the created browser for one that preloaded |url|. Returns true if
+	// the load is handled.
+	bool promotePreloaded(const std::string& url);
+
+	// Take over the preloaded browser now in |cef_browse_window_|.
+	void onPreloadedTaken(const std::string& url, bool isLoaded);
+
+	// Forget the state of the browser that is going away.
+	void resetBrowserState();
+
+	// Create the browser of a web view that did not get one from the pool.
+	void createBrowser();
+
+	// Whether commands go to |pending_commands_| rather than to the browser:
+	// it doesn't exist yet, or earlier commands wait for a load to commit.
+	bool isQueuingCommands() const;
+
+	// Replay the commands that waited for the load to commit.
+	void resumePendingCommands();
+
+	// Send the scripts batched by evaluateJS. Called once per frame and before
+	// anything that changes the document.
+	void flushJS();
+	void executeJS(const std::string& js);
+
+	// Answer the requests of evaluateJSAsync. The page must give the |token|
+	// of the request, NULL for answers made here.
+	void finishJSRequest(int requestId, const std::string* token, bool success, const std::string& result);
+	// Without |includeHeld| the requests whose script waits for a load stay.
+	void failJSRequests(const std::string& reason, bool includeHeld = false);
+
+	// Tell the page about new state records.
+	void ringStateDoorbell();
+
+	// Start timing the first paint at the first load request.
+	void onLoadRequested();
+	void onFirstPaint();
+
 	void hookWindowsProc();
 	static LRESULT CALLBACK hookGLFWWindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
 
@@ -211,6 +361,14 @@ public:
 	std::function<void(std::string url)> didFinishLoading = nullptr;
 	std::function<void(std::string url)> didFailLoading = nullptr;
 	std::function<void(std::string url)> onJsCallback = nullptr;
+	// Called for window.cocos.postMessage(name, payload). When unset the call
+	// reaches onJsCallback as "<scheme>://<name>?<payload>", with the name
+	// and the payload percent-encoded.
+	std::function<void(const std::string& name, const std::string& payload)> onJsMessage = nullptr;
+	// Called for window.cocos.postBinary(name, buffer). |data| is only valid
+	// during the call. To keep the bytes without a copy, move them out:
+	// cocos2d::Data kept(std::move(data)).
+	std::function<void(const std::string& name, cocos2d::Data& data)> onJsBinaryMessage = nullptr;
 
 protected:
 	bool init(const std::string& url, const cocos2d::Rect& rect);
@@ -248,18 +406,44 @@ protected:
 	// Set the draggable regions.
 	virtual void OnSetDraggableRegions(const std::vector<CefDraggableRegion>& regions) override;
 
+	// The page answered a request of evaluateJSAsync.
+	virtual void OnJSResult(int requestId, const std::string& token, bool success, const std::string& result) override;
+
+	// The page called window.cocos.postMessage.
+	virtual void OnPostMessage(const std::string& name, const std::string& payload) override;
+
+	// The page called window.cocos.postBinary.
+	virtual void OnPostBinary(const std::string& name, cocos2d::Data& data) override;
+
 	// On window destroyed event.
 	virtual void OnWindowDestroyed() override;
 
 private:
 	bool bIsCreated_;
+	bool bIsLoading_;
+	bool bCanGoBack_;
+	bool bCanGoForward_;
+	bool bIsFromPool_;
+	bool bIsWaitingFirstPaint_;
+	bool bBatchJS_;
+	bool bIsJSFlushScheduled_;
+	CEFJSBatch js_batch_;
+	CEFJSRequests js_requests_;
+	CEFSharedMemory state_memory_;
+	CEFSharedRing state_ring_;
+	bool bIsDoorbellScheduled_;
+	std::chrono::steady_clock::time_point loadRequestTime_;
 	bool bScalePageToFit_;
-	std::string strUrl_;
+	float fOpacity_;
+	cocos2d::Texture2D* texture_;
+	CEFFrameRateGovernor frame_rate_governor_;
+	CEFCommandQueue pending_commands_;
 	std::string strCustomScheme_;
 	CEFBrowseWindow* cef_browse_window_;
+	int iWebViewId_;
 
-	typedef cocos2d::Vector<CEFWebViewWrapper*> WebViewList;
-	static WebViewList s_vec_webView_;
+	typedef CEFRegistry<CEFWebViewWrapper> WebViewRegistry;
+	static WebViewRegistry s_webViews_;
 	static WNDPROC	s_pCocosWndProc_;
 	static bool s_bExitApp_;
 	static int s_iWrapperCount_;
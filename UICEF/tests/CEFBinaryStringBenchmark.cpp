@@ -0,0 +1,112 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Conversions of binary payloads to and from the one byte per character
+// strings V8 holds them in, see CEFApp.cpp, before and after dropping the
+// intermediate buffers. std::u16string stands in for CefString and for the
+// V8 string, std::vector for CefBinaryValue; the copies CEF and V8 make
+// themselves are counted on both sides.
+
+typedef std::chrono::steady_clock Clock;
+typedef std::u16string Chars;
+typedef std::vector<unsigned char> Binary;
+
+static size_t s_sink = 0;
+
+// CefBinaryValue::Create copies.
+static Binary CreateBinary(const void* data, size_t size)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	return Binary(bytes, bytes + size);
+}
+
+// CefV8Value::CreateString copies.
+static void CreateV8String(const char16_t* chars, size_t size)
+{
+	Chars v8(chars, size);
+	s_sink += v8.size();
+}
+
+// String to binary, through a wide string and a vector.
+static Binary StringToBinaryBefore(const Chars& text)
+{
+	std::wstring chars(text.begin(), text.end());
+	std::vector<unsigned char> bytes(chars.size());
+	for (size_t i = 0; i < chars.size(); ++i)
+		bytes[i] = static_cast<unsigned char>(chars[i]);
+	return CreateBinary(&bytes[0], bytes.size());
+}
+
+// String to binary, narrowed from the characters of the string.
+static Binary StringToBinaryAfter(const Chars& text)
+{
+	const char16_t* chars = text.c_str();
+	std::string bytes(text.size(), '\0');
+	for (size_t i = 0; i < text.size(); ++i)
+		bytes[i] = static_cast<char>(chars[i]);
+	return CreateBinary(bytes.data(), bytes.size());
+}
+
+// Binary to string, through a vector, a wide string and a CefString copy.
+static void BinaryToStringBefore(const Binary& binary)
+{
+	std::vector<unsigned char> bytes(binary.size());
+	memcpy(&bytes[0], &binary[0], binary.size());
+	std::wstring chars(bytes.size(), L'\0');
+	for (size_t i = 0; i < bytes.size(); ++i)
+		chars[i] = bytes[i];
+	Chars text(chars.begin(), chars.end());
+	CreateV8String(text.data(), text.size());
+}
+
+// Binary to string, widened in place and referenced by the CefString.
+static void BinaryToStringAfter(const Binary& binary)
+{
+	Chars chars(binary.size(), u'\0');
+	unsigned char* bytes = reinterpret_cast<unsigned char*>(&chars[0]);
+	memcpy(bytes, &binary[0], binary.size());
+	for (size_t i = chars.size(); i-- > 0;)
+		chars[i] = bytes[i];
+	CreateV8String(chars.data(), chars.size());
+}
+
+template <typename Function>
+static double MegabytesPerSecond(size_t size, const Function& function)
+{
+	// Roughly 256 MB per measure.
+	int rounds = static_cast<int>(256 * 1024 * 1024 / size);
+	Clock::time_point start = Clock::now();
+	for (int i = 0; i < rounds; ++i)
+		function();
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	return rounds * (size / (1024.0 * 1024.0)) / seconds;
+}
+
+static void Run(size_t size)
+{
+	Chars text(size, u'\0');
+	for (size_t i = 0; i < size; ++i)
+		text[i] = static_cast<char16_t>(i * 31 & 0xff);
+	Binary binary = StringToBinaryAfter(text);
+	if (binary != StringToBinaryBefore(text))
+		printf("mismatch\n");
+
+	double to_binary_before = MegabytesPerSecond(size, [&text]() { s_sink += StringToBinaryBefore(text).size(); });
+	double to_binary_after = MegabytesPerSecond(size, [&text]() { s_sink += StringToBinaryAfter(text).size(); });
+	double to_string_before = MegabytesPerSecond(size, [&binary]() { BinaryToStringBefore(binary); });
+	double to_string_after = MegabytesPerSecond(size, [&binary]() { BinaryToStringAfter(binary); });
+
+	printf("%8u KB: postBinary %7.0f -> %7.0f MB/s, onBinaryMessage %7.0f -> %7.0f MB/s\n",
+		static_cast<unsigned int>(size / 1024), to_binary_before, to_binary_after, to_string_before, to_string_after);
+}
+
+int main()
+{
+	static const size_t kSizes[] = { 1024, 16 * 1024, 256 * 1024, 4 * 1024 * 1024, 16 * 1024 * 1024 };
+	for (size_t i = 0; i < sizeof(kSizes) / sizeof(kSizes[0]); ++i)
+		Run(kSizes[i]);
+	return s_sink == 0;
+}
@@ -0,0 +1,48 @@
+#include <memory>
+#include "CEFBrowserTable.h"
+#include "TestUtils.h"
+
+typedef CEFBrowserTable<std::shared_ptr<int> > Table;
+
+static void TestInsertFindRemove()
+{
+	Table table;
+	std::shared_ptr<int> a = std::make_shared<int>(1);
+	std::shared_ptr<int> b = std::make_shared<int>(2);
+
+	CHECK(!table.Find(1));
+	CHECK_EQ(a, table.Insert(1, a));
+	CHECK_EQ(b, table.Insert(40, b));
+	CHECK_EQ(a, table.Find(1));
+	CHECK_EQ(b, table.Find(40));
+	CHECK(!table.Find(2));
+	CHECK(!table.Find(1000));
+	CHECK_EQ(2u, table.Size());
+
+	// Replacing a value doesn't count it twice.
+	table.Insert(1, b);
+	CHECK_EQ(b, table.Find(1));
+	CHECK_EQ(2u, table.Size());
+
+	table.Remove(1);
+	table.Remove(1);
+	table.Remove(1000);
+	CHECK(!table.Find(1));
+	CHECK_EQ(1u, table.Size());
+}
+
+static void TestInvalidIds()
+{
+	Table table;
+	CHECK(!table.Find(0));
+	CHECK(!table.Find(-1));
+	table.Remove(-1);
+	CHECK_EQ(0u, table.Size());
+}
+
+int main()
+{
+	RUN_TEST(TestInsertFindRemove);
+	RUN_TEST(TestInvalidIds);
+	return 0;
+}
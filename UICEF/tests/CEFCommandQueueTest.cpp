@@ -0,0 +1,273 @@
+#include <string>
+#include <vector>
+#include "CEFCommandQueue.h"
+#include "TestUtils.h"
+
+// Records what is replayed on it as "<call>:<argument>".
+class StubTarget : public CEFCommandQueue::Target
+{
+public:
+	virtual void LoadURL(const std::string& url) override
+	{
+		calls_.push_back("LoadURL:" + url);
+	}
+
+	virtual void LoadString(const std::string& content, const std::string&) override
+	{
+		calls_.push_back("LoadString:" + content);
+	}
+
+	virtual void Reload() override
+	{
+		calls_.push_back("Reload:");
+	}
+
+	virtual void ExecuteJavaScript(const std::string& code, const std::string&, int tag) override
+	{
+		calls_.push_back("ExecuteJavaScript:" + code);
+		tags_.push_back(tag);
+	}
+
+	std::vector<std::string> calls_;
+	std::vector<int> tags_;
+};
+
+// Replay everything, letting each load commit right away.
+static std::vector<std::string> Replay(CEFCommandQueue& queue)
+{
+	StubTarget target;
+	queue.Replay(target);
+	while (queue.IsWaitingForLoad())
+	{
+		queue.ResumeAfterLoad(target);
+	}
+	CHECK(queue.IsEmpty());
+	return target.calls_;
+}
+
+static void TestEmpty()
+{
+	CEFCommandQueue queue;
+	CHECK(queue.IsEmpty());
+	CHECK(Replay(queue).empty());
+	CHECK_EQ(0u, queue.GetCollapsedCount());
+}
+
+static void TestLastLoadWins()
+{
+	CEFCommandQueue queue;
+	queue.LoadURL("a");
+	queue.LoadString("b", "");
+	queue.Reload();
+	queue.LoadURL("c");
+
+	std::vector<std::string> calls = Replay(queue);
+	CHECK_EQ(1u, calls.size());
+	CHECK_EQ(std::string("LoadURL:c"), calls[0]);
+	// a, b, the reload and nothing else.
+	CHECK_EQ(3u, queue.GetCollapsedCount());
+}
+
+static void TestReloadAfterLoadDropped()
+{
+	CEFCommandQueue queue;
+	queue.Reload();
+	queue.LoadURL("a");
+	queue.Reload();
+
+	std::vector<std::string> calls = Replay(queue);
+	CHECK_EQ(1u, calls.size());
+	CHECK_EQ(std::string("LoadURL:a"), calls[0]);
+	CHECK_EQ(2u, queue.GetCollapsedCount());
+}
+
+static void TestStopCancelsLoads()
+{
+	CEFCommandQueue queue;
+	queue.LoadURL("a");
+	queue.StopLoad();
+	CHECK(queue.IsEmpty());
+	CHECK_EQ(2u, queue.GetCollapsedCount());
+}
+
+static void TestScriptsKeepOrderAndEndRuns()
+{
+	CEFCommandQueue queue;
+	queue.LoadURL("a");
+	queue.ExecuteJavaScript("1", "");
+	queue.LoadURL("b");
+	queue.LoadURL("c");
+	queue.ExecuteJavaScript("2", "");
+	queue.Reload();
+
+	std::vector<std::string> calls = Replay(queue);
+	CHECK_EQ(5u, calls.size());
+	CHECK_EQ(std::string("LoadURL:a"), calls[0]);
+	CHECK_EQ(std::string("ExecuteJavaScript:1"), calls[1]);
+	CHECK_EQ(std::string("LoadURL:c"), calls[2]);
+	CHECK_EQ(std::string("ExecuteJavaScript:2"), calls[3]);
+	CHECK_EQ(std::string("Reload:"), calls[4]);
+}
+
+static void TestTakeInitialURL()
+{
+	CEFCommandQueue queue;
+	std::string url;
+	CHECK(!queue.TakeInitialURL(url));
+
+	// The collapsed load goes to CreateBrowser, the script is replayed.
+	queue.LoadURL("a");
+	queue.LoadURL("b");
+	queue.ExecuteJavaScript("1", "");
+	CHECK(queue.TakeInitialURL(url));
+	CHECK_EQ(std::string("b"), url);
+
+	// The script waits for b to commit.
+	StubTarget target;
+	CHECK(queue.IsWaitingForLoad());
+	queue.Replay(target);
+	CHECK(target.calls_.empty());
+
+	queue.ResumeAfterLoad(target);
+	CHECK_EQ(1u, target.calls_.size());
+	CHECK_EQ(std::string("ExecuteJavaScript:1"), target.calls_[0]);
+	CHECK(queue.IsEmpty());
+	CHECK(!queue.IsWaitingForLoad());
+}
+
+static void TestTakeInitialURLOnlyFromTheFront()
+{
+	CEFCommandQueue queue;
+	std::string url;
+
+	// A script first must run before the load.
+	queue.ExecuteJavaScript("1", "");
+	queue.LoadURL("a");
+	CHECK(!queue.TakeInitialURL(url));
+	CHECK_EQ(2u, queue.GetCommands().size());
+
+	// Strings can't be given to CreateBrowser.
+	queue.Clear();
+	queue.LoadString("b", "");
+	CHECK(!queue.TakeInitialURL(url));
+	CHECK_EQ(1u, queue.GetCommands().size());
+}
+
+static void TestScriptsWaitForTheLoadBeforeThem()
+{
+	CEFCommandQueue queue;
+	queue.ExecuteJavaScript("1", "");
+	queue.LoadURL("a");
+	queue.ExecuteJavaScript("2", "");
+	queue.LoadString("b", "");
+	queue.ExecuteJavaScript("3", "");
+
+	// The first script runs on the current document, the second waits for a.
+	StubTarget target;
+	queue.Replay(target);
+	CHECK_EQ(2u, target.calls_.size());
+	CHECK_EQ(std::string("ExecuteJavaScript:1"), target.calls_[0]);
+	CHECK_EQ(std::string("LoadURL:a"), target.calls_[1]);
+	CHECK(queue.IsWaitingForLoad());
+
+	// Commands issued meanwhile queue behind the held ones.
+	queue.ExecuteJavaScript("4", "");
+	queue.Replay(target);
+	CHECK_EQ(2u, target.calls_.size());
+
+	queue.ResumeAfterLoad(target);
+	CHECK_EQ(4u, target.calls_.size());
+	CHECK_EQ(std::string("ExecuteJavaScript:2"), target.calls_[2]);
+	CHECK_EQ(std::string("LoadString:b"), target.calls_[3]);
+	CHECK(queue.IsWaitingForLoad());
+
+	queue.ResumeAfterLoad(target);
+	CHECK_EQ(6u, target.calls_.size());
+	CHECK_EQ(std::string("ExecuteJavaScript:3"), target.calls_[4]);
+	CHECK_EQ(std::string("ExecuteJavaScript:4"), target.calls_[5]);
+	CHECK(queue.IsEmpty());
+	CHECK(!queue.IsWaitingForLoad());
+
+	// Nothing waits, a stray load start does nothing.
+	queue.ResumeAfterLoad(target);
+	CHECK_EQ(6u, target.calls_.size());
+}
+
+static void TestClearStopsWaiting()
+{
+	CEFCommandQueue queue;
+	std::string url;
+	queue.LoadURL("a");
+	queue.ExecuteJavaScript("1", "");
+	CHECK(queue.TakeInitialURL(url));
+	CHECK(queue.IsWaitingForLoad());
+
+	// A new browser starts from scratch.
+	queue.Clear();
+	CHECK(!queue.IsWaitingForLoad());
+	queue.ExecuteJavaScript("2", "");
+	std::vector<std::string> calls = Replay(queue);
+	CHECK_EQ(1u, calls.size());
+	CHECK_EQ(std::string("ExecuteJavaScript:2"), calls[0]);
+}
+
+static void TestScriptTags()
+{
+	CEFCommandQueue queue;
+	queue.ExecuteJavaScript("1", "");
+	queue.ExecuteJavaScript("2", "", 7);
+
+	StubTarget target;
+	queue.Replay(target);
+	CHECK_EQ(2u, target.tags_.size());
+	CHECK_EQ(0, target.tags_[0]);
+	CHECK_EQ(7, target.tags_[1]);
+}
+
+// A target queuing more commands while replaying gets them on the next replay.
+class RequeuingTarget : public StubTarget
+{
+public:
+	explicit RequeuingTarget(CEFCommandQueue* queue) : queue_(queue) {}
+
+	virtual void LoadURL(const std::string& url) override
+	{
+		StubTarget::LoadURL(url);
+		queue_->ExecuteJavaScript("again", "");
+	}
+
+private:
+	CEFCommandQueue* queue_;
+};
+
+static void TestReplayReentrant()
+{
+	CEFCommandQueue queue;
+	queue.LoadURL("a");
+
+	queue.ExecuteJavaScript("held", "");
+
+	// What the target queued goes behind what waits for the load.
+	RequeuingTarget target(&queue);
+	queue.Replay(target);
+	CHECK_EQ(1u, target.calls_.size());
+	CHECK_EQ(2u, queue.GetCommands().size());
+	CHECK_EQ(std::string("held"), queue.GetCommands()[0].content);
+	CHECK_EQ(std::string("again"), queue.GetCommands()[1].content);
+}
+
+int main()
+{
+	RUN_TEST(TestEmpty);
+	RUN_TEST(TestLastLoadWins);
+	RUN_TEST(TestReloadAfterLoadDropped);
+	RUN_TEST(TestStopCancelsLoads);
+	RUN_TEST(TestScriptsKeepOrderAndEndRuns);
+	RUN_TEST(TestTakeInitialURL);
+	RUN_TEST(TestTakeInitialURLOnlyFromTheFront);
+	RUN_TEST(TestScriptsWaitForTheLoadBeforeThem);
+	RUN_TEST(TestClearStopsWaiting);
+	RUN_TEST(TestScriptTags);
+	RUN_TEST(TestReplayReentrant);
+	return 0;
+}
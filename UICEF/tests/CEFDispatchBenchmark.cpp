@@ -0,0 +1,93 @@
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+#include "CEFBrowserTable.h"
+
+// Cost of handing a page event of a shared client handler to the owner of the
+// browser, by number of browsers. The previous path went through the window,
+// which forwarded each event to its own delegate; page events now go from the
+// route straight to the owner.
+
+typedef std::chrono::steady_clock Clock;
+
+static const int kEvents = 10000000;
+
+class PageDelegate
+{
+public:
+	virtual ~PageDelegate() {}
+	virtual void OnSetTitle(const std::string& title) = 0;
+};
+
+// The web view at the end of both paths.
+class Owner : public PageDelegate
+{
+public:
+	Owner() : count_(0) {}
+	virtual void OnSetTitle(const std::string& title) { count_ += title.size(); }
+	size_t count_;
+};
+
+// The window in the middle of the previous path.
+class Window : public PageDelegate
+{
+public:
+	explicit Window(PageDelegate* delegate) : delegate_(delegate) {}
+	virtual void OnSetTitle(const std::string& title) { delegate_->OnSetTitle(title); }
+	PageDelegate* delegate_;
+};
+
+struct Route
+{
+	PageDelegate* page_delegate_;
+};
+
+// Dispatches |kEvents| events over the browsers, returns ns per event.
+static double Dispatch(const CEFBrowserTable<std::shared_ptr<Route> >& routes, int browsers)
+{
+	const std::string title("title");
+	Clock::time_point start = Clock::now();
+	for (int i = 0; i < kEvents; ++i)
+	{
+		const std::shared_ptr<Route>& route = routes.Find(1 + i % browsers);
+		if (route && route->page_delegate_)
+			route->page_delegate_->OnSetTitle(title);
+	}
+	return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / kEvents;
+}
+
+static void Run(int browsers)
+{
+	std::vector<std::unique_ptr<Owner> > owners;
+	std::vector<std::unique_ptr<Window> > windows;
+	CEFBrowserTable<std::shared_ptr<Route> > via_window;
+	CEFBrowserTable<std::shared_ptr<Route> > direct;
+
+	for (int i = 0; i < browsers; ++i)
+	{
+		owners.push_back(std::unique_ptr<Owner>(new Owner()));
+		windows.push_back(std::unique_ptr<Window>(new Window(owners.back().get())));
+
+		std::shared_ptr<Route> route = std::make_shared<Route>();
+		route->page_delegate_ = windows.back().get();
+		via_window.Insert(i + 1, route);
+
+		route = std::make_shared<Route>();
+		route->page_delegate_ = owners.back().get();
+		direct.Insert(i + 1, route);
+	}
+
+	double window_ns = Dispatch(via_window, browsers);
+	double direct_ns = Dispatch(direct, browsers);
+	printf("%3d browsers: through the window %.2f ns/event, direct %.2f ns/event\n", browsers, window_ns, direct_ns);
+}
+
+int main()
+{
+	Run(1);
+	Run(10);
+	Run(100);
+	return 0;
+}
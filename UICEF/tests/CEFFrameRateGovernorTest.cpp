@@ -0,0 +1,196 @@
+#include "CEFFrameRateGovernor.h"
+#include "TestUtils.h"
+
+// The governor with a clock the test moves by hand, default policy: 60 fps,
+// 15 when small, 30 unfocused, 10 after 2 s without a paint, lowering after
+// 1 s.
+class FakeClock
+{
+public:
+	FakeClock() : now_(100.0) {}
+
+	double Now() const { return now_; }
+	void Advance(double seconds) { now_ += seconds; }
+
+	CEFFrameRateGovernor::Clock AsClock() { return [this]() { return now_; }; }
+
+private:
+	double now_;
+};
+
+// Keep painting so idleness does not get in the way.
+static int UpdateAfter(CEFFrameRateGovernor& governor, FakeClock& clock, double seconds)
+{
+	clock.Advance(seconds);
+	governor.OnPaint();
+	return governor.Update();
+}
+
+static void TestDefaults()
+{
+	FakeClock clock;
+	CEFFrameRateGovernor governor(clock.AsClock());
+	CHECK_EQ(60, governor.GetFrameRate());
+	CHECK_EQ(60, governor.Update());
+}
+
+// Hiding applies at once and so does showing again.
+static void TestHidden()
+{
+	FakeClock clock;
+	CEFFrameRateGovernor governor(clock.AsClock());
+
+	governor.SetVisible(false);
+	CHECK_EQ(0, governor.GetWantedFrameRate());
+	CHECK_EQ(0, governor.Update());
+
+	governor.SetVisible(true);
+	CHECK_EQ(60, governor.Update());
+
+	// Off screen counts as hidden.
+	governor.SetScreenCoverage(0.0f);
+	CHECK_EQ(0, governor.Update());
+	governor.SetScreenCoverage(1.0f);
+	CHECK_EQ(60, governor.Update());
+}
+
+// Lowering waits for the delay, raising does not.
+static void TestSmall()
+{
+	FakeClock clock;
+	CEFFrameRateGovernor governor(clock.AsClock());
+
+	governor.SetScreenCoverage(0.05f);
+	CHECK_EQ(15, governor.GetWantedFrameRate());
+	CHECK_EQ(60, UpdateAfter(governor, clock, 0.0));
+	CHECK_EQ(60, UpdateAfter(governor, clock, 0.5));
+	CHECK_EQ(15, UpdateAfter(governor, clock, 0.5));
+
+	governor.SetScreenCoverage(0.5f);
+	CHECK_EQ(60, UpdateAfter(governor, clock, 0.0));
+}
+
+static void TestUnfocused()
+{
+	FakeClock clock;
+	CEFFrameRateGovernor governor(clock.AsClock());
+
+	governor.SetFocused(false);
+	CHECK_EQ(30, governor.GetWantedFrameRate());
+	CHECK_EQ(60, UpdateAfter(governor, clock, 0.0));
+	CHECK_EQ(30, UpdateAfter(governor, clock, 1.0));
+
+	// Small and unfocused, the lower rate wins.
+	governor.SetScreenCoverage(0.05f);
+	CHECK_EQ(30, UpdateAfter(governor, clock, 0.0));
+	CHECK_EQ(15, UpdateAfter(governor, clock, 1.0));
+
+	governor.SetFocused(true);
+	governor.SetScreenCoverage(1.0f);
+	CHECK_EQ(60, UpdateAfter(governor, clock, 0.0));
+}
+
+// Without paints the rate decays to the idle rate, a paint restores it.
+static void TestIdleDecay()
+{
+	FakeClock clock;
+	CEFFrameRateGovernor governor(clock.AsClock());
+
+	clock.Advance(1.9);
+	CHECK_EQ(60, governor.Update());
+
+	// Idle from 2 s, lowered 1 s later.
+	clock.Advance(0.1);
+	CHECK_EQ(10, governor.GetWantedFrameRate());
+	CHECK_EQ(60, governor.Update());
+	clock.Advance(0.9);
+	CHECK_EQ(60, governor.Update());
+	clock.Advance(0.1);
+	CHECK_EQ(10, governor.Update());
+
+	governor.OnPaint();
+	CHECK_EQ(60, governor.Update());
+}
+
+// A lower rate wanted only briefly never applies, and the delay restarts.
+static void TestNoFlapping()
+{
+	FakeClock clock;
+	CEFFrameRateGovernor governor(clock.AsClock());
+
+	governor.SetFocused(false);
+	CHECK_EQ(60, UpdateAfter(governor, clock, 0.0));
+	CHECK_EQ(60, UpdateAfter(governor, clock, 0.6));
+	governor.SetFocused(true);
+	CHECK_EQ(60, UpdateAfter(governor, clock, 0.1));
+
+	governor.SetFocused(false);
+	CHECK_EQ(60, UpdateAfter(governor, clock, 0.0));
+	CHECK_EQ(60, UpdateAfter(governor, clock, 0.6));
+	CHECK_EQ(30, UpdateAfter(governor, clock, 0.4));
+}
+
+// From one lower rate to another lower still, through the delay again.
+static void TestTransitions()
+{
+	FakeClock clock;
+	CEFFrameRateGovernor governor(clock.AsClock());
+
+	governor.SetFocused(false);
+	UpdateAfter(governor, clock, 0.0);
+	CHECK_EQ(30, UpdateAfter(governor, clock, 1.0));
+
+	governor.SetScreenCoverage(0.05f);
+	CHECK_EQ(30, UpdateAfter(governor, clock, 0.0));
+	CHECK_EQ(15, UpdateAfter(governor, clock, 1.0));
+
+	// Idle on top: 10, then hidden at once, then shown back at the idle rate.
+	clock.Advance(2.0);
+	CHECK_EQ(15, governor.Update());
+	clock.Advance(1.0);
+	CHECK_EQ(10, governor.Update());
+
+	governor.SetVisible(false);
+	CHECK_EQ(0, governor.Update());
+	governor.SetVisible(true);
+	CHECK_EQ(10, governor.Update());
+
+	// Everything back, 60 at once.
+	governor.SetFocused(true);
+	governor.SetScreenCoverage(1.0f);
+	CHECK_EQ(60, UpdateAfter(governor, clock, 0.0));
+}
+
+static void TestPolicy()
+{
+	FakeClock clock;
+	CEFFrameRateGovernor governor(clock.AsClock());
+
+	CEFFrameRateGovernor::Policy policy;
+	policy.max_fps = 30;
+	policy.unfocused_fps = 20;
+	policy.lower_delay = 0.0;
+	governor.SetPolicy(policy);
+
+	// Without a delay lowering applies at once too.
+	CHECK_EQ(30, governor.Update());
+	governor.SetFocused(false);
+	CHECK_EQ(20, UpdateAfter(governor, clock, 0.0));
+
+	// Coverage is clamped to 0 to 1.
+	governor.SetScreenCoverage(2.0f);
+	CHECK_EQ(20, governor.GetWantedFrameRate());
+}
+
+int main()
+{
+	RUN_TEST(TestDefaults);
+	RUN_TEST(TestHidden);
+	RUN_TEST(TestSmall);
+	RUN_TEST(TestUnfocused);
+	RUN_TEST(TestIdleDecay);
+	RUN_TEST(TestNoFlapping);
+	RUN_TEST(TestTransitions);
+	RUN_TEST(TestPolicy);
+	return 0;
+}
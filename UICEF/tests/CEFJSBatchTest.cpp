@@ -0,0 +1,65 @@
+#include <string>
+#include "CEFJSBatch.h"
+#include "TestUtils.h"
+
+static std::string ToJSON(const std::string& text)
+{
+	std::string out;
+	CEFJSBatch::AppendJSONString(out, text);
+	return out;
+}
+
+static void TestEscaping()
+{
+	CHECK_EQ(std::string("\"plain\""), ToJSON("plain"));
+	CHECK_EQ(std::string("\"a\\\"b\\\\c\""), ToJSON("a\"b\\c"));
+	CHECK_EQ(std::string("\"\\n\\r\\t\\b\\f\""), ToJSON("\n\r\t\b\f"));
+	CHECK_EQ(std::string("\"\\u0001\\u001f\""), ToJSON("\x01\x1f"));
+	CHECK_EQ(std::string("\"\\u0000\""), ToJSON(std::string(1, '\0')));
+
+	// Other UTF-8 passes through, U+2028 and U+2029 don't.
+	CHECK_EQ(std::string("\"\xc3\xa9\xe2\x82\xac\""), ToJSON("\xc3\xa9\xe2\x82\xac"));
+	CHECK_EQ(std::string("\"a\\u2028b\\u2029\""), ToJSON("a\xe2\x80\xa8" "b\xe2\x80\xa9"));
+	CHECK_EQ(std::string("\"\xe2\x80\""), ToJSON("\xe2\x80"));
+}
+
+static void TestLoneScriptAsIs()
+{
+	CEFJSBatch batch;
+	CHECK(batch.IsEmpty());
+	batch.Add("let x = 1;");
+	CHECK_EQ(1u, batch.GetCount());
+	CHECK_EQ(std::string("let x = 1;"), batch.Take());
+	CHECK(batch.IsEmpty());
+}
+
+static void TestBatch()
+{
+	CEFJSBatch batch;
+	batch.Add("let x = 1;");
+	batch.Add("f(\"y\")");
+	CHECK_EQ(2u, batch.GetCount());
+
+	std::string script = batch.Take();
+	CHECK(batch.IsEmpty());
+	CHECK(script.find("[\"let x = 1;\",\"f(\\\"y\\\")\"]") != std::string::npos);
+	CHECK(script.find("(0,eval)") != std::string::npos);
+
+	// The next batch starts empty.
+	batch.Add("a");
+	batch.Add("b");
+	script = batch.Take();
+	CHECK(script.find("[\"a\",\"b\"]") != std::string::npos);
+
+	batch.Add("c");
+	batch.Clear();
+	CHECK(batch.IsEmpty());
+}
+
+int main()
+{
+	RUN_TEST(TestEscaping);
+	RUN_TEST(TestLoneScriptAsIs);
+	RUN_TEST(TestBatch);
+	return 0;
+}
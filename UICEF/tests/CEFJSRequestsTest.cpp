@@ -0,0 +1,261 @@
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include "CEFJSRequests.h"
+#include "TestUtils.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static std::string Query(int id, const std::string& token, const std::string& status, const std::string& result)
+{
+	return CEFJSRequests::kQueryPrefix + std::to_string(id) + ":" + token + ":" + status + ":" + result;
+}
+
+// Parses the queries and settles the requests, like CEFClientHandler::OnQuery
+// and the web view do on their threads.
+static bool Dispatch(CEFJSRequests& requests, const std::string& query)
+{
+	bool is_valid = false;
+	int id = 0;
+	std::string token, result;
+	bool success = false;
+	if (!CEFJSRequests::ParseQuery(query, is_valid, id, token, success, result) || !is_valid)
+		return false;
+
+	CEFJSRequests::Callback callback;
+	if (!requests.Take(id, &token, callback))
+		return false;
+	if (callback)
+		callback(success, result);
+	return true;
+}
+
+static void TestParseQuery()
+{
+	bool is_valid = false, success = false;
+	int id = 0;
+	std::string token, result;
+
+	CHECK(!CEFJSRequests::ParseQuery("other", is_valid, id, token, success, result));
+	CHECK(CEFJSRequests::ParseQuery("cocos-result:1:abc", is_valid, id, token, success, result));
+	CHECK(!is_valid);
+	CHECK(CEFJSRequests::ParseQuery("cocos-result::abc:ok:1", is_valid, id, token, success, result));
+	CHECK(!is_valid);
+
+	// The result may hold colons.
+	CHECK(CEFJSRequests::ParseQuery("cocos-result:12:abc:ok:{\"a\":1}", is_valid, id, token, success, result));
+	CHECK(is_valid);
+	CHECK_EQ(12, id);
+	CHECK_EQ(std::string("abc"), token);
+	CHECK(success);
+	CHECK_EQ(std::string("{\"a\":1}"), result);
+
+	CHECK(CEFJSRequests::ParseQuery("cocos-result:3:abc:error:", is_valid, id, token, success, result));
+	CHECK(is_valid);
+	CHECK(!success);
+	CHECK(result.empty());
+}
+
+static void TestTokens()
+{
+	CEFJSRequests requests;
+	std::set<std::string> tokens;
+	for (int i = 0; i < 1000; ++i)
+	{
+		std::string token;
+		requests.Add(nullptr, token);
+		CHECK_EQ(16u, token.size());
+		tokens.insert(token);
+	}
+	CHECK_EQ(1000u, tokens.size());
+
+	// Another web view doesn't draw the same tokens.
+	CEFJSRequests other;
+	std::string token;
+	other.Add(nullptr, token);
+	CHECK(tokens.find(token) == tokens.end());
+}
+
+static void TestForgedAnswers()
+{
+	CEFJSRequests requests;
+	int calls = 0;
+	std::string token;
+	int id = requests.Add([&calls](bool success, const std::string& result) {
+		CHECK(success);
+		CHECK_EQ(std::string("1"), result);
+		++calls;
+	}, token);
+
+	// A script guessing the ID, and the next IDs.
+	CHECK(!Dispatch(requests, Query(id, "0000000000000000", "ok", "1")));
+	CHECK(!Dispatch(requests, Query(id, "", "ok", "1")));
+	CHECK(!Dispatch(requests, Query(id + 1, token, "ok", "1")));
+	CHECK_EQ(0, calls);
+
+	CHECK(Dispatch(requests, Query(id, token, "ok", "1")));
+	CHECK_EQ(1, calls);
+
+	// Settled once.
+	CHECK(!Dispatch(requests, Query(id, token, "ok", "1")));
+	CHECK_EQ(1, calls);
+	CHECK(requests.IsEmpty());
+}
+
+static void TestTakeAll()
+{
+	CEFJSRequests requests;
+	std::string token;
+	requests.Add(nullptr, token);
+	requests.Add(nullptr, token);
+
+	std::vector<CEFJSRequests::Request> taken;
+	requests.TakeAll(taken);
+	CHECK_EQ(2u, taken.size());
+	CHECK(requests.IsEmpty());
+
+	// Requests left behind by a navigation can't be answered any more.
+	CHECK(!Dispatch(requests, Query(taken[0].id, taken[0].token, "ok", "1")));
+
+	CEFJSRequests::Callback callback;
+	CHECK(!requests.Take(taken[1].id, NULL, callback));
+}
+
+static void TestHeldRequests()
+{
+	CEFJSRequests requests;
+	std::string sent_token;
+	std::string held_token;
+	int sent = requests.Add(nullptr, sent_token);
+	int held = requests.Add(nullptr, held_token, true);
+
+	// A load leaves the held request for the page it waits for.
+	std::vector<CEFJSRequests::Request> taken;
+	requests.TakeAll(taken, false);
+	CHECK_EQ(1u, taken.size());
+	CHECK_EQ(sent, taken[0].id);
+	CHECK(!requests.IsEmpty());
+
+	// Once its script is sent the next load takes it.
+	requests.MarkSent(held);
+	taken.clear();
+	requests.TakeAll(taken, false);
+	CHECK_EQ(1u, taken.size());
+	CHECK_EQ(held, taken[0].id);
+	CHECK(requests.IsEmpty());
+
+	// Closing takes the held ones too.
+	requests.Add(nullptr, held_token, true);
+	taken.clear();
+	requests.TakeAll(taken);
+	CHECK_EQ(1u, taken.size());
+	CHECK(requests.IsEmpty());
+}
+
+// Stands in for the page and the router: answers each request on its own
+// thread with the query the result script would make.
+class StubRouter
+{
+public:
+	StubRouter() : is_stopping_(false), thread_(&StubRouter::Run, this) {}
+
+	~StubRouter()
+	{
+		{
+			std::lock_guard<std::mutex> lock(lock_);
+			is_stopping_ = true;
+		}
+		cond_.notify_all();
+		thread_.join();
+	}
+
+	// What the script of the request sends.
+	void Evaluate(int id, const std::string& token)
+	{
+		{
+			std::lock_guard<std::mutex> lock(lock_);
+			scripts_.push_back(Query(id, token, "ok", "42"));
+		}
+		cond_.notify_all();
+	}
+
+	// The answers, on the test thread.
+	bool WaitForQuery(std::string& query)
+	{
+		std::unique_lock<std::mutex> lock(lock_);
+		if (!cond_.wait_for(lock, std::chrono::seconds(5), [this]() { return !queries_.empty(); }))
+			return false;
+		query = queries_.front();
+		queries_.erase(queries_.begin());
+		return true;
+	}
+
+private:
+	void Run()
+	{
+		std::unique_lock<std::mutex> lock(lock_);
+		while (true)
+		{
+			cond_.wait(lock, [this]() { return is_stopping_ || !scripts_.empty(); });
+			if (scripts_.empty())
+				return;
+			queries_.push_back(scripts_.front());
+			scripts_.erase(scripts_.begin());
+			cond_.notify_all();
+		}
+	}
+
+	std::mutex lock_;
+	std::condition_variable cond_;
+	std::vector<std::string> scripts_;
+	std::vector<std::string> queries_;
+	bool is_stopping_;
+	std::thread thread_;
+};
+
+static void TestLatency()
+{
+	static const int kRequests = 2000;
+
+	CEFJSRequests requests;
+	StubRouter router;
+	std::vector<double> latencies;
+
+	for (int i = 0; i < kRequests; ++i)
+	{
+		Clock::time_point start = Clock::now();
+		bool answered = false;
+		std::string token;
+		int id = requests.Add([&answered](bool success, const std::string& result) {
+			answered = success && result == "42";
+		}, token);
+		router.Evaluate(id, token);
+
+		std::string query;
+		CHECK(router.WaitForQuery(query));
+		CHECK(Dispatch(requests, query));
+		CHECK(answered);
+		latencies.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+	}
+
+	std::sort(latencies.begin(), latencies.end());
+	printf("  round trip through the stub router: p50 %.1f us, p99 %.1f us\n",
+		latencies[latencies.size() / 2], latencies[latencies.size() * 99 / 100]);
+	CHECK(requests.IsEmpty());
+}
+
+int main()
+{
+	RUN_TEST(TestParseQuery);
+	RUN_TEST(TestTokens);
+	RUN_TEST(TestForgedAnswers);
+	RUN_TEST(TestTakeAll);
+	RUN_TEST(TestHeldRequests);
+	RUN_TEST(TestLatency);
+	return 0;
+}
@@ -0,0 +1,99 @@
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "CEFMPSCQueue.h"
+#include "TestUtils.h"
+
+// Producer index in the high bits, sequence number in the low ones.
+static const int kSequenceBits = 32;
+
+static void TestSingleThread()
+{
+	CEFMPSCQueue<int> queue(3);
+	CHECK_EQ(4u, queue.Capacity());
+
+	int value = 0;
+	CHECK(!queue.TryPop(value));
+	for (int i = 0; i < 4; ++i)
+		CHECK(queue.TryPush(int(i)));
+	CHECK(!queue.TryPush(4));
+
+	for (int i = 0; i < 4; ++i)
+	{
+		CHECK(queue.TryPop(value));
+		CHECK_EQ(i, value);
+	}
+	CHECK(!queue.TryPop(value));
+}
+
+// Producers spin on a full queue like CEFManager::postToCocosThread. Every
+// item arrives once, in the order of its producer.
+static void StressProducers(int producer_count, uint64_t per_producer, size_t capacity)
+{
+	CEFMPSCQueue<uint64_t> queue(capacity);
+	std::atomic<bool> go(false);
+
+	std::vector<std::thread> producers;
+	for (int p = 0; p < producer_count; ++p)
+	{
+		producers.push_back(std::thread([&queue, &go, p, per_producer]() {
+			while (!go)
+				std::this_thread::yield();
+			for (uint64_t i = 0; i < per_producer; ++i)
+			{
+				uint64_t item = (static_cast<uint64_t>(p) << kSequenceBits) | i;
+				while (!queue.TryPush(uint64_t(item)))
+					std::this_thread::yield();
+			}
+		}));
+	}
+
+	std::vector<uint64_t> next(producer_count, 0);
+	uint64_t total = producer_count * per_producer;
+	uint64_t received = 0;
+	go = true;
+	while (received < total)
+	{
+		uint64_t item;
+		if (!queue.TryPop(item))
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		int p = static_cast<int>(item >> kSequenceBits);
+		uint64_t sequence = item & ((uint64_t(1) << kSequenceBits) - 1);
+		CHECK(p >= 0 && p < producer_count);
+		CHECK_EQ(next[p], sequence);
+		++next[p];
+		++received;
+	}
+
+	for (size_t i = 0; i < producers.size(); ++i)
+		producers[i].join();
+
+	uint64_t item;
+	CHECK(!queue.TryPop(item));
+	for (int p = 0; p < producer_count; ++p)
+		CHECK_EQ(per_producer, next[p]);
+}
+
+static void TestStressSmallQueue()
+{
+	// Full most of the time.
+	StressProducers(4, 100000, 4);
+}
+
+static void TestStressLargeQueue()
+{
+	StressProducers(8, 50000, 1024);
+}
+
+int main()
+{
+	RUN_TEST(TestSingleThread);
+	RUN_TEST(TestStressSmallQueue);
+	RUN_TEST(TestStressLargeQueue);
+	return 0;
+}
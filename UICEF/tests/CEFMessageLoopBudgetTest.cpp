@@ -0,0 +1,210 @@
+#include <functional>
+#include "CEFMessageLoopBudget.h"
+#include "TestUtils.h"
+
+static const float kBudgetMs = 4.0f;
+
+// Stands in for CefDoMessageLoopWork, advances the fake clock by what the call
+// costs and asks for more work |requests| times, as the pump thread would
+// while the cocos thread is busy.
+class StubLoopWork
+{
+public:
+	StubLoopWork(CEFMessageLoopBudget& budget, double& now)
+		: budget_(budget), now_(now), cost_ms_(1.0), requests_(0), calls_(0) {}
+
+	void SetCost(double cost_ms) { cost_ms_ = cost_ms; }
+	void SetRequests(int requests) { requests_ = requests; }
+	int GetCalls() const { return calls_; }
+
+	void Run()
+	{
+		++calls_;
+		now_ += cost_ms_;
+		if (requests_ > 0)
+		{
+			--requests_;
+			budget_.Request();
+		}
+	}
+
+	std::function<void()> AsFunction() { return std::bind(&StubLoopWork::Run, this); }
+
+private:
+	CEFMessageLoopBudget& budget_;
+	double& now_;
+	double cost_ms_;
+	int requests_;
+	int calls_;
+};
+
+// One run stays queued however often the pump asks.
+static void TestPostsAreCoalesced()
+{
+	double now = 0.0;
+	CEFMessageLoopBudget budget(kBudgetMs, [&now]() { return now; });
+
+	budget.Request();
+	CHECK(budget.TryPost());
+	for (int i = 0; i < 5; ++i)
+	{
+		budget.Request();
+		CHECK(!budget.TryPost());
+	}
+	CHECK_EQ(5u, budget.GetCoalescedCount());
+
+	// The queued run does the merged work once.
+	StubLoopWork work(budget, now);
+	budget.OnPostRun();
+	CHECK(budget.Run(1, work.AsFunction()));
+	CHECK_EQ(1, work.GetCalls());
+	CHECK(!budget.HasPendingWork());
+
+	// Once it ran the next request posts again.
+	budget.Request();
+	CHECK(budget.TryPost());
+	CHECK_EQ(5u, budget.GetCoalescedCount());
+}
+
+// Work requested while a posted run is busy is done in the same run until the
+// budget is spent.
+static void TestPostedRunDefers()
+{
+	double now = 0.0;
+	CEFMessageLoopBudget budget(kBudgetMs, [&now]() { return now; });
+	StubLoopWork work(budget, now);
+	work.SetCost(2.5);
+	work.SetRequests(10);
+
+	budget.Request();
+	CHECK(budget.TryPost());
+	budget.OnPostRun();
+	CHECK(!budget.Run(1, work.AsFunction()));
+
+	// Room is left after 2.5 ms, none after 5 ms.
+	CHECK_EQ(2, work.GetCalls());
+	CHECK_EQ(1u, budget.GetDeferredCount());
+	CHECK(budget.HasPendingWork());
+}
+
+// The first call of a frame runs even when it alone is over the budget.
+static void TestFirstCallAlwaysRuns()
+{
+	double now = 0.0;
+	CEFMessageLoopBudget budget(kBudgetMs, [&now]() { return now; });
+	StubLoopWork work(budget, now);
+	work.SetCost(10.0);
+	work.SetRequests(1);
+
+	budget.Request();
+	CHECK(!budget.Run(1, work.AsFunction()));
+	CHECK_EQ(1, work.GetCalls());
+	CHECK_EQ(1u, budget.GetDeferredCount());
+}
+
+// Nothing requested, nothing run.
+static void TestNothingPending()
+{
+	double now = 0.0;
+	CEFMessageLoopBudget budget(kBudgetMs, [&now]() { return now; });
+	StubLoopWork work(budget, now);
+
+	CHECK(budget.Run(1, work.AsFunction()));
+	CHECK_EQ(0, work.GetCalls());
+
+	budget.Request();
+	CHECK(budget.CancelPending());
+	CHECK(budget.Run(1, work.AsFunction()));
+	CHECK_EQ(0, work.GetCalls());
+}
+
+// After draw: what did not fit in a frame runs at the start of the next one.
+static void TestCarriedOverToNextFrame()
+{
+	double now = 0.0;
+	CEFMessageLoopBudget budget(kBudgetMs, [&now]() { return now; });
+	StubLoopWork work(budget, now);
+	work.SetCost(3.0);
+	work.SetRequests(4);
+
+	budget.Request();
+	CHECK(!budget.Run(1, work.AsFunction()));
+	CHECK_EQ(2, work.GetCalls());
+	CHECK(budget.HasPendingWork());
+
+	// Another call in the same frame stays deferred.
+	CHECK(!budget.Run(1, work.AsFunction()));
+	CHECK_EQ(2, work.GetCalls());
+	CHECK_EQ(2u, budget.GetDeferredCount());
+
+	CHECK(!budget.Run(2, work.AsFunction()));
+	CHECK_EQ(4, work.GetCalls());
+
+	// No more requests, the last call finishes the work.
+	CHECK(budget.Run(3, work.AsFunction()));
+	CHECK_EQ(5, work.GetCalls());
+	CHECK(!budget.HasPendingWork());
+	CHECK_EQ(3u, budget.GetDeferredCount());
+}
+
+static void TestFrameStats()
+{
+	double now = 0.0;
+	CEFMessageLoopBudget budget(kBudgetMs, [&now]() { return now; });
+	StubLoopWork work(budget, now);
+
+	// Frame 1: 1 ms then 2 ms.
+	budget.Request();
+	CHECK(budget.Run(1, work.AsFunction()));
+	work.SetCost(2.0);
+	budget.Request();
+	CHECK(budget.Run(1, work.AsFunction()));
+
+	// The stats of a frame are published when the next one starts.
+	CHECK_EQ(0, budget.GetLastFrameStats().calls);
+
+	// Frame 2: 6 ms, then a deferred call.
+	work.SetCost(6.0);
+	work.SetRequests(1);
+	budget.Request();
+	CHECK(!budget.Run(2, work.AsFunction()));
+
+	const CEFMessageLoopBudget::FrameStats& first = budget.GetLastFrameStats();
+	CHECK_EQ(1u, first.frame);
+	CHECK_EQ(2, first.calls);
+	CHECK_EQ(0, first.deferred);
+	CHECK_EQ(3.0f, first.total_ms);
+	CHECK_EQ(2.0f, first.worst_call_ms);
+
+	// Frame 3 runs what frame 2 deferred.
+	work.SetCost(1.0);
+	CHECK(budget.Run(3, work.AsFunction()));
+
+	const CEFMessageLoopBudget::FrameStats& second = budget.GetLastFrameStats();
+	CHECK_EQ(2u, second.frame);
+	CHECK_EQ(1, second.calls);
+	CHECK_EQ(1, second.deferred);
+	CHECK_EQ(6.0f, second.total_ms);
+	CHECK_EQ(6.0f, second.worst_call_ms);
+
+	// Frame 4 closes frame 3, the worst frame stays frame 2.
+	CHECK(budget.Run(4, work.AsFunction()));
+	CHECK_EQ(3u, budget.GetLastFrameStats().frame);
+	CHECK_EQ(1.0f, budget.GetLastFrameStats().total_ms);
+	CHECK_EQ(2u, budget.GetWorstFrameStats().frame);
+
+	budget.ResetStats();
+	CHECK_EQ(0, budget.GetLastFrameStats().calls);
+	CHECK_EQ(0.0f, budget.GetWorstFrameStats().total_ms);
+}
+
+int main()
+{
+	RUN_TEST(TestPostsAreCoalesced);
+	RUN_TEST(TestPostedRunDefers);
+	RUN_TEST(TestFirstCallAlwaysRuns);
+	RUN_TEST(TestNothingPending);
+	RUN_TEST(TestCarriedOverToNextFrame);
+	RUN_TEST(TestFrameStats);
+	return 0;
+}
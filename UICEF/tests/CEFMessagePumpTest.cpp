@@ -0,0 +1,179 @@
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "CEFMessagePump.h"
+#include "TestUtils.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static const int kMinDelayMs = 10;
+static const int kMaxDelayMs = 100;
+
+// Stands in for CefDoMessageLoopWork, records when the pump ran it.
+class StubWorkSource
+{
+public:
+	StubWorkSource() : stop_after_(-1) {}
+
+	bool Dispatch()
+	{
+		std::lock_guard<std::mutex> lock(lock_);
+		times_.push_back(Clock::now());
+		return stop_after_ < 0 || static_cast<int>(times_.size()) < stop_after_;
+	}
+
+	void StopAfter(int count)
+	{
+		std::lock_guard<std::mutex> lock(lock_);
+		stop_after_ = count;
+	}
+
+	size_t GetCount()
+	{
+		std::lock_guard<std::mutex> lock(lock_);
+		return times_.size();
+	}
+
+	std::vector<Clock::time_point> GetTimesSince(const Clock::time_point& start)
+	{
+		std::lock_guard<std::mutex> lock(lock_);
+		std::vector<Clock::time_point> times;
+		for (size_t i = 0; i < times_.size(); ++i)
+		{
+			if (times_[i] >= start)
+				times.push_back(times_[i]);
+		}
+		return times;
+	}
+
+	// Wait until the pump ran after |start|, returns how long it took.
+	double WaitForDispatchMs(const Clock::time_point& start, int timeout_ms)
+	{
+		Clock::time_point deadline = start + std::chrono::milliseconds(timeout_ms);
+		while (Clock::now() < deadline)
+		{
+			std::vector<Clock::time_point> times = GetTimesSince(start);
+			if (!times.empty())
+				return std::chrono::duration<double, std::milli>(times.front() - start).count();
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		return timeout_ms;
+	}
+
+private:
+	std::mutex lock_;
+	std::vector<Clock::time_point> times_;
+	int stop_after_;
+};
+
+static double MaxGapMs(const std::vector<Clock::time_point>& times)
+{
+	double gap = 0.0;
+	for (size_t i = 1; i < times.size(); ++i)
+		gap = std::max(gap, std::chrono::duration<double, std::milli>(times[i] - times[i - 1]).count());
+	return gap;
+}
+
+static void TestIdleBacksOff()
+{
+	StubWorkSource source;
+	CEFMessagePump pump([&source]() { return source.Dispatch(); }, kMinDelayMs, kMaxDelayMs);
+	pump.Start();
+
+	// 10 + 20 + 40 + 80 ms, then every 100 ms: about a dozen in a second
+	// rather than a hundred.
+	std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+	size_t count = source.GetCount();
+	printf("  idle: %u dispatches, %u wakeups in 1 s\n", static_cast<unsigned int>(count),
+		static_cast<unsigned int>(pump.GetWakeupCount()));
+	CHECK(count >= 5);
+	CHECK(count <= 25);
+
+	pump.Stop();
+}
+
+static void TestScheduleWorkIsPrompt()
+{
+	StubWorkSource source;
+	CEFMessagePump pump([&source]() { return source.Dispatch(); }, kMinDelayMs, kMaxDelayMs);
+	pump.Start();
+
+	// Reach the longest interval first.
+	std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+	std::vector<double> latencies;
+	for (int i = 0; i < 20; ++i)
+	{
+		Clock::time_point start = Clock::now();
+		pump.ScheduleWork(0);
+		latencies.push_back(source.WaitForDispatchMs(start, 1000));
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	}
+
+	std::sort(latencies.begin(), latencies.end());
+	printf("  ScheduleWork(0) latency: p50 %.2f ms, max %.2f ms\n", latencies[latencies.size() / 2], latencies.back());
+	CHECK(latencies[latencies.size() / 2] < kMaxDelayMs / 2);
+
+	pump.Stop();
+}
+
+static void TestBusyKeepsMinInterval()
+{
+	StubWorkSource source;
+	CEFMessagePump pump([&source]() { return source.Dispatch(); }, kMinDelayMs, kMaxDelayMs);
+	pump.Start();
+
+	// Back off, then a browser comes on screen.
+	std::this_thread::sleep_for(std::chrono::milliseconds(500));
+	Clock::time_point start = Clock::now();
+	pump.SetBusy(true);
+
+	// The backed off wait is cut short.
+	double first_ms = source.WaitForDispatchMs(start, 1000);
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(500));
+	std::vector<Clock::time_point> times = source.GetTimesSince(start);
+	printf("  busy: first after %.2f ms, %u dispatches in 500 ms, max gap %.2f ms\n", first_ms,
+		static_cast<unsigned int>(times.size()), MaxGapMs(times));
+	CHECK(first_ms < kMaxDelayMs / 2);
+	// 50 expected, far more than the 5 of the idle interval.
+	CHECK(times.size() >= 20);
+
+	// Hidden again, back to backing off.
+	pump.SetBusy(false);
+	std::this_thread::sleep_for(std::chrono::milliseconds(300));
+	Clock::time_point idle_start = Clock::now();
+	std::this_thread::sleep_for(std::chrono::milliseconds(500));
+	size_t idle_count = source.GetTimesSince(idle_start).size();
+	printf("  idle again: %u dispatches in 500 ms\n", static_cast<unsigned int>(idle_count));
+	CHECK(idle_count <= 10);
+
+	pump.Stop();
+}
+
+static void TestDispatchCanStop()
+{
+	StubWorkSource source;
+	source.StopAfter(3);
+	CEFMessagePump pump([&source]() { return source.Dispatch(); }, 1, 1);
+	pump.Start();
+
+	Clock::time_point deadline = Clock::now() + std::chrono::seconds(2);
+	while (pump.IsRunning() && Clock::now() < deadline)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+	CHECK(!pump.IsRunning());
+	CHECK_EQ(3u, source.GetCount());
+	pump.Stop();
+}
+
+int main()
+{
+	RUN_TEST(TestIdleBacksOff);
+	RUN_TEST(TestScheduleWorkIsPrompt);
+	RUN_TEST(TestBusyKeepsMinInterval);
+	RUN_TEST(TestDispatchCanStop);
+	return 0;
+}
@@ -0,0 +1,112 @@
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "CEFNavigationDecision.h"
+#include "TestUtils.h"
+
+static void TestAnswerInTime()
+{
+	CEFNavigationDecision decision;
+	std::thread decider([&decision]() { decision.Decide(false); });
+
+	bool allowed = true;
+	CHECK(decision.Wait(10000, allowed));
+	CHECK(!allowed);
+	decider.join();
+}
+
+static void TestLateApproval()
+{
+	std::shared_ptr<CEFNavigationDecision> decision = std::make_shared<CEFNavigationDecision>();
+	bool allowed = false;
+	CHECK(!decision->Wait(1, allowed));
+
+	int late_calls = 0;
+	bool late_allowed = false;
+	CHECK(decision->GiveUp([&late_calls, &late_allowed](bool value) {
+		++late_calls;
+		late_allowed = value;
+	}, allowed));
+
+	std::thread decider([decision]() { decision->Decide(true); });
+	decider.join();
+
+	CHECK_EQ(1, late_calls);
+	CHECK(late_allowed);
+
+	// Only the first answer counts.
+	decision->Decide(false);
+	CHECK_EQ(1, late_calls);
+}
+
+static void TestAnswerBeforeGiveUp()
+{
+	CEFNavigationDecision decision;
+	decision.Decide(true);
+
+	bool allowed = false;
+	bool late_called = false;
+	CHECK(!decision.GiveUp([&late_called](bool) { late_called = true; }, allowed));
+	CHECK(allowed);
+	CHECK(!late_called);
+}
+
+// The decider races the timeout of the waiter. Whichever wins, the answer
+// reaches exactly one of the waiter and the late callback.
+static void TestStressHandoff()
+{
+	const int kRounds = 20000;
+	int waiter_answers = 0;
+	int late_answers = 0;
+
+	for (int round = 0; round < kRounds; ++round)
+	{
+		std::shared_ptr<CEFNavigationDecision> decision = std::make_shared<CEFNavigationDecision>();
+		bool expected = (round % 3) != 0;
+		std::atomic<int> late_calls(0);
+		std::atomic<bool> late_allowed(!expected);
+
+		std::thread decider([decision, expected, round]() {
+			if (round % 2)
+				std::this_thread::yield();
+			decision->Decide(expected);
+		});
+
+		bool allowed = !expected;
+		bool answered = decision->Wait(round % 4 == 0 ? 1 : 0, allowed);
+		if (!answered)
+		{
+			answered = !decision->GiveUp([&late_calls, &late_allowed](bool value) {
+				late_allowed = value;
+				++late_calls;
+			}, allowed);
+		}
+		decider.join();
+
+		if (answered)
+		{
+			CHECK_EQ(expected, allowed);
+			CHECK_EQ(0, late_calls.load());
+			++waiter_answers;
+		}
+		else
+		{
+			CHECK_EQ(1, late_calls.load());
+			CHECK_EQ(expected, late_allowed.load());
+			++late_answers;
+		}
+	}
+
+	printf("  %d answered in time, %d late\n", waiter_answers, late_answers);
+	CHECK_EQ(kRounds, waiter_answers + late_answers);
+}
+
+int main()
+{
+	RUN_TEST(TestAnswerInTime);
+	RUN_TEST(TestLateApproval);
+	RUN_TEST(TestAnswerBeforeGiveUp);
+	RUN_TEST(TestStressHandoff);
+	return 0;
+}
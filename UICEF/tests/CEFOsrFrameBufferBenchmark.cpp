@@ -0,0 +1,130 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "CEFOsrFrameBuffer.h"
+
+// Replays dirty rect traces of a 720p page through the frame buffer and reports
+// the bytes converted and uploaded per frame, against converting and uploading
+// every frame whole as before.
+
+typedef std::chrono::steady_clock Clock;
+typedef CEFOsrFrameBuffer::Rect Rect;
+
+static const int kWidth = 1280;
+static const int kHeight = 720;
+static const int kFrames = 600;
+
+// The rects painted in frame |i| of a trace.
+typedef void (*Trace)(int i, std::vector<Rect>& rects);
+
+// A text caret blinking twice a second.
+static void CaretTrace(int i, std::vector<Rect>& rects)
+{
+	if (i % 30 == 0)
+	{
+		Rect caret = { 400, 300, 2, 18 };
+		rects.push_back(caret);
+	}
+}
+
+// A loading spinner and a score counter animating every frame.
+static void SpinnerTrace(int i, std::vector<Rect>& rects)
+{
+	Rect spinner = { 616, 336, 48, 48 };
+	rects.push_back(spinner);
+	if (i % 4 == 0)
+	{
+		Rect counter = { 1100, 20, 120, 32 };
+		rects.push_back(counter);
+	}
+}
+
+// A news ticker scrolling along the bottom.
+static void TickerTrace(int, std::vector<Rect>& rects)
+{
+	Rect ticker = { 0, 690, kWidth, 24 };
+	rects.push_back(ticker);
+}
+
+// All of the above, with a page scroll every few seconds repainting most of
+// the view.
+static void MixedTrace(int i, std::vector<Rect>& rects)
+{
+	CaretTrace(i, rects);
+	SpinnerTrace(i, rects);
+	TickerTrace(i, rects);
+	if (i % 180 >= 170)
+	{
+		Rect content = { 0, 60, kWidth, 620 };
+		rects.push_back(content);
+	}
+}
+
+struct Result
+{
+	double copied_per_frame;
+	double upload_per_frame;
+	double ms_per_frame;
+};
+
+static Result Replay(Trace trace, bool whole_frames)
+{
+	std::vector<uint8_t> bgra(kWidth * kHeight * 4);
+	for (size_t i = 0; i < bgra.size(); ++i)
+		bgra[i] = static_cast<uint8_t>(i * 31 + (i >> 10));
+
+	CEFOsrFrameBuffer buffer;
+	if (whole_frames)
+		buffer.SetFullUpdateThreshold(0.0f);
+
+	Rect all = { 0, 0, kWidth, kHeight };
+	buffer.OnPaint(&bgra[0], kWidth, kHeight, &all, 1);
+	CEFOsrFrameBuffer::Frame frame;
+	buffer.AcquireFrame(frame);
+	CEFOsrFrameBuffer::Stats before = buffer.GetStats();
+
+	std::vector<Rect> rects;
+	int painted = 0;
+	Clock::time_point start = Clock::now();
+	for (int i = 0; i < kFrames; ++i)
+	{
+		rects.clear();
+		trace(i, rects);
+		if (rects.empty())
+			continue;
+
+		// The page changes a little in every painted frame.
+		bgra[(i * 4099) % bgra.size()] ^= 0xff;
+		buffer.OnPaint(&bgra[0], kWidth, kHeight, &rects[0], rects.size());
+		buffer.AcquireFrame(frame);
+		++painted;
+	}
+	double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+	CEFOsrFrameBuffer::Stats after = buffer.GetStats();
+	Result result;
+	result.copied_per_frame = static_cast<double>(after.copied_bytes - before.copied_bytes) / painted;
+	result.upload_per_frame = static_cast<double>(after.upload_bytes - before.upload_bytes) / painted;
+	result.ms_per_frame = ms / painted;
+	return result;
+}
+
+static void Run(const char* name, Trace trace)
+{
+	Result whole = Replay(trace, true);
+	Result dirty = Replay(trace, false);
+	printf("%-8s copied %8.0f -> %8.0f B/frame, uploaded %8.0f -> %8.0f B/frame, %6.3f -> %6.3f ms/frame\n",
+		name, whole.copied_per_frame, dirty.copied_per_frame, whole.upload_per_frame, dirty.upload_per_frame,
+		whole.ms_per_frame, dirty.ms_per_frame);
+}
+
+int main()
+{
+	printf("%dx%d, %d frames, a whole frame is %d bytes\n", kWidth, kHeight, kFrames, kWidth * kHeight * 4);
+	Run("caret", CaretTrace);
+	Run("spinner", SpinnerTrace);
+	Run("ticker", TickerTrace);
+	Run("mixed", MixedTrace);
+	return 0;
+}
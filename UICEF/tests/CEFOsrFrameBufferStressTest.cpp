@@ -0,0 +1,196 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "CEFFrameWorkerPool.h"
+#include "CEFOsrFrameBuffer.h"
+#include "TestUtils.h"
+
+// A paint storm: a stub CEF UI thread paints as fast as it can while the test,
+// as the cocos thread, acquires frames. Each paint changes the page only in
+// its dirty rects, and every acquired frame must be exactly the page as one
+// paint left it. Build with UICEF_TSAN to check the threads under
+// ThreadSanitizer.
+
+typedef CEFOsrFrameBuffer::Rect Rect;
+
+static const int kWidth = 32;
+static const int kHeight = 32;
+static const int kPaints = 20000;
+
+static uint64_t HashRGBA(const uint8_t* rgba, size_t bytes)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < bytes; ++i)
+		hash = (hash ^ rgba[i]) * 1099511628211ull;
+	return hash;
+}
+
+// The page CEF would paint. Pixel 0, 0 holds the number of the last paint.
+class StubPage
+{
+public:
+	StubPage() : bgra_(kWidth * kHeight * 4, 0), state_(1) {}
+
+	// Change the page in a few random rects and return them.
+	void Change(int paint, std::vector<Rect>& rects)
+	{
+		rects.clear();
+		Rect origin = { 0, 0, 1, 1 };
+		rects.push_back(origin);
+		int count = static_cast<int>(Next() % 3);
+		for (int i = 0; i < count; ++i)
+		{
+			Rect rect;
+			rect.x = static_cast<int>(Next() % kWidth);
+			rect.y = static_cast<int>(Next() % kHeight);
+			rect.width = 1 + static_cast<int>(Next() % (kWidth - rect.x));
+			rect.height = 1 + static_cast<int>(Next() % (kHeight - rect.y));
+			rects.push_back(rect);
+		}
+
+		for (size_t i = 0; i < rects.size(); ++i)
+		{
+			for (int y = rects[i].y; y < rects[i].y + rects[i].height; ++y)
+			{
+				for (int x = rects[i].x; x < rects[i].x + rects[i].width; ++x)
+				{
+					uint8_t* px = &bgra_[(y * kWidth + x) * 4];
+					px[0] = static_cast<uint8_t>(paint);
+					px[1] = static_cast<uint8_t>(paint >> 8);
+					px[2] = static_cast<uint8_t>(paint >> 16);
+					px[3] = 255;
+				}
+			}
+		}
+	}
+
+	// Hash of the page converted to RGBA.
+	uint64_t Hash() const
+	{
+		std::vector<uint8_t> rgba(bgra_.size());
+		for (size_t i = 0; i < bgra_.size(); i += 4)
+		{
+			rgba[i] = bgra_[i + 2];
+			rgba[i + 1] = bgra_[i + 1];
+			rgba[i + 2] = bgra_[i];
+			rgba[i + 3] = bgra_[i + 3];
+		}
+		return HashRGBA(&rgba[0], rgba.size());
+	}
+
+	const uint8_t* GetPixels() const { return &bgra_[0]; }
+
+private:
+	uint32_t Next()
+	{
+		state_ = state_ * 1103515245 + 12345;
+		return state_ >> 8;
+	}
+
+	std::vector<uint8_t> bgra_;
+	uint32_t state_;
+};
+
+static int PaintOf(const CEFOsrFrameBuffer::Frame& frame)
+{
+	return frame.pixels[2] | frame.pixels[1] << 8 | frame.pixels[0] << 16;
+}
+
+static void RunStorm(int worker_count)
+{
+	std::shared_ptr<CEFFrameWorkerPool> pool;
+	if (worker_count > 0)
+		pool = std::make_shared<CEFFrameWorkerPool>(worker_count);
+	std::shared_ptr<CEFOsrFrameBuffer> buffer = std::make_shared<CEFOsrFrameBuffer>(pool);
+
+	// Written before each paint, read once the frame of that paint arrived.
+	std::vector<uint64_t> hashes(kPaints);
+	std::atomic<bool> done(false);
+
+	std::thread painter([&buffer, &hashes, &done]() {
+		StubPage page;
+		std::vector<Rect> rects;
+		for (int i = 0; i < kPaints; ++i)
+		{
+			page.Change(i, rects);
+			hashes[i] = page.Hash();
+			buffer->OnPaint(page.GetPixels(), kWidth, kHeight, &rects[0], rects.size());
+		}
+		done = true;
+	});
+
+	int last = -1;
+	int torn = 0;
+	int unordered = 0;
+	CEFOsrFrameBuffer::Frame frame;
+	for (;;)
+	{
+		bool finished = done;
+		if (finished)
+		{
+			painter.join();
+			buffer->Flush();
+		}
+
+		if (buffer->AcquireFrame(frame))
+		{
+			int paint = PaintOf(frame);
+			if (paint <= last)
+				++unordered;
+			else if (paint >= kPaints || HashRGBA(frame.pixels, kWidth * kHeight * 4) != hashes[paint])
+				++torn;
+			last = paint;
+		}
+		else if (!finished)
+		{
+			std::this_thread::yield();
+		}
+
+		if (finished)
+			break;
+	}
+
+	CEFOsrFrameBuffer::Stats stats = buffer->GetStats();
+	printf("  %d workers: %llu paints, %llu dropped, %llu frames, %llu skipped, %llu acquired, latency avg %.0f us max %llu us\n",
+		worker_count, static_cast<unsigned long long>(stats.paints), static_cast<unsigned long long>(stats.dropped_paints),
+		static_cast<unsigned long long>(stats.frames), static_cast<unsigned long long>(stats.skipped_frames),
+		static_cast<unsigned long long>(stats.acquires),
+		stats.acquires ? static_cast<double>(stats.total_latency_us) / stats.acquires : 0.0,
+		static_cast<unsigned long long>(stats.max_latency_us));
+
+	CHECK_EQ(0, torn);
+	CHECK_EQ(0, unordered);
+	CHECK_EQ(kPaints - 1, last);
+	CHECK_EQ(static_cast<uint64_t>(kPaints), stats.paints);
+	CHECK_EQ(stats.paints, stats.frames + stats.dropped_paints);
+	CHECK_EQ(stats.frames, stats.acquires + stats.skipped_frames);
+	if (worker_count == 0)
+		CHECK_EQ(0u, stats.dropped_paints);
+}
+
+static void TestInOnPaint()
+{
+	RunStorm(0);
+}
+
+static void TestOneWorker()
+{
+	RunStorm(1);
+}
+
+static void TestTwoWorkers()
+{
+	RunStorm(2);
+}
+
+int main()
+{
+	RUN_TEST(TestInOnPaint);
+	RUN_TEST(TestOneWorker);
+	RUN_TEST(TestTwoWorkers);
+	return 0;
+}
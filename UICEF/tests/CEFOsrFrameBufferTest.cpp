@@ -0,0 +1,410 @@
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "CEFFrameWorkerPool.h"
+#include "CEFOsrFrameBuffer.h"
+#include "TestUtils.h"
+
+typedef CEFOsrFrameBuffer::Rect Rect;
+
+// A BGRA frame as CEF paints it, every pixel set from its position and |seed|.
+class StubPaint
+{
+public:
+	StubPaint(int width, int height) : width_(width), height_(height), bgra_(width * height * 4) {}
+
+	void Fill(int seed)
+	{
+		for (int y = 0; y < height_; ++y)
+		{
+			for (int x = 0; x < width_; ++x)
+			{
+				uint8_t* px = Pixel(x, y);
+				px[0] = static_cast<uint8_t>(x + seed);
+				px[1] = static_cast<uint8_t>(y * 3 + seed);
+				px[2] = static_cast<uint8_t>(seed * 7);
+				px[3] = 255;
+			}
+		}
+	}
+
+	void Paint(CEFOsrFrameBuffer& buffer, const Rect* dirty, size_t dirty_count)
+	{
+		buffer.OnPaint(&bgra_[0], width_, height_, dirty, dirty_count);
+	}
+
+	void PaintAll(CEFOsrFrameBuffer& buffer)
+	{
+		Rect all = { 0, 0, width_, height_ };
+		Paint(buffer, &all, 1);
+	}
+
+	uint8_t* Pixel(int x, int y) { return &bgra_[(y * width_ + x) * 4]; }
+
+	// True if |frame| holds this paint converted to RGBA.
+	bool Matches(const CEFOsrFrameBuffer::Frame& frame)
+	{
+		if (frame.width != width_ || frame.height != height_)
+			return false;
+		for (int y = 0; y < height_; ++y)
+		{
+			for (int x = 0; x < width_; ++x)
+			{
+				if (!MatchesAt(frame, x, y))
+					return false;
+			}
+		}
+		return true;
+	}
+
+	bool MatchesAt(const CEFOsrFrameBuffer::Frame& frame, int x, int y)
+	{
+		const uint8_t* bgra = Pixel(x, y);
+		const uint8_t* rgba = frame.pixels + (y * frame.width + x) * 4;
+		return rgba[0] == bgra[2] && rgba[1] == bgra[1] && rgba[2] == bgra[0] && rgba[3] == bgra[3];
+	}
+
+private:
+	int width_;
+	int height_;
+	std::vector<uint8_t> bgra_;
+};
+
+// Runs each test with the conversion in OnPaint and on a pool.
+static std::shared_ptr<CEFOsrFrameBuffer> MakeBuffer(bool pooled, std::shared_ptr<CEFFrameWorkerPool>& pool)
+{
+	pool.reset(pooled ? new CEFFrameWorkerPool(2) : NULL);
+	return std::make_shared<CEFOsrFrameBuffer>(pool);
+}
+
+static void TestNoFrameBeforePaint(bool pooled)
+{
+	std::shared_ptr<CEFFrameWorkerPool> pool;
+	std::shared_ptr<CEFOsrFrameBuffer> buffer = MakeBuffer(pooled, pool);
+
+	CEFOsrFrameBuffer::Frame frame;
+	CHECK(!buffer->AcquireFrame(frame));
+
+	// Nothing to paint.
+	buffer->OnPaint(NULL, 4, 4, NULL, 0);
+	buffer->Flush();
+	CHECK(!buffer->AcquireFrame(frame));
+}
+
+static void TestConvertsToRGBA(bool pooled)
+{
+	std::shared_ptr<CEFFrameWorkerPool> pool;
+	std::shared_ptr<CEFOsrFrameBuffer> buffer = MakeBuffer(pooled, pool);
+
+	StubPaint paint(13, 5);
+	paint.Fill(1);
+	paint.Pixel(2, 3)[3] = 128;
+	paint.PaintAll(*buffer);
+	buffer->Flush();
+
+	CEFOsrFrameBuffer::Frame frame;
+	CHECK(buffer->AcquireFrame(frame));
+	CHECK(paint.Matches(frame));
+	CHECK(frame.full_update);
+	CHECK_EQ(1u, frame.dirty_count);
+	CHECK_EQ(13, frame.dirty_rects[0].width);
+	CHECK_EQ(5, frame.dirty_rects[0].height);
+
+	// Premultiplied alpha is kept as painted.
+	CHECK_EQ(128, frame.pixels[(3 * 13 + 2) * 4 + 3]);
+}
+
+// AcquireFrame() tells once about each completed frame, and only the newest.
+static void TestFrameReady(bool pooled)
+{
+	std::shared_ptr<CEFFrameWorkerPool> pool;
+	std::shared_ptr<CEFOsrFrameBuffer> buffer = MakeBuffer(pooled, pool);
+
+	StubPaint paint(8, 8);
+	paint.Fill(1);
+	paint.PaintAll(*buffer);
+	buffer->Flush();
+
+	CEFOsrFrameBuffer::Frame frame;
+	CHECK(buffer->AcquireFrame(frame));
+	CHECK(!buffer->AcquireFrame(frame));
+
+	paint.Fill(2);
+	paint.PaintAll(*buffer);
+	paint.Fill(3);
+	paint.PaintAll(*buffer);
+	buffer->Flush();
+
+	CHECK(buffer->AcquireFrame(frame));
+	CHECK(paint.Matches(frame));
+	CHECK(!buffer->AcquireFrame(frame));
+
+	CEFOsrFrameBuffer::Stats stats = buffer->GetStats();
+	CHECK_EQ(3u, stats.paints);
+	CHECK_EQ(2u, stats.acquires);
+	CHECK_EQ(stats.frames, stats.acquires + stats.skipped_frames);
+}
+
+// The view size is only what the browser is asked to paint, the frames keep
+// the size they were painted at until the browser follows.
+static void TestViewSize(bool pooled)
+{
+	std::shared_ptr<CEFFrameWorkerPool> pool;
+	std::shared_ptr<CEFOsrFrameBuffer> buffer = MakeBuffer(pooled, pool);
+
+	int width = -1, height = -1;
+	buffer->GetViewSize(width, height);
+	CHECK_EQ(0, width);
+	CHECK_EQ(0, height);
+
+	buffer->SetViewSize(16, 8);
+	buffer->GetViewSize(width, height);
+	CHECK_EQ(16, width);
+	CHECK_EQ(8, height);
+
+	StubPaint small(16, 8);
+	small.Fill(1);
+	small.PaintAll(*buffer);
+	buffer->Flush();
+
+	CEFOsrFrameBuffer::Frame frame;
+	CHECK(buffer->AcquireFrame(frame));
+	CHECK(small.Matches(frame));
+
+	buffer->SetViewSize(24, 10);
+
+	// A paint at the new size is a full update even with a small dirty rect.
+	StubPaint large(24, 10);
+	large.Fill(2);
+	Rect dirty = { 1, 1, 2, 2 };
+	large.Paint(*buffer, &dirty, 1);
+	buffer->Flush();
+
+	CHECK(buffer->AcquireFrame(frame));
+	CHECK(large.Matches(frame));
+	CHECK(frame.full_update);
+	CHECK_EQ(24, frame.dirty_rects[0].width);
+	CHECK_EQ(10, frame.dirty_rects[0].height);
+
+	// Back to the old size.
+	small.Fill(3);
+	small.Paint(*buffer, &dirty, 1);
+	buffer->Flush();
+	CHECK(buffer->AcquireFrame(frame));
+	CHECK(small.Matches(frame));
+	CHECK(frame.full_update);
+}
+
+// A partial paint only touches its rect, the rest of the frame stays as it
+// was even though the paint buffer changed everywhere.
+static void TestPartialRect(bool pooled)
+{
+	std::shared_ptr<CEFFrameWorkerPool> pool;
+	std::shared_ptr<CEFOsrFrameBuffer> buffer = MakeBuffer(pooled, pool);
+
+	StubPaint first(16, 8);
+	first.Fill(1);
+	first.PaintAll(*buffer);
+	buffer->Flush();
+	CEFOsrFrameBuffer::Frame frame;
+	CHECK(buffer->AcquireFrame(frame));
+
+	StubPaint second(16, 8);
+	second.Fill(2);
+	Rect rect = { 3, 2, 4, 3 };
+	second.Paint(*buffer, &rect, 1);
+	buffer->Flush();
+
+	CHECK(buffer->AcquireFrame(frame));
+	CHECK(!frame.full_update);
+	CHECK_EQ(1u, frame.dirty_count);
+	CHECK_EQ(rect.x, frame.dirty_rects[0].x);
+	CHECK_EQ(rect.y, frame.dirty_rects[0].y);
+	CHECK_EQ(rect.width, frame.dirty_rects[0].width);
+	CHECK_EQ(rect.height, frame.dirty_rects[0].height);
+	CHECK_EQ(4u * 4 * 3, buffer->GetStats().last_upload_bytes);
+	for (int y = 0; y < 8; ++y)
+	{
+		for (int x = 0; x < 16; ++x)
+		{
+			bool inside = x >= 3 && x < 7 && y >= 2 && y < 5;
+			CHECK(inside ? second.MatchesAt(frame, x, y) : first.MatchesAt(frame, x, y));
+		}
+	}
+
+	// Both slots are in use now. The next one catches up on the previous rect
+	// from the newest slot and converts its own, nothing else.
+	StubPaint third(16, 8);
+	third.Fill(3);
+	Rect next = { 10, 1, 2, 2 };
+	third.Paint(*buffer, &next, 1);
+	buffer->Flush();
+
+	CHECK(buffer->AcquireFrame(frame));
+	CHECK_EQ((4u * 3 + 2 * 2) * 4, buffer->GetStats().last_copied_bytes);
+	CHECK_EQ(2u * 2 * 4, buffer->GetStats().last_upload_bytes);
+	for (int y = 0; y < 8; ++y)
+	{
+		for (int x = 0; x < 16; ++x)
+		{
+			if (x >= 10 && x < 12 && y >= 1 && y < 3)
+				CHECK(third.MatchesAt(frame, x, y));
+			else if (x >= 3 && x < 7 && y >= 2 && y < 5)
+				CHECK(second.MatchesAt(frame, x, y));
+			else
+				CHECK(first.MatchesAt(frame, x, y));
+		}
+	}
+}
+
+// Overlapping rects are merged into one, distant ones stay apart and the
+// pixels between them are not copied.
+static void TestMergedRects(bool pooled)
+{
+	std::shared_ptr<CEFFrameWorkerPool> pool;
+	std::shared_ptr<CEFOsrFrameBuffer> buffer = MakeBuffer(pooled, pool);
+
+	StubPaint first(16, 8);
+	first.Fill(1);
+	first.PaintAll(*buffer);
+	buffer->Flush();
+	CEFOsrFrameBuffer::Frame frame;
+	CHECK(buffer->AcquireFrame(frame));
+
+	StubPaint second(16, 8);
+	second.Fill(2);
+	Rect overlapping[] = { { 2, 2, 3, 3 }, { 4, 3, 3, 3 } };
+	second.Paint(*buffer, overlapping, 2);
+	buffer->Flush();
+
+	CHECK(buffer->AcquireFrame(frame));
+	CHECK(!frame.full_update);
+	CHECK_EQ(1u, frame.dirty_count);
+	CHECK_EQ(2, frame.dirty_rects[0].x);
+	CHECK_EQ(2, frame.dirty_rects[0].y);
+	CHECK_EQ(5, frame.dirty_rects[0].width);
+	CHECK_EQ(4, frame.dirty_rects[0].height);
+	for (int y = 0; y < 8; ++y)
+	{
+		for (int x = 0; x < 16; ++x)
+		{
+			bool inside = x >= 2 && x < 7 && y >= 2 && y < 6;
+			CHECK(inside ? second.MatchesAt(frame, x, y) : first.MatchesAt(frame, x, y));
+		}
+	}
+
+	StubPaint third(16, 8);
+	third.Fill(3);
+	Rect apart[] = { { 0, 0, 2, 2 }, { 13, 5, 3, 3 } };
+	third.Paint(*buffer, apart, 2);
+	buffer->Flush();
+
+	CHECK(buffer->AcquireFrame(frame));
+	CHECK_EQ(2u, frame.dirty_count);
+	CHECK_EQ((2u * 2 + 3 * 3) * 4, buffer->GetStats().last_upload_bytes);
+	CHECK(third.MatchesAt(frame, 1, 1));
+	CHECK(third.MatchesAt(frame, 15, 7));
+	CHECK(second.MatchesAt(frame, 3, 3));
+	CHECK(first.MatchesAt(frame, 8, 4));
+}
+
+// Rects of frames that were never acquired are uploaded with the next one.
+static void TestSkippedFrameRects(bool pooled)
+{
+	std::shared_ptr<CEFFrameWorkerPool> pool;
+	std::shared_ptr<CEFOsrFrameBuffer> buffer = MakeBuffer(pooled, pool);
+
+	StubPaint paint(16, 8);
+	paint.Fill(1);
+	paint.PaintAll(*buffer);
+	buffer->Flush();
+	CEFOsrFrameBuffer::Frame frame;
+	CHECK(buffer->AcquireFrame(frame));
+
+	paint.Fill(2);
+	Rect left = { 0, 0, 2, 2 };
+	paint.Paint(*buffer, &left, 1);
+	Rect right = { 12, 4, 2, 2 };
+	paint.Paint(*buffer, &right, 1);
+	buffer->Flush();
+
+	CHECK(buffer->AcquireFrame(frame));
+	CHECK(!frame.full_update);
+	CHECK_EQ(2u, frame.dirty_count);
+	CHECK(paint.MatchesAt(frame, 0, 0));
+	CHECK(paint.MatchesAt(frame, 13, 5));
+}
+
+// Past the threshold the whole frame is converted and uploaded.
+static void TestFullUpdateThreshold(bool pooled)
+{
+	std::shared_ptr<CEFFrameWorkerPool> pool;
+	std::shared_ptr<CEFOsrFrameBuffer> buffer = MakeBuffer(pooled, pool);
+
+	StubPaint paint(16, 8);
+	paint.Fill(1);
+	paint.PaintAll(*buffer);
+	buffer->Flush();
+	CEFOsrFrameBuffer::Frame frame;
+	CHECK(buffer->AcquireFrame(frame));
+
+	paint.Fill(2);
+	Rect most = { 0, 0, 12, 6 };
+	paint.Paint(*buffer, &most, 1);
+	buffer->Flush();
+
+	CHECK(buffer->AcquireFrame(frame));
+	CHECK(frame.full_update);
+	CHECK(paint.Matches(frame));
+	CHECK_EQ(16u * 8 * 4, buffer->GetStats().last_upload_bytes);
+}
+
+static void RunAll(bool pooled)
+{
+	printf("  %s\n", pooled ? "pool" : "in OnPaint");
+	TestNoFrameBeforePaint(pooled);
+	TestConvertsToRGBA(pooled);
+	TestFrameReady(pooled);
+	TestViewSize(pooled);
+	TestPartialRect(pooled);
+	TestMergedRects(pooled);
+	TestSkippedFrameRects(pooled);
+	TestFullUpdateThreshold(pooled);
+}
+
+static void TestMergeRectsCap()
+{
+	std::vector<Rect> rects;
+	Rect touching[] = { { 0, 0, 2, 2 }, { 2, 0, 2, 2 } };
+	rects.assign(touching, touching + 2);
+	CEFOsrFrameBuffer::MergeRects(rects, 8);
+	CHECK_EQ(1u, rects.size());
+	CHECK_EQ(4, rects[0].width);
+
+	// Over the cap the pair adding the least area goes first.
+	Rect apart[] = { { 0, 0, 1, 1 }, { 3, 0, 1, 1 }, { 100, 100, 1, 1 } };
+	rects.assign(apart, apart + 3);
+	CEFOsrFrameBuffer::MergeRects(rects, 2);
+	CHECK_EQ(2u, rects.size());
+	CHECK_EQ(0, rects[0].x);
+	CHECK_EQ(4, rects[0].width);
+	CHECK_EQ(100, rects[1].x);
+}
+
+static void TestInOnPaint()
+{
+	RunAll(false);
+}
+
+static void TestOnPool()
+{
+	RunAll(true);
+}
+
+int main()
+{
+	RUN_TEST(TestInOnPaint);
+	RUN_TEST(TestOnPool);
+	RUN_TEST(TestMergeRectsCap);
+	return 0;
+}
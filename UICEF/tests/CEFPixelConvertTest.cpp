@@ -0,0 +1,168 @@
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "CEFPixelConvert.h"
+#include "TestUtils.h"
+
+static const char* const kIsaNames[] = { "scalar", "SSE2", "SSSE3", "AVX2" };
+
+static const int kFlagSets[] = {
+	0,
+	CEFPixelConvert::kUnpremultiply,
+	CEFPixelConvert::kFlipVertical,
+	CEFPixelConvert::kUnpremultiply | CEFPixelConvert::kFlipVertical,
+};
+
+// Deterministic pixels, with some fully transparent and opaque ones.
+static std::vector<uint8_t> MakePixels(size_t count)
+{
+	std::vector<uint8_t> pixels(count * 4);
+	uint32_t state = 12345;
+	for (size_t i = 0; i < pixels.size(); ++i)
+	{
+		state = state * 1103515245 + 12345;
+		pixels[i] = static_cast<uint8_t>(state >> 16);
+	}
+	for (size_t i = 0; i < count; i += 5)
+		pixels[i * 4 + 3] = i % 2 ? 0 : 255;
+	return pixels;
+}
+
+static std::vector<uint8_t> ConvertWith(CEFPixelConvert::Isa isa, const std::vector<uint8_t>& bgra, int stride,
+	int frame_height, int x, int y, int width, int height, int flags)
+{
+	CEFPixelConvert::SetIsa(isa);
+	std::vector<uint8_t> rgba(bgra.size(), 0xcd);
+	CEFPixelConvert::ConvertRect(&bgra[0], &rgba[0], stride, frame_height, x, y, width, height, flags);
+	return rgba;
+}
+
+// The scalar path against the definition of each flag.
+static void TestScalar()
+{
+	CEFPixelConvert::SetIsa(CEFPixelConvert::kScalar);
+	const uint8_t bgra[] = { 10, 20, 30, 255, 50, 100, 100, 200, 7, 8, 9, 0 };
+	uint8_t rgba[12];
+
+	CEFPixelConvert::ConvertRow(bgra, rgba, 3, 0);
+	const uint8_t swapped[] = { 30, 20, 10, 255, 100, 100, 50, 200, 9, 8, 7, 0 };
+	for (int i = 0; i < 12; ++i)
+		CHECK_EQ(swapped[i], rgba[i]);
+
+	// Rounded c * 255 / a, transparent pixels go to 0.
+	CEFPixelConvert::ConvertRow(bgra, rgba, 3, CEFPixelConvert::kUnpremultiply);
+	const uint8_t unpremultiplied[] = { 30, 20, 10, 255, 128, 128, 64, 200, 0, 0, 0, 0 };
+	for (int i = 0; i < 12; ++i)
+		CHECK_EQ(unpremultiplied[i], rgba[i]);
+
+	// Row y lands on frame_height - 1 - y.
+	const uint8_t column[] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12 };
+	CEFPixelConvert::ConvertRect(column, rgba, 4, 3, 0, 0, 1, 3, CEFPixelConvert::kFlipVertical);
+	const uint8_t flipped[] = { 11, 10, 9, 12, 7, 6, 5, 8, 3, 2, 1, 4 };
+	for (int i = 0; i < 12; ++i)
+		CHECK_EQ(flipped[i], rgba[i]);
+}
+
+// Every color and alpha pair, in one row per kernel.
+static void TestUnpremultiplyAllValues()
+{
+	std::vector<uint8_t> bgra(256 * 256 * 4);
+	for (int a = 0; a < 256; ++a)
+	{
+		for (int c = 0; c < 256; ++c)
+		{
+			uint8_t* px = &bgra[(a * 256 + c) * 4];
+			px[0] = static_cast<uint8_t>(c);
+			px[1] = static_cast<uint8_t>(255 - c);
+			px[2] = static_cast<uint8_t>(c / 2);
+			px[3] = static_cast<uint8_t>(a);
+		}
+	}
+
+	std::vector<uint8_t> expected = ConvertWith(CEFPixelConvert::kScalar, bgra, 256 * 256 * 4, 1, 0, 0, 256 * 256, 1,
+		CEFPixelConvert::kUnpremultiply);
+	for (int isa = CEFPixelConvert::kSSE2; isa <= CEFPixelConvert::GetSupportedIsa(); ++isa)
+	{
+		std::vector<uint8_t> actual = ConvertWith(static_cast<CEFPixelConvert::Isa>(isa), bgra, 256 * 256 * 4, 1, 0, 0,
+			256 * 256, 1, CEFPixelConvert::kUnpremultiply);
+		CHECK(actual == expected);
+	}
+}
+
+// Each kernel against scalar for every flag set, at widths that end on any
+// remainder of the vector width, and at an offset into the frame.
+static void TestKernelsMatchScalar()
+{
+	const int kFrameWidth = 40;
+	const int kFrameHeight = 6;
+	const int kStride = kFrameWidth * 4;
+	std::vector<uint8_t> bgra = MakePixels(kFrameWidth * kFrameHeight);
+
+	for (int isa = CEFPixelConvert::kSSE2; isa <= CEFPixelConvert::GetSupportedIsa(); ++isa)
+	{
+		printf("  %s\n", kIsaNames[isa]);
+		for (size_t f = 0; f < sizeof(kFlagSets) / sizeof(kFlagSets[0]); ++f)
+		{
+			for (int width = 0; width <= 8; ++width)
+			{
+				for (int x = 0; x < 3; ++x)
+				{
+					std::vector<uint8_t> expected = ConvertWith(CEFPixelConvert::kScalar, bgra, kStride, kFrameHeight,
+						x, 1, width, 4, kFlagSets[f]);
+					std::vector<uint8_t> actual = ConvertWith(static_cast<CEFPixelConvert::Isa>(isa), bgra, kStride,
+						kFrameHeight, x, 1, width, 4, kFlagSets[f]);
+					CHECK(actual == expected);
+				}
+			}
+
+			// Whole vectors followed by a tail.
+			std::vector<uint8_t> expected = ConvertWith(CEFPixelConvert::kScalar, bgra, kStride, kFrameHeight,
+				0, 0, 37, kFrameHeight, kFlagSets[f]);
+			std::vector<uint8_t> actual = ConvertWith(static_cast<CEFPixelConvert::Isa>(isa), bgra, kStride,
+				kFrameHeight, 0, 0, 37, kFrameHeight, kFlagSets[f]);
+			CHECK(actual == expected);
+		}
+	}
+}
+
+// Pixels outside the rect are left alone.
+static void TestRectBounds()
+{
+	const int kFrameWidth = 16;
+	const int kFrameHeight = 4;
+	std::vector<uint8_t> bgra = MakePixels(kFrameWidth * kFrameHeight);
+
+	for (int isa = CEFPixelConvert::kScalar; isa <= CEFPixelConvert::GetSupportedIsa(); ++isa)
+	{
+		std::vector<uint8_t> rgba = ConvertWith(static_cast<CEFPixelConvert::Isa>(isa), bgra, kFrameWidth * 4,
+			kFrameHeight, 3, 1, 9, 2, 0);
+		for (int y = 0; y < kFrameHeight; ++y)
+		{
+			for (int x = 0; x < kFrameWidth; ++x)
+			{
+				bool inside = x >= 3 && x < 12 && y >= 1 && y < 3;
+				const uint8_t* px = &rgba[(y * kFrameWidth + x) * 4];
+				CHECK_EQ(inside, px[0] != 0xcd || px[1] != 0xcd || px[2] != 0xcd || px[3] != 0xcd);
+			}
+		}
+	}
+}
+
+static void TestSetIsaIsClamped()
+{
+	CEFPixelConvert::SetIsa(CEFPixelConvert::kAVX2);
+	CHECK_EQ(CEFPixelConvert::GetSupportedIsa(), CEFPixelConvert::GetIsa());
+	CEFPixelConvert::SetIsa(CEFPixelConvert::kScalar);
+	CHECK_EQ(CEFPixelConvert::kScalar, CEFPixelConvert::GetIsa());
+}
+
+int main()
+{
+	printf("supported: %s\n", kIsaNames[CEFPixelConvert::GetSupportedIsa()]);
+	RUN_TEST(TestScalar);
+	RUN_TEST(TestUnpremultiplyAllValues);
+	RUN_TEST(TestKernelsMatchScalar);
+	RUN_TEST(TestRectBounds);
+	RUN_TEST(TestSetIsaIsClamped);
+	return 0;
+}
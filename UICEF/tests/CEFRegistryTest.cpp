@@ -0,0 +1,100 @@
+#include <vector>
+#include "CEFRegistry.h"
+#include "TestUtils.h"
+
+struct Item
+{
+	int value;
+};
+
+typedef CEFRegistry<Item> Registry;
+
+static void TestAddFindRemove()
+{
+	Registry registry;
+	Item a = { 1 }, b = { 2 };
+	Registry::Id ida = registry.Add(&a);
+	Registry::Id idb = registry.Add(&b);
+	CHECK(ida != Registry::kInvalidId);
+	CHECK(ida != idb);
+	CHECK_EQ(&a, registry.Find(ida));
+	CHECK_EQ(2u, registry.Size());
+
+	CHECK(registry.Remove(ida));
+	CHECK(!registry.Remove(ida));
+	CHECK(registry.Find(ida) == NULL);
+
+	// The slot is reused under a new ID, the old one stays dead.
+	Item c = { 3 };
+	Registry::Id idc = registry.Add(&c);
+	CHECK(idc != ida);
+	CHECK(registry.Find(ida) == NULL);
+	CHECK_EQ(&c, registry.Find(idc));
+	CHECK(registry.Find(Registry::kInvalidId) == NULL);
+}
+
+static void TestAddDuringWalkNotVisited()
+{
+	Registry registry;
+	Item a = { 1 }, b = { 2 }, c = { 3 }, added = { 4 };
+	registry.Add(&a);
+	registry.Add(&b);
+	Registry::Id idc = registry.Add(&c);
+
+	// Frees the last slot before the walk, ahead of where it will be.
+	registry.Remove(idc);
+
+	std::vector<int> visited;
+	bool is_added = false;
+	registry.ForEach([&](Item* item) {
+		visited.push_back(item->value);
+		if (!is_added)
+		{
+			is_added = true;
+			registry.Add(&added);
+		}
+	});
+
+	CHECK_EQ(2u, visited.size());
+	CHECK_EQ(1, visited[0]);
+	CHECK_EQ(2, visited[1]);
+	CHECK_EQ(3u, registry.Size());
+}
+
+static void TestRemoveDuringWalk()
+{
+	Registry registry;
+	Item a = { 1 }, b = { 2 }, c = { 3 };
+	Registry::Id ida = registry.Add(&a);
+	Registry::Id idb = registry.Add(&b);
+	Registry::Id idc = registry.Add(&c);
+
+	// Removes itself and the one after it, which must be skipped.
+	std::vector<int> visited;
+	registry.ForEach([&](Item* item) {
+		visited.push_back(item->value);
+		if (item == &a)
+		{
+			registry.Remove(ida);
+			registry.Remove(idb);
+		}
+	});
+
+	CHECK_EQ(2u, visited.size());
+	CHECK_EQ(1, visited[0]);
+	CHECK_EQ(3, visited[1]);
+	CHECK_EQ(&c, registry.Find(idc));
+
+	// The freed slots are reused once the walk is over.
+	Item d = { 4 };
+	registry.Add(&d);
+	CHECK_EQ(2u, registry.Size());
+}
+
+int main()
+{
+	RUN_TEST(TestAddFindRemove);
+	RUN_TEST(TestAddDuringWalkNotVisited);
+	RUN_TEST(TestRemoveDuringWalk);
+	return 0;
+}
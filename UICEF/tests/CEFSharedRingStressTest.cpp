@@ -0,0 +1,149 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "CEFSharedRing.h"
+#include "TestUtils.h"
+
+// The browser process writes and a render process reads, here a child forked
+// on a block mapped by both. Every record carries words derived from its
+// index, so a torn read shows.
+
+static const int kWords = 13;
+
+struct Record
+{
+	uint64_t index;
+	uint64_t words[kWords];
+};
+
+// Set by the consumer once attached, and by the producer after the last write.
+struct Flags
+{
+	volatile int ready;
+	volatile int done;
+};
+
+static uint64_t total_records = 20000000;
+
+static bool IsIntact(const Record& record)
+{
+	for (int w = 0; w < kWords; ++w)
+	{
+		if (record.words[w] != record.index * 31 + w)
+			return false;
+	}
+	return true;
+}
+
+// Runs in the child, its exit status tells whether the stream was right.
+static int Consume(void* memory, size_t size, Flags* flags)
+{
+	CEFSharedRing ring;
+	if (!ring.Attach(memory, size))
+	{
+		printf("  consumer: attach failed\n");
+		return 1;
+	}
+	__atomic_store_n(&flags->ready, 1, __ATOMIC_RELEASE);
+
+	std::vector<Record> out(ring.GetCapacity());
+	uint64_t got = 0;
+	uint64_t lost = 0;
+	uint64_t torn = 0;
+	uint64_t unordered = 0;
+	uint64_t next = 0;
+	for (;;)
+	{
+		// Read the flag first, a record written before it is set is still read.
+		int done = __atomic_load_n(&flags->done, __ATOMIC_ACQUIRE);
+		size_t count = ring.Read(&out[0], out.size(), &lost);
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (!IsIntact(out[i]))
+				++torn;
+			if (out[i].index < next)
+				++unordered;
+			next = out[i].index + 1;
+		}
+		got += count;
+		if (done && count == 0 && ring.GetPendingCount() == 0)
+			break;
+	}
+
+	printf("  consumer: got %llu, lost %llu, torn %llu, out of order %llu\n",
+		static_cast<unsigned long long>(got), static_cast<unsigned long long>(lost),
+		static_cast<unsigned long long>(torn), static_cast<unsigned long long>(unordered));
+	return torn == 0 && unordered == 0 && got + lost == total_records ? 0 : 1;
+}
+
+static void RunStress(size_t capacity)
+{
+	size_t size = CEFSharedRing::GetRequiredSize(sizeof(Record), capacity);
+	void* memory = mmap(NULL, size + sizeof(Flags), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	CHECK(memory != MAP_FAILED);
+	Flags* flags = reinterpret_cast<Flags*>(static_cast<char*>(memory) + size);
+
+	CEFSharedRing producer;
+	CHECK(producer.Create(memory, size, sizeof(Record), capacity));
+
+	pid_t pid = fork();
+	CHECK(pid >= 0);
+	if (pid == 0)
+	{
+		int status = Consume(memory, size, flags);
+		fflush(stdout);
+		_exit(status);
+	}
+
+	while (!__atomic_load_n(&flags->ready, __ATOMIC_ACQUIRE))
+		sched_yield();
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	Record record;
+	for (uint64_t i = 0; i < total_records; ++i)
+	{
+		record.index = i;
+		for (int w = 0; w < kWords; ++w)
+			record.words[w] = i * 31 + w;
+		producer.Write(&record);
+	}
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	__atomic_store_n(&flags->done, 1, __ATOMIC_RELEASE);
+
+	int status = 0;
+	CHECK_EQ(pid, waitpid(pid, &status, 0));
+	printf("  capacity %u: %llu writes in %.0f ms (%.1f ns/write)\n", static_cast<unsigned int>(capacity),
+		static_cast<unsigned long long>(total_records), ms, ms * 1e6 / total_records);
+	CHECK(WIFEXITED(status));
+	CHECK_EQ(0, WEXITSTATUS(status));
+	CHECK_EQ(total_records, producer.GetWriteCount());
+
+	munmap(memory, size + sizeof(Flags));
+}
+
+// A ring with room to spare, and one the producer laps all the time.
+static void TestLargeRing()
+{
+	RunStress(4096);
+}
+
+static void TestSmallRing()
+{
+	RunStress(16);
+}
+
+// Pass a record count to run shorter or longer than the default.
+int main(int argc, char** argv)
+{
+	if (argc > 1)
+		total_records = strtoull(argv[1], NULL, 10);
+	RUN_TEST(TestLargeRing);
+	RUN_TEST(TestSmallRing);
+	return 0;
+}
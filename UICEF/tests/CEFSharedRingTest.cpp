@@ -0,0 +1,116 @@
+#include <cstdint>
+#include <vector>
+#include "CEFSharedRing.h"
+#include "TestUtils.h"
+
+struct Record
+{
+	uint64_t index;
+	uint64_t check;
+};
+
+static const size_t kCapacity = 8;
+
+static void WriteRecords(CEFSharedRing& ring, uint64_t first, uint64_t count)
+{
+	for (uint64_t i = first; i < first + count; ++i)
+	{
+		Record record = { i, i * 31 };
+		ring.Write(&record);
+	}
+}
+
+static void TestReadInOrder()
+{
+	std::vector<uint64_t> memory(CEFSharedRing::GetRequiredSize(sizeof(Record), kCapacity) / sizeof(uint64_t) + 1);
+	size_t size = memory.size() * sizeof(uint64_t);
+	CEFSharedRing producer, consumer;
+	CHECK(producer.Create(&memory[0], size, sizeof(Record), kCapacity));
+	CHECK(consumer.Attach(&memory[0], size));
+	CHECK_EQ(sizeof(Record), consumer.GetRecordSize());
+	CHECK_EQ(kCapacity, consumer.GetCapacity());
+
+	WriteRecords(producer, 0, 5);
+	CHECK_EQ(5u, consumer.GetPendingCount());
+
+	Record out[kCapacity];
+	uint64_t lost = 0;
+	CHECK_EQ(3u, consumer.Read(out, 3, &lost));
+	CHECK_EQ(2u, consumer.Read(out + 3, kCapacity, &lost));
+	CHECK_EQ(0u, lost);
+	for (uint64_t i = 0; i < 5; ++i)
+	{
+		CHECK_EQ(i, out[i].index);
+		CHECK_EQ(i * 31, out[i].check);
+	}
+	CHECK_EQ(0u, consumer.GetPendingCount());
+}
+
+static void TestLappedRecordsAreLost()
+{
+	std::vector<uint64_t> memory(CEFSharedRing::GetRequiredSize(sizeof(Record), kCapacity) / sizeof(uint64_t) + 1);
+	size_t size = memory.size() * sizeof(uint64_t);
+	CEFSharedRing producer, consumer;
+	CHECK(producer.Create(&memory[0], size, sizeof(Record), kCapacity));
+	CHECK(consumer.Attach(&memory[0], size));
+
+	WriteRecords(producer, 0, 20);
+
+	Record out[kCapacity];
+	uint64_t lost = 0;
+	CHECK_EQ(kCapacity, consumer.Read(out, kCapacity, &lost));
+	CHECK_EQ(12u, lost);
+	CHECK_EQ(12u, out[0].index);
+	CHECK_EQ(19u, out[kCapacity - 1].index);
+}
+
+static void TestAttachLate()
+{
+	std::vector<uint64_t> memory(CEFSharedRing::GetRequiredSize(sizeof(Record), kCapacity) / sizeof(uint64_t) + 1);
+	size_t size = memory.size() * sizeof(uint64_t);
+	CEFSharedRing producer;
+	CHECK(producer.Create(&memory[0], size, sizeof(Record), kCapacity));
+
+	// Records still in the ring are read.
+	WriteRecords(producer, 0, 3);
+	CEFSharedRing consumer;
+	CHECK(consumer.Attach(&memory[0], size));
+	CHECK_EQ(3u, consumer.GetPendingCount());
+
+	Record out[kCapacity];
+	uint64_t lost = 0;
+	CHECK_EQ(3u, consumer.Read(out, kCapacity, &lost));
+	CHECK_EQ(0u, lost);
+	CHECK_EQ(0u, out[0].index);
+
+	// Records overwritten before the attach are lost, not forgotten.
+	WriteRecords(producer, 3, 27);
+	CEFSharedRing late;
+	CHECK(late.Attach(&memory[0], size));
+	CHECK_EQ(kCapacity, late.Read(out, kCapacity, &lost));
+	CHECK_EQ(22u, lost);
+	CHECK_EQ(22u, out[0].index);
+	CHECK_EQ(30u, kCapacity + lost);
+}
+
+static void TestAttachNeedsRing()
+{
+	std::vector<uint64_t> memory(CEFSharedRing::GetRequiredSize(sizeof(Record), kCapacity) / sizeof(uint64_t) + 1);
+	size_t size = memory.size() * sizeof(uint64_t);
+	CEFSharedRing consumer;
+	CHECK(!consumer.Attach(&memory[0], size));
+	CHECK(!consumer.IsValid());
+
+	CEFSharedRing producer;
+	CHECK(producer.Create(&memory[0], size, sizeof(Record), kCapacity));
+	CHECK(!consumer.Attach(&memory[0], 16));
+}
+
+int main()
+{
+	RUN_TEST(TestReadInOrder);
+	RUN_TEST(TestLappedRecordsAreLost);
+	RUN_TEST(TestAttachLate);
+	RUN_TEST(TestAttachNeedsRing);
+	return 0;
+}
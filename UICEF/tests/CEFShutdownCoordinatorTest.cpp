@@ -0,0 +1,233 @@
+#include "CEFShutdownCoordinator.h"
+#include "TestUtils.h"
+
+// The coordinator with a clock the test moves by hand, and callbacks that
+// count what the manager would do.
+class Harness
+{
+public:
+	Harness()
+		: now_ms_(1000.0)
+		, started_(0)
+		, finished_(0)
+		, quits_(0)
+		, coordinator_([this]() { return now_ms_; })
+	{
+		CEFShutdownCoordinator::Callbacks callbacks;
+		callbacks.started = [this]() { ++started_; };
+		callbacks.finished = [this]() { ++finished_; };
+		callbacks.quit = [this]() { ++quits_; };
+		coordinator_.SetCallbacks(callbacks);
+	}
+
+	// Move the clock and run a frame.
+	void UpdateAt(double ms_since_begin)
+	{
+		now_ms_ = 1000.0 + ms_since_begin;
+		coordinator_.Update();
+	}
+
+	double now_ms_;
+	int started_;
+	int finished_;
+	int quits_;
+	CEFShutdownCoordinator coordinator_;
+};
+
+// Records forced closes. With |close_when_forced| the browser is gone as soon
+// as it is forced, as a windowless browser without unload handler would be.
+class StubWindow : public CEFShutdownCoordinator::Window
+{
+public:
+	StubWindow(CEFShutdownCoordinator* coordinator, bool close_when_forced)
+		: coordinator_(coordinator)
+		, close_when_forced_(close_when_forced)
+		, forced_(0)
+	{
+	}
+
+	virtual void ForceClose() override
+	{
+		++forced_;
+		if (close_when_forced_)
+		{
+			coordinator_->OnCloseFinished(this);
+		}
+	}
+
+	int GetForcedCount() const { return forced_; }
+
+private:
+	CEFShutdownCoordinator* coordinator_;
+	bool close_when_forced_;
+	int forced_;
+};
+
+static void TestAllClose()
+{
+	Harness harness;
+	CEFShutdownCoordinator& coordinator = harness.coordinator_;
+	StubWindow a(&coordinator, false);
+	StubWindow b(&coordinator, false);
+
+	coordinator.Begin();
+	CHECK(coordinator.IsShuttingDown());
+	CHECK_EQ(1, harness.started_);
+
+	coordinator.OnCloseStarted(&a, 1);
+	coordinator.OnCloseStarted(&b, 2);
+	CHECK_EQ(2u, coordinator.GetPendingCount());
+
+	harness.UpdateAt(100.0);
+	coordinator.OnCloseFinished(&a);
+	harness.UpdateAt(250.0);
+	coordinator.OnCloseFinished(&b);
+	CHECK_EQ(0u, coordinator.GetPendingCount());
+
+	// The game quits once the last web view is gone, well before a deadline.
+	coordinator.Quit();
+	CHECK(!coordinator.IsShuttingDown());
+	CHECK_EQ(1, harness.finished_);
+	CHECK_EQ(1, harness.quits_);
+	CHECK_EQ(0, a.GetForcedCount());
+	CHECK_EQ(0, b.GetForcedCount());
+
+	const std::vector<CEFShutdownCoordinator::Report>& reports = coordinator.GetReports();
+	CHECK_EQ(2u, reports.size());
+	CHECK_EQ(1, reports[0].browser_id);
+	CHECK_EQ(100.0, reports[0].close_ms);
+	CHECK_EQ(2, reports[1].browser_id);
+	CHECK_EQ(250.0, reports[1].close_ms);
+	CHECK(!reports[0].forced && !reports[0].abandoned);
+	CHECK(!reports[1].forced && !reports[1].abandoned);
+}
+
+static void TestDeadlines()
+{
+	Harness harness;
+	CEFShutdownCoordinator& coordinator = harness.coordinator_;
+	coordinator.SetDeadlines(500, 800);
+	StubWindow quick(&coordinator, true);
+	StubWindow stuck(&coordinator, false);
+
+	coordinator.Begin();
+	coordinator.OnCloseStarted(&quick, 1);
+	coordinator.OnCloseStarted(&stuck, 2);
+
+	harness.UpdateAt(499.0);
+	CHECK_EQ(0, quick.GetForcedCount());
+	CHECK_EQ(0, stuck.GetForcedCount());
+
+	// Both forced once, one of them closing during the walk.
+	harness.UpdateAt(500.0);
+	CHECK_EQ(1, quick.GetForcedCount());
+	CHECK_EQ(1, stuck.GetForcedCount());
+	CHECK_EQ(1u, coordinator.GetPendingCount());
+	harness.UpdateAt(700.0);
+	CHECK_EQ(1, stuck.GetForcedCount());
+	CHECK_EQ(0, harness.quits_);
+
+	// A renderer that never answers doesn't keep the game alive.
+	harness.UpdateAt(800.0);
+	CHECK_EQ(1, harness.quits_);
+	CHECK_EQ(1, harness.finished_);
+	CHECK(!coordinator.IsShuttingDown());
+	CHECK_EQ(0u, coordinator.GetPendingCount());
+
+	const std::vector<CEFShutdownCoordinator::Report>& reports = coordinator.GetReports();
+	CHECK_EQ(2u, reports.size());
+	CHECK_EQ(1, reports[0].browser_id);
+	CHECK(reports[0].forced && !reports[0].abandoned);
+	CHECK_EQ(500.0, reports[0].close_ms);
+	CHECK_EQ(2, reports[1].browser_id);
+	CHECK(reports[1].forced && reports[1].abandoned);
+	CHECK_EQ(800.0, reports[1].close_ms);
+
+	// Frames after the quit do nothing.
+	harness.UpdateAt(2000.0);
+	CHECK_EQ(1, harness.quits_);
+	CHECK_EQ(1, stuck.GetForcedCount());
+}
+
+static void TestLateClose()
+{
+	Harness harness;
+	CEFShutdownCoordinator& coordinator = harness.coordinator_;
+	coordinator.SetDeadlines(100, 200);
+	StubWindow stuck(&coordinator, false);
+	StubWindow late(&coordinator, false);
+
+	coordinator.Begin();
+	coordinator.OnCloseStarted(&stuck, 1);
+	harness.UpdateAt(200.0);
+	CHECK_EQ(1, harness.quits_);
+	CHECK_EQ(1u, coordinator.GetReports().size());
+
+	// The close the game gave up on finishes after all, and another starts.
+	coordinator.OnCloseFinished(&stuck);
+	coordinator.OnCloseStarted(&late, 2);
+	coordinator.OnCloseFinished(&late);
+	CHECK_EQ(1u, coordinator.GetReports().size());
+	CHECK(coordinator.GetReports()[0].abandoned);
+	CHECK_EQ(0u, coordinator.GetPendingCount());
+
+	// Quitting and beginning again are ignored.
+	coordinator.Quit();
+	coordinator.Begin();
+	CHECK_EQ(1, harness.quits_);
+	CHECK_EQ(1, harness.started_);
+	CHECK(!coordinator.IsShuttingDown());
+}
+
+static void TestTrackingOnlyWhileShuttingDown()
+{
+	Harness harness;
+	CEFShutdownCoordinator& coordinator = harness.coordinator_;
+	StubWindow window(&coordinator, false);
+
+	// An ordinary close during the game.
+	coordinator.OnCloseStarted(&window, 1);
+	CHECK_EQ(0u, coordinator.GetPendingCount());
+	harness.UpdateAt(10000.0);
+	CHECK_EQ(0, window.GetForcedCount());
+
+	// Started twice, tracked once. Finish without quitting keeps the deadline
+	// from firing later.
+	coordinator.Begin();
+	coordinator.Begin();
+	CHECK_EQ(1, harness.started_);
+	coordinator.OnCloseStarted(&window, 1);
+	coordinator.OnCloseStarted(&window, 1);
+	CHECK_EQ(1u, coordinator.GetPendingCount());
+
+	coordinator.Finish();
+	CHECK_EQ(1, harness.finished_);
+	harness.UpdateAt(20000.0);
+	CHECK_EQ(0, window.GetForcedCount());
+	CHECK_EQ(0, harness.quits_);
+}
+
+static void TestSetDeadlines()
+{
+	Harness harness;
+	CEFShutdownCoordinator& coordinator = harness.coordinator_;
+	StubWindow window(&coordinator, false);
+
+	// The quit deadline can't come before the force one.
+	coordinator.SetDeadlines(-5, -10);
+	coordinator.Begin();
+	coordinator.OnCloseStarted(&window, 1);
+	harness.UpdateAt(0.0);
+	CHECK_EQ(1, window.GetForcedCount());
+	CHECK_EQ(1, harness.quits_);
+}
+
+int main()
+{
+	RUN_TEST(TestAllClose);
+	RUN_TEST(TestDeadlines);
+	RUN_TEST(TestLateClose);
+	RUN_TEST(TestTrackingOnlyWhileShuttingDown);
+	RUN_TEST(TestSetDeadlines);
+	return 0;
+}
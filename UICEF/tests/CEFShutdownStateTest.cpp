@@ -0,0 +1,217 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "CEFMPSCQueue.h"
+#include "CEFShutdownState.h"
+#include "TestUtils.h"
+
+// Drives CEFShutdownState the way CEFManager does, with a stub CEF UI thread
+// closing the browsers, a stub pump thread and the test as the cocos thread.
+// Build with UICEF_TSAN to check the threads under ThreadSanitizer.
+
+typedef std::chrono::steady_clock Clock;
+
+static const int kBrowsers = 20;
+static const int kCloseDelayMs = 2;
+static const int kDrainTimeoutMs = 2000;
+static const int kDrainSliceMs = 10;
+
+// Runs tasks one after the other on its own thread, like the CEF UI thread.
+class StubUIThread
+{
+public:
+	StubUIThread() : is_stopping_(false), thread_(&StubUIThread::Run, this) {}
+
+	~StubUIThread()
+	{
+		{
+			std::lock_guard<std::mutex> lock(lock_);
+			is_stopping_ = true;
+		}
+		cond_.notify_all();
+		thread_.join();
+	}
+
+	void Post(const std::function<void()>& task)
+	{
+		{
+			std::lock_guard<std::mutex> lock(lock_);
+			tasks_.push_back(task);
+		}
+		cond_.notify_all();
+	}
+
+private:
+	void Run()
+	{
+		std::unique_lock<std::mutex> lock(lock_);
+		while (true)
+		{
+			cond_.wait(lock, [this]() { return is_stopping_ || !tasks_.empty(); });
+			if (tasks_.empty())
+				return;
+
+			std::function<void()> task = tasks_.front();
+			tasks_.erase(tasks_.begin());
+			lock.unlock();
+			task();
+			lock.lock();
+		}
+	}
+
+	std::mutex lock_;
+	std::condition_variable cond_;
+	std::vector<std::function<void()> > tasks_;
+	bool is_stopping_;
+	std::thread thread_;
+};
+
+// Stands in for the pump thread, which only reads the state and the window
+// count, and stops once drained.
+class StubPumpThread
+{
+public:
+	explicit StubPumpThread(CEFShutdownState& state)
+		: state_(state)
+		, dispatch_count_(0)
+		, thread_(&StubPumpThread::Run, this)
+	{
+	}
+
+	~StubPumpThread() { thread_.join(); }
+
+	int GetDispatchCount() const { return dispatch_count_; }
+
+private:
+	void Run()
+	{
+		while (state_.GetState() < CEFShutdownState::kDrained)
+		{
+			if (state_.GetWindowCount() > 0)
+				++dispatch_count_;
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+
+	CEFShutdownState& state_;
+	std::atomic<int> dispatch_count_;
+	std::thread thread_;
+};
+
+static double MillisecondsSince(const Clock::time_point& start)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static void TestStateOnlyMovesForward()
+{
+	CEFShutdownState state;
+	CHECK_EQ(CEFShutdownState::kRunning, state.GetState());
+	state.Advance(CEFShutdownState::kDrained);
+	state.Advance(CEFShutdownState::kClosing);
+	CHECK_EQ(CEFShutdownState::kDrained, state.GetState());
+}
+
+static void TestCloseWithoutWindows()
+{
+	CEFShutdownState state;
+	state.Close();
+	CHECK_EQ(CEFShutdownState::kDrained, state.GetState());
+	CHECK(state.Drain(kDrainTimeoutMs, kDrainSliceMs, []() {}));
+}
+
+static void TestShutdown()
+{
+	CEFShutdownState state;
+	// Browser events for the cocos thread, as CEFManager::postToCocosThread.
+	CEFMPSCQueue<std::function<void()> > cocos_tasks(64);
+	std::atomic<int> closed_windows(0);
+
+	{
+		StubUIThread ui_thread;
+		StubPumpThread pump_thread(state);
+
+		for (int i = 0; i < kBrowsers; ++i)
+		{
+			state.OnWindowCreated();
+			ui_thread.Post([&state]() { state.OnBrowserLifeSpan(true); });
+		}
+
+		// Let the pump see some windows.
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+		Clock::time_point start = Clock::now();
+		state.Close();
+		CHECK_EQ(CEFShutdownState::kClosing, state.GetState());
+
+		// CEF closes each browser a little later and tells the cocos thread,
+		// which then deletes the window.
+		for (int i = 0; i < kBrowsers; ++i)
+		{
+			ui_thread.Post([&state, &cocos_tasks, &closed_windows]() {
+				std::this_thread::sleep_for(std::chrono::milliseconds(kCloseDelayMs));
+				std::function<void()> task = [&state, &closed_windows]() {
+					++closed_windows;
+					state.OnWindowDestroyed();
+				};
+				while (!cocos_tasks.TryPush(std::move(task)))
+					std::this_thread::yield();
+				// Last, as CEFClientHandler::OnBeforeClose does.
+				state.OnBrowserLifeSpan(false);
+			});
+		}
+
+		bool drained = state.Drain(kDrainTimeoutMs, kDrainSliceMs, [&cocos_tasks]() {
+			std::function<void()> task;
+			while (cocos_tasks.TryPop(task))
+				task();
+		});
+
+		double shutdown_ms = MillisecondsSince(start);
+		printf("  %d browsers closed in %.1f ms, pump dispatched %d times\n", kBrowsers, shutdown_ms,
+			pump_thread.GetDispatchCount());
+
+		CHECK(drained);
+		CHECK_EQ(0, state.GetLiveBrowserCount());
+		CHECK_EQ(kBrowsers, closed_windows.load());
+		CHECK_EQ(CEFShutdownState::kDrained, state.GetState());
+		// Far less than the timeout: the drain wakes up on the last close.
+		CHECK(shutdown_ms < kDrainTimeoutMs / 2);
+
+		state.Advance(CEFShutdownState::kShutDown);
+	}
+
+	CHECK_EQ(CEFShutdownState::kShutDown, state.GetState());
+}
+
+static void TestDrainTimesOut()
+{
+	CEFShutdownState state;
+	state.OnWindowCreated();
+	state.OnBrowserLifeSpan(true);
+	state.Close();
+
+	// The browser never closes.
+	int pumps = 0;
+	Clock::time_point start = Clock::now();
+	CHECK(!state.Drain(50, kDrainSliceMs, [&pumps]() { ++pumps; }));
+	double elapsed_ms = MillisecondsSince(start);
+	printf("  gave up after %.1f ms, %d pumps\n", elapsed_ms, pumps);
+	CHECK(elapsed_ms >= 45);
+	CHECK(elapsed_ms < 1000);
+	CHECK(pumps >= 2);
+	CHECK_EQ(CEFShutdownState::kClosing, state.GetState());
+}
+
+int main()
+{
+	RUN_TEST(TestStateOnlyMovesForward);
+	RUN_TEST(TestCloseWithoutWindows);
+	RUN_TEST(TestShutdown);
+	RUN_TEST(TestDrainTimesOut);
+	return 0;
+}
@@ -0,0 +1,60 @@
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include "CEFStartupProfiler.h"
+
+// Cost of CEFStartupProfiler::Browser::Mark, which CEF calls on its UI thread
+// while creating browsers. It should stay under a microsecond: the first mark
+// of a milestone reads the clock and sets it, later ones find it set.
+
+typedef std::chrono::steady_clock Clock;
+
+static const int kBrowsers = 100000;
+static const int kRepeats = 10;
+
+static double NsPer(Clock::time_point start, int count)
+{
+	return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / count;
+}
+
+int main()
+{
+	std::unique_ptr<CEFStartupProfiler::Browser[]> browsers(new CEFStartupProfiler::Browser[kBrowsers]);
+	const int marks = kBrowsers * CEFStartupProfiler::kMilestoneCount;
+
+	Clock::time_point start = Clock::now();
+	for (int i = 0; i < kBrowsers; ++i)
+	{
+		for (int j = 0; j < CEFStartupProfiler::kMilestoneCount; ++j)
+		{
+			browsers[i].Mark(static_cast<CEFStartupProfiler::Milestone>(j));
+		}
+	}
+	double first_ns = NsPer(start, marks);
+
+	start = Clock::now();
+	for (int r = 0; r < kRepeats; ++r)
+	{
+		for (int i = 0; i < kBrowsers; ++i)
+		{
+			for (int j = 0; j < CEFStartupProfiler::kMilestoneCount; ++j)
+			{
+				browsers[i].Mark(static_cast<CEFStartupProfiler::Milestone>(j));
+			}
+		}
+	}
+	double repeat_ns = NsPer(start, marks * kRepeats);
+
+	start = Clock::now();
+	int64_t sink = 0;
+	for (int i = 0; i < marks; ++i)
+	{
+		sink += CEFStartupProfiler::Now();
+	}
+	double now_ns = NsPer(start, marks);
+
+	printf("first mark:    %7.1f ns%s\n", first_ns, first_ns < 1000.0 ? "" : "  OVER 1 us");
+	printf("repeated mark: %7.1f ns%s\n", repeat_ns, repeat_ns < 1000.0 ? "" : "  OVER 1 us");
+	printf("clock read:    %7.1f ns (%d)\n", now_ns, static_cast<int>(sink & 1));
+	return 0;
+}
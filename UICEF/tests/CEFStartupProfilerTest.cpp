@@ -0,0 +1,174 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "CEFStartupProfiler.h"
+#include "TestUtils.h"
+
+static bool Contains(const std::string& text, const std::string& part)
+{
+	return text.find(part) != std::string::npos;
+}
+
+static void TestPhases()
+{
+	CEFStartupProfiler profiler;
+	CHECK_EQ(0.0, profiler.GetPhaseMs(CEFStartupProfiler::kInitialize));
+
+	// Not finished yet.
+	profiler.BeginPhase(CEFStartupProfiler::kInitialize);
+	CHECK_EQ(0.0, profiler.GetPhaseMs(CEFStartupProfiler::kInitialize));
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(2));
+	profiler.EndPhase(CEFStartupProfiler::kInitialize);
+	CHECK(profiler.GetPhaseMs(CEFStartupProfiler::kInitialize) >= 2.0);
+	CHECK_EQ(0.0, profiler.GetPhaseMs(CEFStartupProfiler::kExecuteProcess));
+}
+
+static void TestFirstMarkWins()
+{
+	CEFStartupProfiler::Browser browser;
+	CHECK_EQ(0, browser.GetTime(CEFStartupProfiler::kFirstLoadEnd));
+
+	browser.Mark(CEFStartupProfiler::kFirstLoadEnd);
+	int64_t first = browser.GetTime(CEFStartupProfiler::kFirstLoadEnd);
+	CHECK(first != 0);
+
+	// Later loads don't move it.
+	std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	browser.Mark(CEFStartupProfiler::kFirstLoadEnd);
+	CHECK_EQ(first, browser.GetTime(CEFStartupProfiler::kFirstLoadEnd));
+	CHECK_EQ(0, browser.GetTime(CEFStartupProfiler::kAfterCreated));
+}
+
+// Threads marking the same milestones at once all see the time of the one
+// that won, and it was taken while they were marking.
+static void TestFirstMarkWinsAcrossThreads()
+{
+	static const int kThreads = 4;
+	static const int kRounds = 200;
+
+	for (int round = 0; round < kRounds; ++round)
+	{
+		CEFStartupProfiler::Browser browser;
+		std::atomic<int> ready(0);
+		int64_t begins[kThreads];
+		int64_t seen[kThreads][CEFStartupProfiler::kMilestoneCount];
+		std::vector<std::thread> threads;
+
+		for (int i = 0; i < kThreads; ++i)
+		{
+			threads.push_back(std::thread([&, i]() {
+				++ready;
+				while (ready < kThreads)
+				{
+					std::this_thread::yield();
+				}
+
+				begins[i] = CEFStartupProfiler::Now();
+				for (int j = 0; j < CEFStartupProfiler::kMilestoneCount; ++j)
+				{
+					CEFStartupProfiler::Milestone milestone = static_cast<CEFStartupProfiler::Milestone>(j);
+					browser.Mark(milestone);
+					seen[i][j] = browser.GetTime(milestone);
+				}
+			}));
+		}
+
+		for (size_t i = 0; i < threads.size(); ++i)
+		{
+			threads[i].join();
+		}
+
+		int64_t end = CEFStartupProfiler::Now();
+		int64_t first_begin = begins[0];
+		for (int i = 1; i < kThreads; ++i)
+		{
+			first_begin = std::min(first_begin, begins[i]);
+		}
+
+		for (int j = 0; j < CEFStartupProfiler::kMilestoneCount; ++j)
+		{
+			int64_t time = browser.GetTime(static_cast<CEFStartupProfiler::Milestone>(j));
+			CHECK(time >= first_begin && time <= end);
+			for (int i = 0; i < kThreads; ++i)
+			{
+				CHECK_EQ(time, seen[i][j]);
+			}
+		}
+	}
+}
+
+static void TestBrowserLimit()
+{
+	std::unique_ptr<CEFStartupProfiler> profiler(new CEFStartupProfiler);
+	for (size_t i = 0; i < CEFStartupProfiler::kMaxBrowsers; ++i)
+	{
+		CHECK(profiler->AddBrowser(false) != NULL);
+	}
+
+	CHECK(profiler->AddBrowser(true) == NULL);
+	CHECK_EQ(CEFStartupProfiler::kMaxBrowsers, profiler->GetBrowserCount());
+}
+
+static void TestEmptyJSON()
+{
+	CEFStartupProfiler profiler;
+	CHECK_EQ(std::string("{\"phases\":{},\"browsers\":[]}"), profiler.ToJSON());
+}
+
+static void TestToJSON()
+{
+	CEFStartupProfiler profiler;
+	profiler.BeginPhase(CEFStartupProfiler::kExecuteProcess);
+	profiler.EndPhase(CEFStartupProfiler::kExecuteProcess);
+	profiler.BeginPhase(CEFStartupProfiler::kInitialize);
+	profiler.EndPhase(CEFStartupProfiler::kInitialize);
+	// Never ended.
+	profiler.BeginPhase(CEFStartupProfiler::kEnableHighDPISupport);
+
+	CEFStartupProfiler::Browser* windowed = profiler.AddBrowser(false);
+	windowed->SetIdentifier(3);
+	windowed->Mark(CEFStartupProfiler::kCreateBrowserBegin);
+	windowed->Mark(CEFStartupProfiler::kAfterCreated);
+
+	CEFStartupProfiler::Browser* windowless = profiler.AddBrowser(true);
+	windowless->SetIdentifier(4);
+
+	std::string json = profiler.ToJSON();
+	CHECK_EQ(0u, json.find("{\"phases\":{\"CefExecuteProcess\":{\"begin_ms\":"));
+	CHECK(Contains(json, "},\"CefInitialize\":{\"begin_ms\":"));
+	CHECK(Contains(json, ",\"duration_ms\":"));
+	CHECK(!Contains(json, "CefEnableHighDPISupport"));
+
+	// Reached milestones only, in milliseconds since the profiler started.
+	CHECK(Contains(json, "\"browsers\":[{\"id\":3,\"windowless\":false,\"create_browser_begin_ms\":"));
+	CHECK(Contains(json, ",\"after_created_ms\":"));
+	CHECK(!Contains(json, "create_browser_end_ms"));
+	CHECK(!Contains(json, "first_load_end_ms"));
+	CHECK(Contains(json, "},{\"id\":4,\"windowless\":true}]}"));
+
+	// Balanced braces and brackets, with the numbers in between.
+	int depth = 0;
+	for (size_t i = 0; i < json.size(); ++i)
+	{
+		char c = json[i];
+		depth += (c == '{' || c == '[') ? 1 : (c == '}' || c == ']') ? -1 : 0;
+		CHECK(depth >= 0);
+	}
+	CHECK_EQ(0, depth);
+}
+
+int main()
+{
+	RUN_TEST(TestPhases);
+	RUN_TEST(TestFirstMarkWins);
+	RUN_TEST(TestFirstMarkWinsAcrossThreads);
+	RUN_TEST(TestBrowserLimit);
+	RUN_TEST(TestEmptyJSON);
+	RUN_TEST(TestToJSON);
+	return 0;
+}
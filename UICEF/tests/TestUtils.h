@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+
+// Minimal checks for the UICEF tests, which have no framework to depend on.
+// A failed check reports where it failed and ends the test.
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) \
+		{ \
+			fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+			exit(1); \
+		} \
+	} while (0)
+
+#define CHECK_EQ(expected, actual) CHECK((expected) == (actual))
+
+#define RUN_TEST(test) \
+	do { \
+		printf("%s\n", #test); \
+		fflush(stdout); \
+		test(); \
+	} while (0)
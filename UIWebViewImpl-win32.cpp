@@ -33,6 +33,7 @@
 #include "base/CCDirector.h"
 #include "platform/CCGLView.h"
 #include "platform/CCFileUtils.h"
+#include "2d/CCSprite.h"
 #include "ui/UIWebView.h"
 #include "UICEF/CEFWebViewWrapper.h"
 
@@ -43,6 +44,7 @@ namespace experimental {
 
 WebViewImpl::WebViewImpl(WebView *webView)
         :_webView(webView) 
+        ,_osrSprite(nullptr)
 {
 	_uiWebViewWrapper = CEFWebViewWrapper::create();
 	_uiWebViewWrapper->retain();
@@ -162,6 +164,29 @@ void WebViewImpl::draw(cocos2d::Renderer *renderer, cocos2d::Mat4 const &transfo
 
 		_uiWebViewWrapper->setBounds(x, y, width, height);
     }
+
+    if (_osrSprite) {
+        if (_uiWebViewWrapper->updateTexture()) {
+            auto texture = _uiWebViewWrapper->getTexture();
+            _osrSprite->setTexture(texture);
+            // setTexture picks the blending from the texture, which doesn't know
+            // the frames of CEF are premultiplied.
+            _osrSprite->setBlendFunc(BlendFunc::ALPHA_PREMULTIPLIED);
+            _osrSprite->setOpacityModifyRGB(true);
+            _osrSprite->setTextureRect(cocos2d::Rect(cocos2d::Vec2::ZERO, texture->getContentSize()));
+            _osrSprite->setVisible(true);
+        }
+
+        // Stretch the last frame over the view until the browser repaints at the new size.
+        auto textureSize = _osrSprite->getContentSize();
+        if (textureSize.width > 0 && textureSize.height > 0) {
+            auto contentSize = _webView->getContentSize();
+            _osrSprite->setScale(contentSize.width / textureSize.width, contentSize.height / textureSize.height);
+        }
+        _osrSprite->setOpacity(static_cast<GLubyte>(_uiWebViewWrapper->getOpacityWebView() * 255));
+
+        _uiWebViewWrapper->updateFrameRate();
+    }
 }
 
 void WebViewImpl::setVisible(bool visible){
@@ -182,6 +207,17 @@ void WebViewImpl::setBackgroundTransparent(){
 
 void WebViewImpl::onEnter()
 {
+	if (_uiWebViewWrapper->isWindowless() && !_osrSprite)
+	{
+		// Web content is drawn by this sprite as part of the scene.
+		_osrSprite = Sprite::create();
+		_osrSprite->setAnchorPoint(Vec2::ZERO);
+		_osrSprite->setBlendFunc(BlendFunc::ALPHA_PREMULTIPLIED);
+		_osrSprite->setOpacityModifyRGB(true);
+		_osrSprite->setVisible(false);
+		_webView->addChild(_osrSprite);
+	}
+
 	_uiWebViewWrapper->onEnter();
 }
 
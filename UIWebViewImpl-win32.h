@@ -36,6 +36,7 @@ namespace cocos2d {
 	class Data;
 	class Renderer;
 	class Mat4;
+	class Sprite;
 
 	namespace experimental {
 		namespace ui {
@@ -95,6 +96,7 @@ namespace cocos2d {
 			private:
 				CEFWebViewWrapper *_uiWebViewWrapper;
 				WebView *_webView;
+				Sprite *_osrSprite;
 			};
 
 		} // namespace ui